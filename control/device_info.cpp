@@ -70,13 +70,17 @@ void device_info::parse_device(std::string const& input)
       }
 
 
-      // extract interface permission
+      // extract interface state
       ss >> token;
 
-      bool permission = static_cast<bool> (std::stoi(token));
+      unsigned short state = std::stoi(token);
 
-      intf_settings_.push_back(std::make_pair(settings,permission));
+      intf_settings_.push_back(std::make_pair(settings,state));
     }
+
+
+    // extract fingerprint
+    if(ss >> token) fingerprint_ = token;
 }
 
 
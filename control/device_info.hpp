@@ -15,6 +15,9 @@ namespace gemini
   enum device_string{PRODUCT_STRING,VENDOR_STRING,UNDEFINED_STRING};
   enum device_value {BUS,PORT,VENDOR_ID,PRODUCT_ID,INTERFACE_NUMBER,UNDEFINED};
 
+  // interface state reported by the daemon
+  enum intf_state{INTF_PROHIBITED,INTF_PERMITTED,INTF_FAILED_TO_BLOCK};
+
   // shift
   #define index_value_shift UNDEFINED_STRING
 
@@ -36,8 +39,12 @@ namespace gemini
     std::array<std::string,UNDEFINED_STRING>                  device_strings_;
     // bus, port, vendor id, product id, interface number
     std::array<unsigned short,UNDEFINED>                      device_values_;
-    // setting class, permission of every interface
-    std::vector<std::pair<std::vector<unsigned short>,bool> > intf_settings_;
+    // setting class, state (intf_state) of every interface
+    std::vector<std::pair<std::vector<unsigned short>,
+                          unsigned short> >                   intf_settings_;
+    // hash over every descriptor ("0x8f3a51c0d2e47b16"), empty if the daemon
+    // doesn't report it
+    std::string                                               fingerprint_;
   };
 
   // operators
@@ -1,6 +1,11 @@
 #include "main_window.hpp"
 #include <iostream>
+#include <sstream>
+#include <QApplication>
 #include <QFileDialog>
+#include <QMenu>
+#include <QRegularExpression>
+#include <QStyle>
 
 
 // initialize static class member
@@ -14,8 +19,10 @@ QMainWindow(parent),
 ui(new Ui::main_window),
 icon_enabled_(":/icons/enabled"),
 icon_disabled_(":/icons/disabled"),
+icon_failed_(QApplication::style()->standardIcon(QStyle::SP_MessageBoxWarning)),
 intf_info_socket_(new QLocalSocket(this)),
 rule_set_socket_(new QLocalSocket(this)),
+device_cost_socket_(new QLocalSocket(this)),
 rule_upload_server_(new QLocalServer(this)),
 update_timer_(new QTimer(this)),
 update_frequency_(1000),
@@ -23,6 +30,7 @@ hub_visability_(true),
 load_rule_set_(false),
 read_rule_set_(true),
 upload_rules_(false),
+optimize_rules_(false),
 save_rule_set_(false),
 server_connection_(true)
 {
@@ -47,6 +55,7 @@ main_window::~main_window()
   delete ui;
   delete intf_info_socket_;
   delete rule_set_socket_;
+  delete device_cost_socket_;
   delete rule_upload_server_;
   delete update_timer_;
 }
@@ -106,6 +115,8 @@ void main_window::read_interface_info()
   // update the device tree with new device info
   update_device_tree(device_info);
 
+  update_device_cost();
+
   if(!server_connection_)
   {
     // visualize server connection
@@ -146,6 +157,50 @@ void main_window::read_rule_set()
 
 
 
+// private SLOT : network
+void main_window::read_device_cost()
+{
+  std::vector<std::string> input(read_stream(device_cost_socket_));
+
+  const char * cost_names[] = {"open","descriptor","string","driver"};
+
+
+  device_costs_.clear();
+
+  // "<bus> <port> <vendor> <product> <recent> <total>" followed by
+  // "<total> <failures>" of every operation
+  for(auto input_it = input.begin() ; input_it != input.end() ; ++input_it)
+  {
+    std::istringstream ss(*input_it);
+
+    unsigned short bus , port , vendor , product;
+
+    unsigned long long recent , total , cost , failures;
+
+
+    ss >> bus >> port >> vendor >> product >> recent >> total;
+
+    QString details = QString("total %1 us").arg(total);
+
+    for(unsigned short index = 0 ; index < 4 && ss >> cost >> failures ; ++index)
+    {
+      details += QString("\n%1 %2 us, %3 failures").arg(cost_names[index])
+                                                   .arg(cost)
+                                                   .arg(failures);
+    }
+
+
+    device_costs_[std::make_pair(bus,port)] =
+
+    std::make_pair(QString::number(recent),details);
+  }
+
+
+  update_device_cost();
+}
+
+
+
 // private SLOT : network
 void main_window::send_request()
 {
@@ -199,7 +254,8 @@ void main_window::send_request()
     out << static_cast<quint16> (0);
 
     // set server request type
-    out << static_cast<quint16> (UPLOAD_RULE_SET);
+    out << static_cast<quint16> (optimize_rules_ ? UPLOAD_OPTIMIZED_RULE_SET :
+                                                   UPLOAD_RULE_SET);
 
     for(auto rule_it  = rule_nodes_.begin() ;
              rule_it != rule_nodes_.end()   ; ++rule_it)
@@ -217,7 +273,11 @@ void main_window::send_request()
     // send stream
     client_connection->write(block);
 
-    upload_rules_ = false;
+    // show the optimized rule set of the server
+    if(optimize_rules_) read_rule_set_ = true;
+
+    upload_rules_   = false;
+    optimize_rules_ = false;
   }
 
   else if(load_rule_set_ && server_connection_)
@@ -273,6 +333,9 @@ void main_window::trigger_update()
   intf_info_socket_->abort();
   intf_info_socket_->connectToServer("gemini_interface_info");
 
+  device_cost_socket_->abort();
+  device_cost_socket_->connectToServer("gemini_device_cost");
+
 
   if(read_rule_set_)
   {
@@ -289,16 +352,72 @@ void main_window::trigger_update()
 // private SLOT : content update
 void main_window::update_rule_node(int row,int collumn)
 {
+  // hits are counted by the daemon, fingerprints come from devices (cells
+  // change only if rules are moved)
+  if(collumn == RHITS)
+  {
+    rule_nodes_[row].hits_ = ui->rule_table->item(row,collumn)->text().toULongLong();
+
+    return;
+  }
+
+  if(collumn == RFINGERPRINT)
+  {
+    QString cell_text(ui->rule_table->item(row,collumn)->text());
+
+    rule_nodes_[row].fingerprint_ = cell_text == ANY.c_str() ?
+                                    "" : cell_text.toStdString();
+
+    return;
+  }
+
+  // daily time windows ("02:00-03:00,22:00-06:00")
+  if(collumn == RSCHEDULE)
+  {
+    QTableWidgetItem * table_item(ui->rule_table->item(row,collumn));
+
+    const QRegularExpression windows("^[0-2][0-9]:[0-5][0-9]-[0-2][0-9]:[0-5][0-9]"
+                                     "(,[0-2][0-9]:[0-5][0-9]-[0-2][0-9]:[0-5][0-9])*$");
+
+    if(table_item->text() == ANY.c_str() || table_item->text() == "")
+    {
+      rule_nodes_[row].schedule_.clear();
+
+      if(table_item->text() == "") table_item->setText(ANY.c_str());
+
+      table_item->setTextColor(Qt::black);
+    }
+
+    else if(windows.match(table_item->text()).hasMatch())
+    {
+      rule_nodes_[row].schedule_ = table_item->text().toStdString();
+
+      table_item->setTextColor(Qt::black);
+    }
+
+    else table_item->setTextColor(Qt::red);
+
+    return;
+  }
+
   // get current table item
   QTableWidgetItem * table_item(ui->rule_table->item(row,collumn));
 
   // get text of current item
   QString cell_text(table_item->text());
 
-  unsigned short cell_value(0);
+  unsigned int cell_value(0);
 
   bool conversion_correct(true);
 
+  // value ranges and sets ("0x1000-0x10ff,0x2000")
+  const QRegularExpression value_set("^(0x[0-9a-fA-F]+|[0-9]+)"
+                                     "(-(0x[0-9a-fA-F]+|[0-9]+))?"
+                                     "(,(0x[0-9a-fA-F]+|[0-9]+)"
+                                     "(-(0x[0-9a-fA-F]+|[0-9]+))?)*$");
+
+
+  rule_nodes_[row].ranges_[collumn].clear();
 
   if(cell_text == ANY.c_str())
   {
@@ -312,11 +431,47 @@ void main_window::update_rule_node(int row,int collumn)
     rule_nodes_[row].values_[collumn] = 0;
   }
 
+  // serial numbers are entered as text, hashes start with '#'
+  else if(collumn == RSERIAL && !cell_text.startsWith("#"))
+  {
+    rule_nodes_[row].values_[collumn] =
+
+    gemini::rule_info::serial_hash(cell_text.toStdString());
+
+    table_item->setText(value_text(rule_nodes_[row],collumn));
+    table_item->setTextColor(Qt::black);
+
+    return;
+  }
+
+  else if(collumn != RSERIAL && cell_text.contains(QRegularExpression("[-,]")))
+  {
+    conversion_correct = value_set.match(cell_text).hasMatch();
+
+    if(conversion_correct)
+    {
+      rule_nodes_[row].values_[collumn] = 0;
+      rule_nodes_[row].ranges_[collumn] = cell_text.toStdString();
+
+      table_item->setTextColor(Qt::black);
+
+      return;
+    }
+
+    table_item->setTextColor(Qt::red);
+  }
+
   else
   {
     try
     {
-      cell_value = std::stoi(cell_text.toStdString());
+      if(collumn == RSERIAL)
+      {
+        cell_value = std::stoul(cell_text.mid(1).toStdString(),nullptr,16);
+      }
+
+      else cell_value = std::stoul(cell_text.toStdString(),nullptr,
+                                   cell_text.startsWith("0x") ? 16 : 10);
     }
 
     catch(std::invalid_argument const&)
@@ -366,7 +521,12 @@ void main_window::update_class(int)
 
     if(class_index > 3) ++class_index;
 
-    rule_nodes_[row].values_[RCLASS] = class_index;
+    // class sets of loaded rules stay until the class is changed
+    if(rule_nodes_[row].values_[RCLASS] != class_index)
+    {
+      rule_nodes_[row].values_[RCLASS] = class_index;
+      rule_nodes_[row].ranges_[RCLASS].clear();
+    }
   }
 }
 
@@ -388,7 +548,7 @@ void main_window::update_permission(int)
 
     permission = static_cast<bool> (permission_combo_box->currentIndex());
 
-    rule_nodes_[row].values_[RPERMISSION] = permission;
+    rule_nodes_[row].permission_ = permission;
   }
 }
 
@@ -450,6 +610,39 @@ void main_window::create_interface_rule(QTreeWidgetItem * clicked_item)
 
 
 
+// private SLOT : interaction
+void main_window::device_menu(QPoint const& position)
+{
+  QTreeWidgetItem * device_item = ui->device_tree->itemAt(position);
+
+  if(device_item == nullptr || device_item->parent() != nullptr) return;
+
+  for(auto device_node_it  = device_nodes_.begin() ;
+           device_node_it != device_nodes_.end()   ; ++device_node_it)
+  {
+    if(device_node_it->second != device_item) continue;
+
+
+    QMenu     menu(ui->device_tree);
+    QAction * pin_action = menu.addAction("Pin device");
+
+    // daemons without fingerprints can't pin
+    pin_action->setEnabled(!device_node_it->first.fingerprint_.empty());
+
+    if(menu.exec(ui->device_tree->viewport()->mapToGlobal(position)) == pin_action)
+    {
+      add_rule(gemini::rule_info::pin(device_node_it->first));
+
+      ui->tab_widget->setCurrentWidget(ui->tab_rule_editor);
+      ui->rule_table->setCurrentCell(0,RPERMISSION);
+    }
+
+    break;
+  }
+}
+
+
+
 // private SLOT : interaction
 void main_window::hub_visability()
 {
@@ -589,6 +782,13 @@ void main_window::server_upload()
   upload_rules_ = true;
 }
 
+// private SLOT : network
+void main_window::server_upload_optimized()
+{
+  optimize_rules_ = true;
+  upload_rules_   = true;
+}
+
 
 
 // private : static
@@ -612,6 +812,42 @@ QString const main_window::gemini_home_path()
 
 
 
+// private static : table text of a rule value
+QString const main_window::value_text(gemini::rule_info const& rule,
+                                      unsigned short column)
+{
+  if(column == RHITS) return QString::number(rule.hits_);
+
+  if(column == RFINGERPRINT)
+  {
+    return rule.fingerprint_.empty() ? ANY.c_str() : rule.fingerprint_.c_str();
+  }
+
+  if(column == RSCHEDULE)
+  {
+    return rule.schedule_.empty() ? ANY.c_str() : rule.schedule_.c_str();
+  }
+
+  if(!rule.ranges_[column].empty()) return rule.ranges_[column].c_str();
+
+  if(rule.values_[column] == RMASKED) return ANY.c_str();
+
+  // serial hashes are shown hexadecimal, text without '#' is a serial
+  if(column == RSERIAL) return "#" + QString::number(rule.values_[column],16);
+
+  return QString::number(rule.values_[column]);
+}
+
+
+
+// private static : cells of pinning rules, hits and fingerprints are read only
+bool main_window::editable(gemini::rule_info const& rule,unsigned short column)
+{
+  return column != RHITS && column != RFINGERPRINT && rule.fingerprint_.empty();
+}
+
+
+
 // private : initialization
 void main_window::init_button_icons() const
 {
@@ -620,6 +856,9 @@ void main_window::init_button_icons() const
   ui->rule_add_button->setIcon(QIcon(":/icons/add"));
   ui->rule_remove_button->setIcon(QIcon(":/icons/remove"));
   ui->server_upload_button->setIcon(QIcon(":/icons/upload"));
+  ui->server_optimize_button->setIcon
+
+  (QApplication::style()->standardIcon(QStyle::SP_DialogApplyButton));
 }
 
 
@@ -630,6 +869,9 @@ void main_window::init_interaction_connection() const
   connect(ui->server_upload_button,SIGNAL(clicked(bool)),
           this                    ,SLOT(server_upload()) );
 
+  connect(ui->server_optimize_button,SIGNAL(clicked(bool)),
+          this                      ,SLOT(server_upload_optimized()));
+
   connect(ui->rule_add_button,SIGNAL(clicked(bool)),
           this               ,SLOT(add_rule())      );
 
@@ -645,6 +887,12 @@ void main_window::init_interaction_connection() const
   connect(ui->device_tree,SIGNAL(itemDoubleClicked(QTreeWidgetItem *,int)),
           this           ,SLOT(create_interface_rule(QTreeWidgetItem *))   );
 
+  // double clicks expand devices, their context menu pins them
+  ui->device_tree->setContextMenuPolicy(Qt::CustomContextMenu);
+
+  connect(ui->device_tree,SIGNAL(customContextMenuRequested(QPoint const&)),
+          this           ,SLOT(device_menu(QPoint const&))                 );
+
   connect(ui->action_new,SIGNAL(triggered()),this,SLOT(new_rule_set()));
   connect(ui->action_open,SIGNAL(triggered()),this,SLOT(open_rule_set()));
   connect(ui->action_save,SIGNAL(triggered()),this,SLOT(save_rule_set()));
@@ -671,6 +919,9 @@ void main_window::init_network() const
   connect(rule_set_socket_,SIGNAL(readyRead()),
           this            ,SLOT(read_rule_set()));
 
+  connect(device_cost_socket_,SIGNAL(readyRead()),
+          this               ,SLOT(read_device_cost()));
+
   connect(rule_upload_server_,SIGNAL(newConnection()),
           this               ,SLOT(send_request()))  ;
 
@@ -689,8 +940,9 @@ void main_window::init_rule_table_header() const
   QStringList table_header;
 
   table_header << "Bus" << "Port" << "Vendor" << "Product"
-               << "Interface class"
-               << "Permission";
+               << "Interface class" << "Subclass" << "Protocol"
+               << "Device class" << "Serial" << "Fingerprint" << "Schedule"
+               << "Permission" << "Hits";
 
   ui->rule_table->setColumnCount(table_header.size());
   ui->rule_table->setHorizontalHeaderLabels(table_header);
@@ -703,13 +955,25 @@ void main_window::init_rule_table_column_width() const
 {
   const unsigned short value_column_width(65),
                        class_column_width(152),
+                       serial_column_width(95),
+                       fingerprint_column_width(140),
                        permission_column_width(120);
 
   unsigned short width(0);
 
   for(unsigned short column = RBUS ; column != RUNDEFINED ; ++column)
   {
-    if(column < RCLASS)
+    if(column == RSERIAL || column == RSCHEDULE || column == RHITS)
+    {
+      width = serial_column_width;
+    }
+
+    else if(column == RFINGERPRINT)
+    {
+      width = fingerprint_column_width;
+    }
+
+    else if(column != RCLASS && column != RPERMISSION)
     {
       width = value_column_width;
     }
@@ -798,25 +1062,22 @@ void main_window::add_rule(gemini::rule_info const& rule)
 
   for(unsigned short collumn = RBUS ; collumn != RUNDEFINED ; ++collumn)
   {
-    if(collumn < RCLASS)
+    if(collumn != RCLASS && collumn != RPERMISSION)
     {
       rule_value_item = new QTableWidgetItem(ANY.c_str());
 
       rule_value_item->setTextAlignment(Qt::AlignCenter);
 
 
-      if(rule.values_[collumn] == 0)
-      {
-        collumn_text = ANY.c_str();
-      }
+      collumn_text = value_text(rule,collumn);
+
+      rule_value_item->setText(collumn_text);
 
-      else
+      if(!editable(rule,collumn))
       {
-        collumn_text = QString::number(rule.values_[collumn]);
+        rule_value_item->setFlags(rule_value_item->flags() & ~Qt::ItemIsEditable);
       }
 
-      rule_value_item->setText(collumn_text);
-
       ui->rule_table->setItem(row,collumn,rule_value_item);
     }
 
@@ -830,6 +1091,7 @@ void main_window::add_rule(gemini::rule_info const& rule)
       if(class_index > 3) --class_index;
 
       class_item->setCurrentIndex(class_index);
+      class_item->setEnabled(editable(rule,collumn));
 
 
       connect(class_item,SIGNAL(currentIndexChanged(int)),
@@ -867,6 +1129,12 @@ void main_window::add_device(gemini::device_info const& info)
   device_item->setText(0,device_text);
   device_item->setText(1,vendor_text);
 
+  if(!info.fingerprint_.empty())
+  {
+    device_item->setToolTip(0,QString("Fingerprint ") + info.fingerprint_.c_str()
+                            + ", its context menu pins the device");
+  }
+
   // for every interface
   for(auto intf_it  = info.intf_settings_.begin() ;
            intf_it != info.intf_settings_.end()   ; ++intf_it)
@@ -891,8 +1159,7 @@ void main_window::add_device(gemini::device_info const& info)
     }
 
     // set permission icon
-    if(intf_it->second) intf_item->setIcon(0,icon_enabled_);
-    else                intf_item->setIcon(0,icon_disabled_);
+    update_intf_state(intf_item,intf_it->second);
 
     // add complete interface item to device item
     device_item->addChild(intf_item);
@@ -996,8 +1263,7 @@ update_device_tree(std::vector<gemini::device_info> const& update)
         }
 
         // set permission icon
-        if(intf_it->second) intf_item->setIcon(0,icon_enabled_);
-        else                intf_item->setIcon(0,icon_disabled_);
+        update_intf_state(intf_item,intf_it->second);
 
         ++intf_id;
       }
@@ -1041,6 +1307,62 @@ update_device_tree(std::vector<gemini::device_info> const& update)
 
 
 
+// private : content update
+void main_window::update_device_cost()
+{
+  // only the most expensive devices have costs
+  for(auto device_it  = device_nodes_.begin() ;
+           device_it != device_nodes_.end()   ; ++device_it)
+  {
+    auto cost_it = device_costs_.find
+
+    (std::make_pair(device_it->first.device_values_[gemini::BUS],
+                    device_it->first.device_values_[gemini::PORT]));
+
+
+    if(cost_it == device_costs_.end())
+    {
+      device_it->second->setText(2,"");
+      device_it->second->setToolTip(2,"");
+    }
+
+    else
+    {
+      device_it->second->setText(2,cost_it->second.first);
+      device_it->second->setToolTip(2,cost_it->second.second);
+    }
+  }
+}
+
+
+
+// private : content update
+void main_window::update_intf_state(QTreeWidgetItem * intf_item,
+                                    unsigned short    state    )
+{
+  if(state == gemini::INTF_PERMITTED)
+  {
+    intf_item->setIcon(0,icon_enabled_);
+    intf_item->setToolTip(0,"");
+  }
+
+  // prohibited interface still has its kernel driver
+  else if(state == gemini::INTF_FAILED_TO_BLOCK)
+  {
+    intf_item->setIcon(0,icon_failed_);
+    intf_item->setToolTip(0,"Prohibited, but the kernel driver couldn't be "
+                            "detached");
+  }
+
+  else
+  {
+    intf_item->setIcon(0,icon_disabled_);
+    intf_item->setToolTip(0,"");
+  }
+}
+
+
+
 // private : content update
 void main_window::update_priority(unsigned short row,bool up)
 {
@@ -1059,32 +1381,47 @@ void main_window::update_priority(unsigned short row,bool up)
 
   int     prev_index;
 
+  Qt::ItemFlags prev_flags;
+
+  bool    prev_enabled;
+
 
-  for(unsigned short collumn = 0 ; collumn != RCLASS ; ++collumn)
+  for(unsigned short collumn = RBUS ; collumn != RUNDEFINED ; ++collumn)
   {
-    item_prev = ui->rule_table->item(row     , collumn);
-    item      = ui->rule_table->item(prev_row , collumn);
+    if(collumn != RCLASS && collumn != RPERMISSION)
+    {
+      item_prev = ui->rule_table->item(row     , collumn);
+      item      = ui->rule_table->item(prev_row , collumn);
 
-    prev = item_prev->text();
+      prev       = item_prev->text();
+      prev_flags = item_prev->flags();
 
-    item_prev->setText(item->text());
-    item->setText(prev);
-  }
+      item_prev->setFlags(item->flags());
+      item->setFlags(prev_flags);
 
-  for(unsigned short collumn = RCLASS ; collumn != RUNDEFINED ; ++collumn)
-  {
-    combo_item      = reinterpret_cast<QComboBox *>
+      item_prev->setText(item->text());
+      item->setText(prev);
+    }
+
+    else
+    {
+      combo_item      = reinterpret_cast<QComboBox *>
+
+                        (ui->rule_table->cellWidget(row     , collumn));
 
-                      (ui->rule_table->cellWidget(row     , collumn));
+      combo_item_prev = reinterpret_cast<QComboBox *>
 
-    combo_item_prev = reinterpret_cast<QComboBox *>
+                        (ui->rule_table->cellWidget(prev_row , collumn));
 
-                      (ui->rule_table->cellWidget(prev_row , collumn));
+      prev_index   = combo_item_prev->currentIndex();
+      prev_enabled = combo_item_prev->isEnabled();
 
-    prev_index = combo_item_prev->currentIndex();
+      combo_item_prev->setCurrentIndex(combo_item->currentIndex());
+      combo_item->setCurrentIndex(prev_index);
 
-    combo_item_prev->setCurrentIndex(combo_item->currentIndex());
-    combo_item->setCurrentIndex(prev_index);
+      combo_item_prev->setEnabled(combo_item->isEnabled());
+      combo_item->setEnabled(prev_enabled);
+    }
   }
 
   ui->rule_table->setCurrentCell(prev_row,ui->rule_table->currentColumn());
@@ -1109,23 +1446,20 @@ void main_window::update_rule_table()
   {
     for(unsigned short collumn = RBUS ; collumn != RUNDEFINED ; ++collumn)
     {
-      if(collumn < RCLASS)
+      if(collumn != RCLASS && collumn != RPERMISSION)
       {
-        if(rule_it->values_[collumn] == RMASKED)
-        {
-          token = ANY.c_str();
-        }
-
-        else
-        {
-          token = QString::number(rule_it->values_[collumn]);
-        }
+        token = value_text(*rule_it,collumn);
 
 
         rule_value_item = new QTableWidgetItem(token);
 
         rule_value_item->setTextAlignment(Qt::AlignCenter);
 
+        if(!editable(*rule_it,collumn))
+        {
+          rule_value_item->setFlags(rule_value_item->flags() & ~Qt::ItemIsEditable);
+        }
+
 
         ui->rule_table->setItem(rule_index,collumn,rule_value_item);
       }
@@ -1140,6 +1474,7 @@ void main_window::update_rule_table()
         if(class_index > 3) --class_index;
 
         class_item->setCurrentIndex(class_index);
+        class_item->setEnabled(editable(*rule_it,collumn));
 
 
         connect(class_item,SIGNAL(currentIndexChanged(int)),
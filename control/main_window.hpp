@@ -42,6 +42,7 @@ class main_window : public QMainWindow
   // network
   void read_interface_info();
   void read_rule_set();
+  void read_device_cost();
   void send_request();
   void trigger_update();
 
@@ -56,6 +57,7 @@ class main_window : public QMainWindow
   // interaction
   void add_rule();
   void create_interface_rule(QTreeWidgetItem * clicked_item);
+  void device_menu(QPoint const& position);
   void hub_visability();
   void new_rule_set();
   void open_rule_set();
@@ -65,12 +67,17 @@ class main_window : public QMainWindow
   void rule_up();
   void rule_down();
   void server_upload();
+  void server_upload_optimized();
 
 
   private :
 
   // static
   static QString const gemini_home_path();
+  static QString const value_text(gemini::rule_info const& rule,
+                                  unsigned short column);
+  static bool          editable(gemini::rule_info const& rule,
+                                unsigned short column);
 
   // initialization
   void init_button_icons()            const;
@@ -88,6 +95,8 @@ class main_window : public QMainWindow
   void add_device(gemini::device_info const& info);
   void filter_device_update(std::vector<gemini::device_info> & update);
   void update_device_tree(std::vector<gemini::device_info> const& update);
+  void update_device_cost();
+  void update_intf_state(QTreeWidgetItem * intf_item,unsigned short state);
   void update_priority(unsigned short row,bool up);
   void update_rule_table();
 
@@ -101,7 +110,7 @@ class main_window : public QMainWindow
   static const std::string ANY;
 
   enum request_type{UPLOAD_RULE_SET,LOAD_RULE_SET,SAVE_RULE_SET,
-                    UNDEFINED_REQUEST                           };
+                    UPLOAD_OPTIMIZED_RULE_SET,UNDEFINED_REQUEST };
 
 
   //object member
@@ -109,11 +118,13 @@ class main_window : public QMainWindow
   // interface
   Ui::main_window * ui;
   QIcon             icon_enabled_,
-                    icon_disabled_;
+                    icon_disabled_,
+                    icon_failed_;
 
   //network
   QLocalSocket    * intf_info_socket_,
-                  * rule_set_socket_;
+                  * rule_set_socket_,
+                  * device_cost_socket_;
   QLocalServer    * rule_upload_server_;
 
   QString           rule_set_name_;
@@ -127,6 +138,7 @@ class main_window : public QMainWindow
                     load_rule_set_,
                     read_rule_set_,
                     upload_rules_,
+                    optimize_rules_,
                     save_rule_set_,
                     server_connection_;
 
@@ -136,6 +148,10 @@ class main_window : public QMainWindow
   // gemini
   std::vector<gemini::rule_info>                  rule_nodes_;
   std::map<gemini::device_info,QTreeWidgetItem *> device_nodes_;
+
+  // cost and cost details of the most expensive devices by bus and port
+  std::map<std::pair<unsigned short,unsigned short>,
+           std::pair<QString,QString> >            device_costs_;
 };
 
 #endif // UI_MAIN_WINDOW
@@ -1,3 +1,5 @@
+#include <cctype>
+#include <cstdint>
 #include <sstream>
 
 #include <rule_info.hpp>
@@ -5,34 +7,78 @@
 namespace gemini
 {
 
+namespace
+{
+  // rule keywords of the daemon for the value columns up to RFINGERPRINT
+  const char * const KEYWORDS[RFINGERPRINT] =
+  {
+    "BUS","PORT","VENDOR_ID","PRODUCT_ID","INTERFACE_CLASS",
+    "INTERFACE_SUBCLASS","INTERFACE_PROTOCOL","DEVICE_CLASS","SERIAL_HASH"
+  };
+}
+
+
 rule_info::rule_info() :
-permission_(true)
+permission_(true),
+hits_(0)
 {
   values_.fill(0);
 }
 
-rule_info::rule_info(std::string const& input)
+rule_info::rule_info(std::string const& input) :
+hits_(0)
 {
   std::string token;
   std::istringstream ss(input);
 
+  values_.fill(0);
+
+  // pinning and scheduled rules are keyword value pairs ("FINGERPRINT
+  // 0x8f3a51c0d2e47b16 PERMISSION 1")
+  const bool keywords = !input.empty() && std::isalpha(input[0]);
+
+  if(keywords)
+  {
+    std::string value;
+
+    while(ss >> token && token != "PERMISSION" && ss >> value)
+    {
+      if(token == "FINGERPRINT")   fingerprint_ = value;
+      else if(token == "SCHEDULE") schedule_    = value;
+
+      for(unsigned short index = RBUS ; index != RFINGERPRINT ; ++index)
+      {
+        if(token == KEYWORDS[index]) assign(index,value);
+      }
+    }
+  }
+
   // extract device description
   for(unsigned short token_index  = 0 ;
-                     token_index != RPERMISSION ; ++token_index)
+                     token_index != RPERMISSION && !keywords ; ++token_index)
   {
+    // the daemon doesn't send the fingerprint and schedule columns
+    if(token_index == RFINGERPRINT || token_index == RSCHEDULE) continue;
+
     ss >> token;
 
-    values_[token_index] = std::stoi(token);
+    assign(token_index,token.substr(0,token.find(']')));
   }
 
   // extract permission
   ss >> token;
 
   permission_ = static_cast<bool> (std::stoi(token));
+
+  // hits follow the rule
+  if(ss >> token) hits_ = std::stoull(token);
 }
 
-rule_info::rule_info(device_info const& device_info)
+rule_info::rule_info(device_info const& device_info) :
+hits_(0)
 {
+  values_.fill(0);
+
   for(unsigned short value_index = RBUS    ;
                      value_index != RCLASS ; ++value_index)
   {
@@ -48,14 +94,84 @@ rule_info::rule_info(device_info const& device_info)
 }
 
 
+unsigned int rule_info::serial_hash(std::string const& serial)
+{
+  std::uint32_t hash = 2166136261U;
+
+  for(auto c_it = serial.begin() ; c_it != serial.end() ; ++c_it)
+  {
+    hash ^= static_cast<unsigned char> (*c_it);
+    hash *= 16777619U;
+  }
+
+  return hash == 0 ? 1 : hash;
+}
+
+
+rule_info const rule_info::pin(device_info const& device_info)
+{
+  rule_info pin;
+
+  pin.fingerprint_ = device_info.fingerprint_;
+
+  return pin;
+}
+
+
+void rule_info::assign(unsigned short index,std::string const& token)
+{
+  if(token.find_first_of("-,") != std::string::npos)
+  {
+    values_[index] = 0;
+    ranges_[index] = token;
+  }
+
+  else values_[index] = std::stoul(token);
+}
+
+
 std::string const rule_info::rule_string() const
 {
   std::string rule_string;
 
+  if(!fingerprint_.empty())
+  {
+    return "FINGERPRINT " + fingerprint_ + " PERMISSION "
+         + std::to_string(permission_);
+  }
+
+  // masked fields are left out
+  if(!schedule_.empty())
+  {
+    for(unsigned short index = RBUS ; index != RFINGERPRINT ; ++index)
+    {
+      if(!ranges_[index].empty())
+      {
+        rule_string += std::string(KEYWORDS[index]) + " " + ranges_[index] + " ";
+      }
+
+      else if(values_[index] != 0)
+      {
+        rule_string += std::string(KEYWORDS[index]) + " "
+                     + std::to_string(values_[index]) + " ";
+      }
+    }
+
+    return rule_string + "SCHEDULE " + schedule_ + " PERMISSION "
+         + std::to_string(permission_);
+  }
+
   for(unsigned short token_index  = 0 ;
                      token_index != RPERMISSION ; ++token_index)
   {
-    rule_string += std::to_string(values_[token_index]);
+    if(token_index == RFINGERPRINT || token_index == RSCHEDULE) continue;
+
+    if(ranges_[token_index].empty())
+    {
+      rule_string += std::to_string(values_[token_index]);
+    }
+
+    else rule_string += ranges_[token_index];
 
     rule_string += " ";
   }
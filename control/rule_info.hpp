@@ -3,12 +3,15 @@
 
 // std
 #include <array>
+#include <string>
 
 // gemini
 #include <device_info.hpp>
 
 
-enum rule_value{RBUS,RPORT,RVENDOR,RDEVICE,RCLASS,RPERMISSION,RUNDEFINED};
+enum rule_value{RBUS,RPORT,RVENDOR,RDEVICE,RCLASS,RSUBCLASS,RPROTOCOL,
+                RDEVICE_CLASS,RSERIAL,RFINGERPRINT,RSCHEDULE,RPERMISSION,RHITS,
+                RUNDEFINED};
 enum rule_masked{RMASKED};
 
 namespace gemini
@@ -20,12 +23,36 @@ struct rule_info
   rule_info(std::string const& input);
   rule_info(device_info const& device_info);
 
+  // rule pinning the fingerprint of a device
+  static rule_info const pin(device_info const& device_info);
+
   std::string const rule_string() const;
 
+  // serial numbers are matched by hash (FNV-1a like the daemon), never 0
+  static unsigned int serial_hash(std::string const& serial);
+
+  // value or range text of a field
+  void assign(unsigned short index,std::string const& token);
+
+
+  std::array<unsigned int,RPERMISSION> values_;
 
-  std::array<unsigned short,RPERMISSION> values_;
+  // text of fields matching ranges or sets ("4096-4351,8192"), empty for
+  // single values
+  std::array<std::string,RPERMISSION>  ranges_;
+
+  // fingerprint of a pinned device, pins don't match on values (empty for
+  // other rules)
+  std::string fingerprint_;
+
+  // daily time windows the rule is active in ("02:00-03:00,22:00-06:00"),
+  // empty if always active
+  std::string schedule_;
 
   bool permission_;
+
+  // decisions of the rule in the daemon (read only)
+  unsigned long long hits_;
 };
 
 }
@@ -0,0 +1,568 @@
+// posix
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// std
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+
+// class
+#include <audit_journal.hpp>
+
+
+namespace gemini
+{
+
+namespace
+{
+  // bloom filter keys of the device filters of a query
+  const std::uint64_t VENDOR_PRODUCT_KEY = 1ULL << 40,
+                      BUS_PORT_KEY       = 2ULL << 40;
+
+  std::uint64_t vendor_product_key(std::uint32_t vendor_id,std::uint32_t product_id)
+  {
+    return VENDOR_PRODUCT_KEY | (std::uint64_t(vendor_id & 0xffff) << 16)
+                              | (product_id & 0xffff);
+  }
+
+  std::uint64_t bus_port_key(std::uint32_t bus,std::uint32_t port)
+  {
+    return BUS_PORT_KEY | ((bus & 0xff) << 8) | (port & 0xff);
+  }
+
+  // splitmix64 finalizer, spreads keys over the filter bits
+  std::uint64_t mix(std::uint64_t key)
+  {
+    key ^= key >> 30;
+    key *= 0xbf58476d1ce4e5b9ULL;
+    key ^= key >> 27;
+    key *= 0x94d049bb133111ebULL;
+    key ^= key >> 31;
+
+    return key;
+  }
+}
+
+
+const std::uint32_t journal_record::NO_RULE        = 0xffffffff;
+
+const std::size_t   audit_journal::QUEUE_SIZE      = 4096;
+const std::size_t   audit_journal::SEGMENT_RECORDS = 16384;
+const std::size_t   audit_journal::SEGMENT_NUMBER  = 16;
+
+const std::uint32_t audit_journal::MAGIC           = 0x47454d4a; // "GEMJ"
+const std::uint32_t audit_journal::VERSION         = 1;
+
+
+// "2026-10-19 02:00:00.000125 BLOCK DONE FINGERPRINT 0x... INTERFACE 0
+// RULE 3 [BUS:1] ..."
+std::string const journal_record::info_line() const
+{
+  const char * decisions[] = {"BLOCK","UNBLOCK"},
+             * outcomes[]  = {"DONE","FAILED","EXTERNAL"};
+
+  std::time_t seconds = time / 1000000;
+
+  std::tm local;
+
+  localtime_r(&seconds,&local);
+
+  char stamp[64];
+
+  std::size_t length = std::strftime(stamp,sizeof(stamp),"%Y-%m-%d %H:%M:%S",
+                                     &local);
+
+  std::snprintf(stamp + length,sizeof(stamp) - length,".%06llu",
+                static_cast<unsigned long long> (time % 1000000));
+
+
+  char fingerprint_info[19];
+
+  std::snprintf(fingerprint_info,sizeof(fingerprint_info),"0x%016llx",
+                static_cast<unsigned long long> (fingerprint));
+
+  descriptor::info_type desc_info;
+
+  std::copy(info,info + DESCRIPTOR_SIZE,desc_info.begin());
+
+
+  std::string line(stamp);
+
+  line += " ";
+  line += decision < 2 ? decisions[decision] : "?";
+  line += " ";
+  line += outcome  < 3 ? outcomes[outcome]   : "?";
+  line += " FINGERPRINT ";
+  line += fingerprint_info;
+  line += " INTERFACE " + std::to_string(interface_number);
+  line += " RULE " + (rule == NO_RULE ? std::string("-") : std::to_string(rule));
+  line += " " + descriptor(desc_info).info(true);
+
+  return line;
+}
+
+
+audit_journal::audit_journal(std::string const& directory) :
+directory_(directory),
+file_descriptor_(-1),
+mapping_(nullptr),
+cells_(new cell[QUEUE_SIZE]),
+tail_(0),
+head_(0)
+{
+  for(std::size_t index = 0 ; index < QUEUE_SIZE ; ++index)
+  {
+    cells_[index].sequence.store(index,std::memory_order_relaxed);
+  }
+}
+
+audit_journal::~audit_journal()
+{
+  close();
+}
+
+
+bool audit_journal::open()
+{
+  if(is_open()) return true;
+
+  if(directory_.empty()) return false;
+
+
+  if(mkdir(directory_.c_str(),S_IRWXU) != 0 && errno != EEXIST) return false;
+
+  std::vector<std::uint64_t> sequences;
+
+  if(!segments(directory_,sequences)) return false;
+
+
+  // continue the latest segment unless it's full or damaged
+  if(!sequences.empty() && map(sequences.back(),false))
+  {
+    if(segment_header()->count < segment_header()->capacity) return true;
+
+    unmap();
+  }
+
+  return start(sequences.empty() ? 1 : sequences.back() + 1);
+}
+
+void audit_journal::close()
+{
+  if(mapping_ != nullptr) msync(mapping_,file_size(),MS_SYNC);
+
+  unmap();
+}
+
+
+bool audit_journal::is_open() const
+{
+  return mapping_ != nullptr;
+}
+
+
+// bounded multi producer queue, a producer claims a cell by advancing the
+// tail and publishes it with the cell sequence
+bool audit_journal::enqueue(journal_record const& record)
+{
+  std::uint64_t position = tail_.load(std::memory_order_relaxed);
+
+  cell * target;
+
+  while(true)
+  {
+    target = &cells_[position % QUEUE_SIZE];
+
+    std::uint64_t sequence = target->sequence.load(std::memory_order_acquire);
+
+    if(sequence == position)
+    {
+      if(tail_.compare_exchange_weak(position,position + 1,
+                                     std::memory_order_relaxed)) break;
+    }
+
+    // the cell still holds a record of the previous turn
+    else if(sequence < position) return false;
+
+    else position = tail_.load(std::memory_order_relaxed);
+  }
+
+  target->data = record;
+
+  target->sequence.store(position + 1,std::memory_order_release);
+
+
+  return true;
+}
+
+void audit_journal::drain(std::vector<journal_record> & records)
+{
+  while(true)
+  {
+    cell & source = cells_[head_ % QUEUE_SIZE];
+
+    if(source.sequence.load(std::memory_order_acquire) != head_ + 1) break;
+
+    records.push_back(source.data);
+
+    // free for the producers of the next turn
+    source.sequence.store(head_ + QUEUE_SIZE,std::memory_order_release);
+
+    ++head_;
+  }
+}
+
+
+void audit_journal::append(std::vector<journal_record> & records)
+{
+  if(!is_open() || records.empty()) return;
+
+
+  std::stable_sort(records.begin(),records.end(),
+                   [](journal_record const& a,journal_record const& b)
+                   {
+                     return a.time < b.time;
+                   });
+
+  for(auto record_it = records.begin() ; record_it != records.end() ; ++record_it)
+  {
+    // segments stay sorted for binary searches, records from before a clock
+    // step back keep their time and start a new segment
+    if((segment_header()->count == segment_header()->capacity ||
+        (segment_header()->count > 0 &&
+         record_it->time < segment_header()->last_time)) &&
+       !start(segment_header()->sequence + 1)) return;
+
+
+    header & current = *segment_header();
+
+    segment_records()[current.count] = *record_it;
+
+    remember(current,record_it->fingerprint);
+    remember(current,vendor_product_key(record_it->info[VENDOR_ID],
+                                        record_it->info[PRODUCT_ID]));
+    remember(current,bus_port_key(record_it->info[BUS],record_it->info[PORT]));
+
+    if(current.count == 0) current.first_time = record_it->time;
+
+    current.last_time = record_it->time;
+
+    // count last, a crash loses the record only
+    ++current.count;
+  }
+
+  // write back asynchronous like the state file
+  msync(mapping_,file_size(),MS_ASYNC);
+}
+
+
+bool audit_journal::read(std::string const& directory,journal_query const& query,
+                         std::vector<journal_record> & records)
+{
+  std::vector<std::uint64_t> sequences;
+
+  if(!segments(directory,sequences)) return false;
+
+
+  for(auto sequence_it = sequences.begin() ; sequence_it != sequences.end() ;
+      ++sequence_it)
+  {
+    int file_descriptor = ::open(segment_path(directory,*sequence_it).c_str(),
+                                 O_RDONLY | O_CLOEXEC);
+
+    if(file_descriptor < 0) continue;
+
+    struct stat file_status;
+
+    void * mapping = MAP_FAILED;
+
+    if(fstat(file_descriptor,&file_status) == 0 &&
+       static_cast<std::size_t> (file_status.st_size) == file_size())
+    {
+      mapping = mmap(nullptr,file_size(),PROT_READ,MAP_SHARED,file_descriptor,0);
+    }
+
+    ::close(file_descriptor);
+
+    if(mapping == MAP_FAILED) continue;
+
+
+    header const& segment = *static_cast<header const*> (mapping);
+
+    journal_record const* first = reinterpret_cast<journal_record const*>
+                                  (static_cast<char const*> (mapping) + sizeof(header));
+
+    bool skipped = segment.magic       != MAGIC                 ||
+                   segment.version     != VERSION               ||
+                   segment.record_size != sizeof(journal_record) ||
+                   segment.capacity    != SEGMENT_RECORDS        ||
+                   segment.count       == 0                      ||
+                   segment.last_time   <  query.from             ||
+                   segment.first_time  >  query.to;
+
+    // devices the segment has no record of
+    if(query.fingerprint != 0 && !contains(segment,query.fingerprint)) skipped = true;
+
+    if(query.vendor_id != MASKED && query.product_id != MASKED &&
+       !contains(segment,vendor_product_key(query.vendor_id,query.product_id)))
+    {
+      skipped = true;
+    }
+
+    if(query.bus != MASKED && query.port != MASKED &&
+       !contains(segment,bus_port_key(query.bus,query.port)))
+    {
+      skipped = true;
+    }
+
+
+    if(!skipped)
+    {
+      journal_record const* last = first + std::min<std::uint64_t> (segment.count,
+                                                                     segment.capacity);
+
+      journal_record const* record_it =
+
+      std::lower_bound(first,last,query.from,
+                       [](journal_record const& record,std::uint64_t time)
+                       {
+                         return record.time < time;
+                       });
+
+      for( ; record_it != last && record_it->time <= query.to ; ++record_it)
+      {
+        if(selected(*record_it,query)) records.push_back(*record_it);
+      }
+    }
+
+    munmap(mapping,file_size());
+  }
+
+
+  return true;
+}
+
+
+std::uint64_t audit_journal::now()
+{
+  return std::chrono::duration_cast<std::chrono::microseconds>
+         (std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+
+std::size_t audit_journal::file_size()
+{
+  return sizeof(header) + sizeof(journal_record) * SEGMENT_RECORDS;
+}
+
+
+std::string const audit_journal::segment_path(std::string const& directory,
+                                              std::uint64_t sequence)
+{
+  char name[32];
+
+  std::snprintf(name,sizeof(name),"segment.%016llx",
+                static_cast<unsigned long long> (sequence));
+
+  return directory + "/" + name;
+}
+
+bool audit_journal::segments(std::string const& directory,
+                             std::vector<std::uint64_t> & sequences)
+{
+  DIR * journal_directory = opendir(directory.c_str());
+
+  if(!journal_directory) return false;
+
+
+  for(dirent * entry = readdir(journal_directory) ; entry ;
+      entry = readdir(journal_directory))
+  {
+    if(std::strncmp(entry->d_name,"segment.",8) != 0) continue;
+
+    char * end;
+
+    std::uint64_t sequence = std::strtoull(entry->d_name + 8,&end,16);
+
+    if(*end == '\0' && sequence != 0) sequences.push_back(sequence);
+  }
+
+  closedir(journal_directory);
+
+  std::sort(sequences.begin(),sequences.end());
+
+
+  return true;
+}
+
+
+void audit_journal::remember(header & segment_header,std::uint64_t key)
+{
+  std::uint64_t hash = mix(key);
+
+  segment_header.devices[(hash >> 6) & 7]  |= 1ULL << (hash & 63);
+  segment_header.devices[(hash >> 15) & 7] |= 1ULL << ((hash >> 9) & 63);
+}
+
+bool audit_journal::contains(header const& segment_header,std::uint64_t key)
+{
+  std::uint64_t hash = mix(key);
+
+  return (segment_header.devices[(hash >> 6) & 7]  >> (hash & 63)) & 1 &&
+         (segment_header.devices[(hash >> 15) & 7] >> ((hash >> 9) & 63)) & 1;
+}
+
+
+bool audit_journal::selected(journal_record const& record,
+                             journal_query const& query)
+{
+  if(query.fingerprint != 0 && record.fingerprint != query.fingerprint)
+  {
+    return false;
+  }
+
+  const unsigned short fields[] = {BUS,PORT,VENDOR_ID,PRODUCT_ID};
+
+  const descriptor::value_type values[] = {query.bus,query.port,query.vendor_id,
+                                           query.product_id};
+
+  for(unsigned short index = 0 ; index < 4 ; ++index)
+  {
+    if(values[index] != MASKED && record.info[fields[index]] != values[index])
+    {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+
+bool audit_journal::map(std::uint64_t sequence,bool create)
+{
+  std::string path(segment_path(directory_,sequence));
+
+  file_descriptor_ = ::open(path.c_str(),O_RDWR | O_CLOEXEC | (create ? O_CREAT : 0),
+                            S_IRUSR | S_IWUSR);
+
+  if(file_descriptor_ < 0) return false;
+
+
+  struct stat file_status;
+
+  bool fresh = fstat(file_descriptor_,&file_status) != 0 ||
+               static_cast<std::size_t> (file_status.st_size) != file_size();
+
+  // segments are only written at their full size
+  if(fresh && (!create || ftruncate(file_descriptor_,file_size()) != 0))
+  {
+    unmap();
+
+    return false;
+  }
+
+
+  mapping_ = mmap(nullptr,file_size(),PROT_READ | PROT_WRITE,MAP_SHARED,
+                  file_descriptor_,0);
+
+  if(mapping_ == MAP_FAILED)
+  {
+    mapping_ = nullptr;
+
+    unmap();
+
+    return false;
+  }
+
+
+  header & segment = *segment_header();
+
+  if(create)
+  {
+    std::memset(&segment,0,sizeof(header));
+
+    segment.magic       = MAGIC;
+    segment.version     = VERSION;
+    segment.record_size = sizeof(journal_record);
+    segment.capacity    = SEGMENT_RECORDS;
+    segment.sequence    = sequence;
+  }
+
+  // segment of another daemon version or damaged
+  else if(segment.magic       != MAGIC                  ||
+          segment.version     != VERSION                ||
+          segment.record_size != sizeof(journal_record) ||
+          segment.capacity    != SEGMENT_RECORDS        ||
+          segment.sequence    != sequence               ||
+          segment.count       >  segment.capacity        )
+  {
+    unmap();
+
+    return false;
+  }
+
+
+  return true;
+}
+
+void audit_journal::unmap()
+{
+  if(mapping_ != nullptr)
+  {
+    munmap(mapping_,file_size());
+
+    mapping_ = nullptr;
+  }
+
+  if(file_descriptor_ >= 0)
+  {
+    ::close(file_descriptor_);
+
+    file_descriptor_ = -1;
+  }
+}
+
+
+bool audit_journal::start(std::uint64_t sequence)
+{
+  if(mapping_ != nullptr) msync(mapping_,file_size(),MS_ASYNC);
+
+  unmap();
+
+  if(!map(sequence,true)) return false;
+
+
+  std::vector<std::uint64_t> sequences;
+
+  segments(directory_,sequences);
+
+  for(std::size_t index = 0 ; index + SEGMENT_NUMBER < sequences.size() ; ++index)
+  {
+    unlink(segment_path(directory_,sequences[index]).c_str());
+  }
+
+
+  return true;
+}
+
+
+journal_record * audit_journal::segment_records() const
+{
+  return reinterpret_cast<journal_record *> (static_cast<char *> (mapping_)
+                                             + sizeof(header));
+}
+
+audit_journal::header * audit_journal::segment_header() const
+{
+  return static_cast<header *> (mapping_);
+}
+
+}
@@ -0,0 +1,177 @@
+#ifndef GEMINI_AUDIT_JOURNAL
+#define GEMINI_AUDIT_JOURNAL
+
+
+// std
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+// gemini
+#include <descriptor.hpp>
+
+
+namespace gemini
+{
+
+enum journal_decision{JOURNAL_BLOCK,JOURNAL_UNBLOCK};
+
+// kernel driver detached or attached, the attempt failed or the driver was
+// attached outside of the daemon
+enum journal_outcome{JOURNAL_DONE,JOURNAL_FAILED,JOURNAL_EXTERNAL};
+
+
+// fixed size record of a block or unblock
+struct journal_record
+{
+  // microseconds since the epoch
+  std::uint64_t time;
+
+  // device fingerprint (descriptor::fingerprint) and interface descriptor
+  std::uint64_t fingerprint;
+  std::uint32_t info[DESCRIPTOR_SIZE];
+
+  // position of the deciding rule in the saved rule set (pins first),
+  // NO_RULE if no rule matched
+  std::uint32_t rule;
+
+  std::uint8_t  interface_number,
+                decision,
+                outcome,
+                reserved[5];
+
+  std::string const info_line() const;
+
+  static const std::uint32_t NO_RULE;
+};
+
+// journal_query selects records in [from,to] of a device, unset (0) device
+// fields match every device
+struct journal_query
+{
+  std::uint64_t          from,
+                         to,
+                         fingerprint;
+
+  descriptor::value_type bus,
+                         port,
+                         vendor_id,
+                         product_id;
+};
+
+
+// append only journal of enforcement decisions in memory mapped segment
+// files of a directory, the oldest segment is removed after SEGMENT_NUMBER
+// segments, enforcement threads only enqueue (lock free), the queued records
+// are drained and appended later
+class audit_journal
+{
+  public :
+
+  audit_journal(std::string const& directory);
+  ~audit_journal();
+
+  audit_journal(audit_journal const&)              = delete;
+  audit_journal & operator = (audit_journal const&) = delete;
+
+  // continue the latest segment or start a new one, fails without directory
+  bool open();
+  void close();
+
+  bool is_open() const;
+
+  // safe from every thread, returns false if the queue is full (the record
+  // is dropped)
+  bool enqueue(journal_record const& record);
+
+  // take the queued records, one thread at a time
+  void drain(std::vector<journal_record> & records);
+
+  // append records in time order, a record earlier than the latest of the
+  // segment (the clock stepped back) starts a new segment
+  void append(std::vector<journal_record> & records);
+
+  // records matching the query in segment order, in time order within a
+  // segment, segments outside the time range or without the device are
+  // skipped, binary search within segments
+  static bool read(std::string const& directory,journal_query const& query,
+                   std::vector<journal_record> & records);
+
+  static std::uint64_t now();
+
+
+  static const std::size_t QUEUE_SIZE,
+                           SEGMENT_RECORDS,
+                           SEGMENT_NUMBER;
+
+
+  private :
+
+  static const std::uint32_t MAGIC,
+                             VERSION;
+
+  struct header
+  {
+    std::uint32_t magic,
+                  version,
+                  record_size,
+                  capacity;
+    std::uint64_t sequence,
+                  count,
+                  first_time,
+                  last_time;
+
+    // bloom filter of fingerprints, vendor:product and bus:port keys
+    std::uint64_t devices[8];
+  };
+
+  // sequenced slot of the bounded queue (Vyukov)
+  struct cell
+  {
+    std::atomic<std::uint64_t> sequence;
+    journal_record             data;
+  };
+
+
+  static std::size_t file_size();
+
+  static std::string const segment_path(std::string const& directory,
+                                        std::uint64_t sequence);
+
+  // sequence numbers of the segments in the directory, ascending, false if
+  // the directory can't be read
+  static bool segments(std::string const& directory,
+                       std::vector<std::uint64_t> & sequences);
+
+  static void remember(header & segment_header,std::uint64_t key);
+  static bool contains(header const& segment_header,std::uint64_t key);
+
+  static bool selected(journal_record const& record,journal_query const& query);
+
+  // map segment sequence, create makes a new segment, existing segments of
+  // another layout fail
+  bool map(std::uint64_t sequence,bool create);
+  void unmap();
+
+  // start segment sequence after the current one, drop the oldest segments
+  bool start(std::uint64_t sequence);
+
+  header         * segment_header() const;
+  journal_record * segment_records() const;
+
+
+  std::string directory_;
+
+  int         file_descriptor_;
+  void      * mapping_;
+
+  std::unique_ptr<cell[]>    cells_;
+  std::atomic<std::uint64_t> tail_;
+  std::uint64_t              head_;
+};
+
+}
+
+#endif // GEMINI_AUDIT_JOURNAL
@@ -0,0 +1,117 @@
+// std
+#include <algorithm>
+#include <chrono>
+
+// class
+#include <benchmark.hpp>
+
+
+namespace gemini
+{
+
+benchmark::benchmark(std::ostream & out,std::string const& filter,
+                     unsigned int min_time,unsigned short repetitions) :
+out_(out),
+filter_(filter),
+min_time_(min_time),
+repetitions_(std::max<unsigned short>(repetitions,1)),
+sink_(0)
+{}
+
+
+bool benchmark::enabled(std::string const& name) const
+{
+  return filter_.empty() || name.find(filter_) != std::string::npos;
+}
+
+
+void benchmark::run(std::string const& name,bench_parameters const& parameters,
+                    std::function<std::size_t()> const& operation,
+                    std::size_t op_number)
+{
+  if(!enabled(name)) return;
+
+
+  typedef std::chrono::steady_clock clock;
+
+  const clock::duration min_duration = std::chrono::milliseconds(min_time_);
+
+  std::size_t iterations = 1;
+
+
+  // calibrate, double the iterations until a repetition takes long enough
+  while(true)
+  {
+    clock::time_point start = clock::now();
+
+    for(std::size_t iteration = 0 ; iteration < iterations ; ++iteration)
+    {
+      sink_ += operation();
+    }
+
+    if(clock::now() - start >= min_duration) break;
+
+    iterations *= 2;
+  }
+
+
+  std::vector<double> ns_per_op;
+
+  for(unsigned short repetition = 0 ; repetition < repetitions_ ; ++repetition)
+  {
+    clock::time_point start = clock::now();
+
+    for(std::size_t iteration = 0 ; iteration < iterations ; ++iteration)
+    {
+      sink_ += operation();
+    }
+
+    double elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>
+                     (clock::now() - start).count();
+
+    ns_per_op.push_back(elapsed / (iterations * op_number));
+  }
+
+  std::sort(ns_per_op.begin(),ns_per_op.end());
+
+
+  out_ << "{\"benchmark\":\"" << name << "\"";
+
+  for(auto parameter_it = parameters.begin() ;
+           parameter_it != parameters.end()   ; ++parameter_it)
+  {
+    out_ << ",\"" << parameter_it->first << "\":" << parameter_it->second;
+  }
+
+  out_ << ",\"iterations\":"    << iterations * op_number
+       << ",\"repetitions\":"   << repetitions_
+       << ",\"ns_per_op\":"     << ns_per_op[ns_per_op.size() / 2]
+       << ",\"ns_per_op_min\":" << ns_per_op.front()
+       << ",\"ns_per_op_max\":" << ns_per_op.back()
+       << "}" << std::endl;
+}
+
+void benchmark::report(std::string const& name,
+                       bench_parameters const& parameters,
+                       double ns_per_op,std::size_t iterations)
+{
+  if(!enabled(name)) return;
+
+
+  out_ << "{\"benchmark\":\"" << name << "\"";
+
+  for(auto parameter_it = parameters.begin() ;
+           parameter_it != parameters.end()   ; ++parameter_it)
+  {
+    out_ << ",\"" << parameter_it->first << "\":" << parameter_it->second;
+  }
+
+  out_ << ",\"iterations\":"    << iterations
+       << ",\"repetitions\":"   << 1
+       << ",\"ns_per_op\":"     << ns_per_op
+       << ",\"ns_per_op_min\":" << ns_per_op
+       << ",\"ns_per_op_max\":" << ns_per_op
+       << "}" << std::endl;
+}
+
+}
@@ -0,0 +1,56 @@
+#ifndef GEMINI_BENCHMARK
+#define GEMINI_BENCHMARK
+
+
+// std
+#include <functional>
+#include <ostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+
+namespace gemini
+{
+
+// parameter name and value of a benchmark case
+typedef std::vector<std::pair<std::string,double> > bench_parameters;
+
+// measures operations and writes one json object per case and line
+class benchmark
+{
+  public :
+
+  benchmark(std::ostream & out,std::string const& filter = "",
+            unsigned int min_time = 200,unsigned short repetitions = 5);
+
+  // benchmark name contains the filter
+  bool enabled(std::string const& name) const;
+
+  // measure an operation, every call performs op_number operations, the
+  // returned value keeps the compiler from removing the work
+  void run(std::string const& name,bench_parameters const& parameters,
+           std::function<std::size_t()> const& operation,
+           std::size_t op_number = 1);
+
+  // write a single measured value (for operations that can't be repeated)
+  void report(std::string const& name,bench_parameters const& parameters,
+              double ns_per_op,std::size_t iterations = 1);
+
+
+  private :
+
+  std::ostream & out_;
+
+  std::string    filter_;
+
+  // minimum time of a repetition (milliseconds)
+  unsigned int   min_time_;
+  unsigned short repetitions_;
+
+  std::size_t    sink_;
+};
+
+}
+
+#endif // GEMINI_BENCHMARK
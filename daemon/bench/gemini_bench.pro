@@ -0,0 +1,18 @@
+TARGET    = gemini_bench
+
+TEMPLATE  = app
+
+CONFIG   += console
+CONFIG   += c++11
+CONFIG   -= app_bundle
+
+QT       += core
+QT       += network
+QT       -= gui
+
+SOURCES  += main.cpp \
+            benchmark.cpp
+
+HEADERS  += benchmark.hpp
+
+include(../gemini_core.pri)
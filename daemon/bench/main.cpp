@@ -0,0 +1,619 @@
+// posix
+#include <ftw.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// std
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <random>
+
+// gemini
+#include <benchmark.hpp>
+#include <control.hpp>
+#include <simulated_backend.hpp>
+#include <sysfs_backend.hpp>
+
+
+namespace
+{
+  // value ranges of generated descriptors (small, so rules actually match)
+  const unsigned short BUS_RANGE  = 4,
+                       PORT_RANGE = 8,
+                       ID_RANGE   = 64;
+
+  const unsigned short CLASSES[] = {LIBUSB_CLASS_AUDIO,LIBUSB_CLASS_COMM,
+                                    LIBUSB_CLASS_HID,LIBUSB_CLASS_PRINTER,
+                                    LIBUSB_CLASS_MASS_STORAGE,
+                                    LIBUSB_CLASS_VIDEO,LIBUSB_CLASS_WIRELESS,
+                                    LIBUSB_CLASS_VENDOR_SPEC};
+
+
+  // random descriptor, every field is masked with probability mask_density
+  gemini::descriptor random_descriptor(std::mt19937 & random,
+                                       double mask_density)
+  {
+    // extended fields stay masked, measurements stay comparable
+    gemini::descriptor::info_type info{};
+
+    const unsigned short range[] = {BUS_RANGE,PORT_RANGE,ID_RANGE,ID_RANGE,
+                                    sizeof(CLASSES) / sizeof(CLASSES[0])};
+
+    for(unsigned short index = BUS ; index != INTERFACE_SUBCLASS ; ++index)
+    {
+      if(std::generate_canonical<double,32>(random) < mask_density)
+      {
+        info[index] = MASKED;
+      }
+
+      else
+      {
+        unsigned short value =
+
+        std::uniform_int_distribution<unsigned short>(1,range[index])(random);
+
+        info[index] = index == INTERFACE_CLASS ? CLASSES[value - 1] : value;
+      }
+    }
+
+    return gemini::descriptor(info);
+  }
+
+  gemini::rule random_rule(std::mt19937 & random,double mask_density)
+  {
+    return gemini::rule(random_descriptor(random,mask_density),
+                        std::bernoulli_distribution(0.5)(random));
+  }
+
+  // product id block of a random vendor ("VENDOR_ID 12 PRODUCT_ID 8-23")
+  gemini::rule random_range_rule(std::mt19937 & random)
+  {
+    std::uniform_int_distribution<unsigned short> id(1,ID_RANGE);
+
+    unsigned short first = id(random);
+
+    return gemini::rule("VENDOR_ID " + std::to_string(id(random)) +
+                        " PRODUCT_ID " + std::to_string(first) + "-" +
+                        std::to_string(first + id(random) / 4) +
+                        " PERMISSION " +
+                        std::to_string(std::bernoulli_distribution(0.5)(random)));
+  }
+
+  void random_rule_set(gemini::rule_set & rules,std::mt19937 & random,
+                       unsigned int rule_number,double mask_density)
+  {
+    rules.clear();
+
+    for(unsigned int index = 0 ; index < rule_number ; ++index)
+    {
+      rules.push_back(random_rule(random,mask_density));
+    }
+  }
+
+
+  // sysfs attribute with line feed
+  void write_attribute(std::string const& path,std::string const& value)
+  {
+    std::ofstream(path) << value << "\n";
+  }
+
+
+  // descriptors attribute of a device, the other configurations are left out
+  std::string raw_descriptors(libusb_device_descriptor const& dev_desc,
+                              libusb_config_descriptor const& config_desc)
+  {
+    std::string raw;
+
+    auto byte = [&raw](unsigned int value) { raw.push_back(value & 0xff); };
+    auto word = [&byte](unsigned int value) { byte(value); byte(value >> 8); };
+    auto extra = [&raw](unsigned char const* data,int length)
+    {
+      if(data != nullptr) raw.append(reinterpret_cast<char const*> (data),length);
+    };
+
+    byte(dev_desc.bLength);
+    byte(dev_desc.bDescriptorType);
+    word(dev_desc.bcdUSB);
+    byte(dev_desc.bDeviceClass);
+    byte(dev_desc.bDeviceSubClass);
+    byte(dev_desc.bDeviceProtocol);
+    byte(dev_desc.bMaxPacketSize0);
+    word(dev_desc.idVendor);
+    word(dev_desc.idProduct);
+    word(dev_desc.bcdDevice);
+    byte(dev_desc.iManufacturer);
+    byte(dev_desc.iProduct);
+    byte(dev_desc.iSerialNumber);
+    byte(dev_desc.bNumConfigurations);
+
+    // wTotalLength is patched in once the configuration is written
+    std::size_t config_position = raw.size();
+
+    byte(config_desc.bLength);
+    byte(config_desc.bDescriptorType);
+    word(0);
+    byte(config_desc.bNumInterfaces);
+    byte(config_desc.bConfigurationValue);
+    byte(config_desc.iConfiguration);
+    byte(config_desc.bmAttributes);
+    byte(config_desc.MaxPower);
+    extra(config_desc.extra,config_desc.extra_length);
+
+    for(uint8_t intf = 0 ; intf < config_desc.bNumInterfaces ; ++intf)
+    {
+      libusb_interface const& interface = config_desc.interface[intf];
+
+      for(int setting = 0 ; setting < interface.num_altsetting ; ++setting)
+      {
+        libusb_interface_descriptor const& intf_desc = interface.altsetting[setting];
+
+        byte(intf_desc.bLength);
+        byte(intf_desc.bDescriptorType);
+        byte(intf_desc.bInterfaceNumber);
+        byte(intf_desc.bAlternateSetting);
+        byte(intf_desc.bNumEndpoints);
+        byte(intf_desc.bInterfaceClass);
+        byte(intf_desc.bInterfaceSubClass);
+        byte(intf_desc.bInterfaceProtocol);
+        byte(intf_desc.iInterface);
+        extra(intf_desc.extra,intf_desc.extra_length);
+
+        for(uint8_t endpoint = 0 ; endpoint < intf_desc.bNumEndpoints ; ++endpoint)
+        {
+          libusb_endpoint_descriptor const& ep_desc = intf_desc.endpoint[endpoint];
+
+          byte(ep_desc.bLength);
+          byte(ep_desc.bDescriptorType);
+          byte(ep_desc.bEndpointAddress);
+          byte(ep_desc.bmAttributes);
+          word(ep_desc.wMaxPacketSize);
+          byte(ep_desc.bInterval);
+
+          if(ep_desc.bLength >= LIBUSB_DT_ENDPOINT_AUDIO_SIZE)
+          {
+            byte(ep_desc.bRefresh);
+            byte(ep_desc.bSynchAddress);
+          }
+
+          extra(ep_desc.extra,ep_desc.extra_length);
+        }
+      }
+    }
+
+    std::size_t total_length = raw.size() - config_position;
+
+    raw[config_position + 2] = total_length & 0xff;
+    raw[config_position + 3] = total_length >> 8;
+
+    return raw;
+  }
+
+
+  // synthetic sysfs tree of a simulated population, every interface is bound
+  // to usbhid
+  void write_sysfs_tree(std::string const& root,
+                        gemini::simulated_backend & population)
+  {
+    std::string usb_path     = root + "/bus/usb/",
+                devices_path = usb_path + "devices/",
+                driver_path  = usb_path + "drivers/usbhid/";
+
+    for(std::string const& path : {root,root + "/bus",usb_path,devices_path,
+                                   usb_path + "drivers",driver_path})
+    {
+      mkdir(path.c_str(),S_IRWXU);
+    }
+
+    write_attribute(driver_path + "unbind","");
+    write_attribute(usb_path + "drivers_probe","");
+
+
+    std::vector<gemini::device_backend::device_type *> devices;
+
+    population.enumerate(devices);
+
+    for(std::size_t index = 0 ; index < devices.size() ; ++index)
+    {
+      libusb_device_descriptor   dev_desc;
+      libusb_config_descriptor * config_desc;
+
+      population.device_descriptor(devices[index],dev_desc);
+      population.config_descriptor(devices[index],&config_desc);
+
+      // behind a hub of its own, names stay unique
+      std::string port = std::to_string(index + 1) + "."
+                       + std::to_string(population.port_number(devices[index])),
+                  name = std::to_string(population.bus_number(devices[index]))
+                       + "-" + port,
+                  path = devices_path + name + "/";
+
+      mkdir(path.c_str(),S_IRWXU);
+
+      write_attribute(path + "busnum",
+                      std::to_string(population.bus_number(devices[index])));
+      write_attribute(path + "devnum",
+                      std::to_string(population.device_address(devices[index])));
+      write_attribute(path + "devpath",port);
+      std::ofstream(path + "descriptors",std::ios::binary)
+      << raw_descriptors(dev_desc,*config_desc);
+
+      write_attribute(path + "bConfigurationValue",
+                      std::to_string(config_desc->bConfigurationValue));
+      write_attribute(path + "manufacturer","Bench Vendor");
+      write_attribute(path + "product","Bench Product");
+
+      for(uint8_t intf = 0 ; intf < config_desc->bNumInterfaces ; ++intf)
+      {
+        std::string intf_path = path + name + ":"
+                              + std::to_string(config_desc->bConfigurationValue)
+                              + "." + std::to_string(config_desc->interface[intf]
+                                                     .altsetting[0]
+                                                     .bInterfaceNumber)
+                              + "/";
+
+        mkdir(intf_path.c_str(),S_IRWXU);
+
+        symlink("../../../../bus/usb/drivers/usbhid",
+                (intf_path + "driver").c_str());
+      }
+
+      population.free_config_descriptor(config_desc);
+    }
+  }
+
+  void remove_tree(std::string const& root)
+  {
+    nftw(root.c_str(),[](char const* path,struct stat const*,int,FTW *)
+    {
+      return std::remove(path);
+    },16,FTW_DEPTH | FTW_PHYS);
+  }
+
+
+  struct options
+  {
+    std::string  filter,
+                 output;
+    unsigned int min_time;
+    unsigned short repetitions;
+    bool         quick;
+  };
+}
+
+
+int main(int argc,char * argv[])
+{
+  options opt = {"","",200,5,false};
+
+  for(int arg = 1 ; arg < argc ; ++arg)
+  {
+    if(std::strcmp(argv[arg],"--filter") == 0 && arg + 1 < argc)
+    {
+      opt.filter = argv[++arg];
+    }
+
+    else if(std::strcmp(argv[arg],"--output") == 0 && arg + 1 < argc)
+    {
+      opt.output = argv[++arg];
+    }
+
+    else if(std::strcmp(argv[arg],"--min-time") == 0 && arg + 1 < argc)
+    {
+      opt.min_time = std::stoi(argv[++arg]);
+    }
+
+    else if(std::strcmp(argv[arg],"--repetitions") == 0 && arg + 1 < argc)
+    {
+      opt.repetitions = std::stoi(argv[++arg]);
+    }
+
+    else if(std::strcmp(argv[arg],"--quick") == 0)
+    {
+      opt.quick = true;
+    }
+
+    else
+    {
+      std::cerr << "usage: gemini_bench [--filter <name>] [--output <file>]"
+                << " [--min-time <ms>] [--repetitions <n>] [--quick]"
+                << std::endl;
+
+      return EXIT_FAILURE;
+    }
+  }
+
+
+  std::ofstream output_file;
+
+  if(!opt.output.empty()) output_file.open(opt.output);
+
+  gemini::benchmark bench(opt.output.empty() ? std::cout : output_file,
+                          opt.filter,opt.min_time,opt.repetitions);
+
+  std::mt19937 random(5489);
+
+
+  // parameter sets
+  const std::vector<double>       mask_densities = {0.0,0.25,0.5,0.75,1.0};
+  const std::vector<unsigned int> rule_numbers   = opt.quick ?
+
+                                  std::vector<unsigned int>{10,100} :
+                                  std::vector<unsigned int>{10,100,1000,10000};
+  const std::vector<unsigned int> device_numbers = opt.quick ?
+
+                                  std::vector<unsigned int>{10,100} :
+                                  std::vector<unsigned int>{10,100,1000,5000};
+  const std::vector<unsigned int> intf_numbers   = {1,4,16};
+
+  // descriptors of present interfaces (nothing masked)
+  const std::size_t               batch_size = 1024;
+
+  std::vector<gemini::descriptor> interfaces;
+
+  for(std::size_t index = 0 ; index < batch_size ; ++index)
+  {
+    interfaces.push_back(random_descriptor(random,0.0));
+  }
+
+
+  // descriptor::relevant()
+  for(auto density_it = mask_densities.begin() ;
+           density_it != mask_densities.end()   ; ++density_it)
+  {
+    std::vector<gemini::descriptor> rule_descs;
+
+    for(std::size_t index = 0 ; index < batch_size ; ++index)
+    {
+      rule_descs.push_back(random_descriptor(random,*density_it));
+    }
+
+    bench.run("descriptor::relevant",{{"mask_density",*density_it}},
+              [&rule_descs,&interfaces]()
+    {
+      std::size_t relevant = 0;
+
+      for(std::size_t index = 0 ; index < rule_descs.size() ; ++index)
+      {
+        relevant += rule_descs[index].relevant(interfaces[index]);
+      }
+
+      return relevant;
+    },batch_size);
+  }
+
+
+  // descriptor::info()
+  for(unsigned short readable = 0 ; readable < 2 ; ++readable)
+  {
+    bench.run("descriptor::info",{{"readable",readable}},
+              [&interfaces,readable]()
+    {
+      std::size_t length = 0;
+
+      for(auto desc_it = interfaces.begin() ; desc_it != interfaces.end() ; ++desc_it)
+      {
+        length += desc_it->info(readable).size();
+      }
+
+      return length;
+    },batch_size);
+  }
+
+
+  // rule::rule(std::string)
+  for(auto density_it = mask_densities.begin() ;
+           density_it != mask_densities.end()   ; ++density_it)
+  {
+    std::vector<std::string> rule_strings;
+
+    for(std::size_t index = 0 ; index < batch_size ; ++index)
+    {
+      rule_strings.push_back(random_rule(random,*density_it).info(false));
+    }
+
+    bench.run("rule::rule(std::string)",{{"mask_density",*density_it}},
+              [&rule_strings]()
+    {
+      std::size_t permitted = 0;
+
+      for(auto string_it = rule_strings.begin() ;
+               string_it != rule_strings.end()   ; ++string_it)
+      {
+        permitted += gemini::rule(*string_it).evaluate(gemini::descriptor());
+      }
+
+      return permitted;
+    },batch_size);
+  }
+
+
+  // rule_set::permission()
+  for(auto rule_it = rule_numbers.begin() ; rule_it != rule_numbers.end() ; ++rule_it)
+  {
+    for(auto density_it = mask_densities.begin() ;
+             density_it != mask_densities.end()   ; ++density_it)
+    {
+      gemini::rule_set rules("");
+
+      random_rule_set(rules,random,*rule_it,*density_it);
+
+      bench.run("rule_set::permission",{{"rules",*rule_it},
+                                        {"mask_density",*density_it}},
+                [&rules,&interfaces]()
+      {
+        std::size_t permitted = 0;
+
+        for(auto desc_it = interfaces.begin() ; desc_it != interfaces.end() ; ++desc_it)
+        {
+          permitted += rules.permission(*desc_it);
+        }
+
+        return permitted;
+      },batch_size);
+    }
+  }
+
+
+  // rule_set::permission(), product id ranges
+  for(auto rule_it = rule_numbers.begin() ; rule_it != rule_numbers.end() ; ++rule_it)
+  {
+    gemini::rule_set rules("");
+
+    for(unsigned int index = 0 ; index < *rule_it ; ++index)
+    {
+      rules.push_back(random_range_rule(random));
+    }
+
+    bench.run("rule_set::permission(ranges)",{{"rules",*rule_it}},
+              [&rules,&interfaces]()
+    {
+      std::size_t permitted = 0;
+
+      for(auto desc_it = interfaces.begin() ; desc_it != interfaces.end() ; ++desc_it)
+      {
+        permitted += rules.permission(*desc_it);
+      }
+
+      return permitted;
+    },batch_size);
+  }
+
+
+  // rule_set::load()
+  for(auto rule_it = rule_numbers.begin() ; rule_it != rule_numbers.end() ; ++rule_it)
+  {
+    std::string path("/tmp/gemini_bench.rules");
+
+    gemini::rule_set rules(path);
+
+    random_rule_set(rules,random,*rule_it,0.5);
+
+    rules.save();
+
+    bench.run("rule_set::load",{{"rules",*rule_it}},[&rules,&path]()
+    {
+      rules.load(path);
+
+      return static_cast<std::size_t> (rules.fingerprint());
+    });
+
+    std::remove(path.c_str());
+  }
+
+
+  // control::enforce_rule_set(), simulated devices
+  for(auto device_it = device_numbers.begin() ;
+           device_it != device_numbers.end()   ; ++device_it)
+  {
+    for(auto intf_it = intf_numbers.begin() ; intf_it != intf_numbers.end() ; ++intf_it)
+    {
+      gemini::simulation_config config;
+
+      config.device_number  = *device_it;
+      config.min_interfaces = *intf_it;
+      config.max_interfaces = *intf_it;
+
+      gemini::bench_parameters parameters = {{"devices",*device_it},
+                                             {"interfaces",*intf_it},
+                                             {"rules",100},
+                                             {"mask_density",0.5}};
+
+      gemini::control control
+
+      (std::unique_ptr<gemini::device_backend>
+
+       (new gemini::simulated_backend(config)),"");
+
+      random_rule_set(control.rule_set_,random,100,0.5);
+
+
+      // first pass after start, decision cache is empty
+      auto start = std::chrono::steady_clock::now();
+
+      control.enforce_rule_set();
+
+      bench.report("control::enforce_rule_set(cold)",parameters,
+                   std::chrono::duration_cast<std::chrono::nanoseconds>
+                   (std::chrono::steady_clock::now() - start).count());
+
+
+      bench.run("control::enforce_rule_set",parameters,[&control]()
+      {
+        control.enforce_rule_set();
+
+        return static_cast<std::size_t> (0);
+      });
+
+      bench.run("control::enforce_rule_set(gather)",parameters,[&control]()
+      {
+        control.enforce_rule_set(true);
+
+        return control.interface_info().size();
+      });
+    }
+  }
+
+
+  // control::enforce_rule_set(), synthetic sysfs tree, the system calls of a
+  // pass compare with strace -c of the daemon on the libusb backend
+  for(auto device_it = device_numbers.begin() ;
+           device_it != device_numbers.end()   ; ++device_it)
+  {
+    if(!bench.enabled("control::enforce_rule_set(sysfs)")) break;
+
+
+    gemini::simulation_config config;
+
+    config.device_number  = *device_it;
+    config.min_interfaces = 4;
+    config.max_interfaces = 4;
+
+    gemini::simulated_backend population(config);
+
+    std::string root("/tmp/gemini_bench_sysfs");
+
+    remove_tree(root);
+    write_sysfs_tree(root,population);
+
+
+    gemini::sysfs_backend * sysfs = new gemini::sysfs_backend(root);
+
+    gemini::control control(std::unique_ptr<gemini::device_backend>(sysfs),
+                            "","","");
+
+    random_rule_set(control.rule_set_,random,100,0.5);
+
+    // first pass reads every device
+    std::uint64_t syscalls = sysfs->syscalls();
+
+    control.enforce_rule_set();
+
+    std::uint64_t cold_syscalls = sysfs->syscalls() - syscalls;
+
+    syscalls = sysfs->syscalls();
+
+    control.enforce_rule_set();
+
+
+    gemini::bench_parameters parameters =
+
+    {{"devices",*device_it},{"interfaces",4},{"rules",100},
+     {"mask_density",0.5},{"syscalls_cold",cold_syscalls},
+     {"syscalls_per_pass",sysfs->syscalls() - syscalls}};
+
+    bench.run("control::enforce_rule_set(sysfs)",parameters,[&control]()
+    {
+      control.enforce_rule_set();
+
+      return static_cast<std::size_t> (0);
+    });
+
+    remove_tree(root);
+  }
+
+
+  return EXIT_SUCCESS;
+}
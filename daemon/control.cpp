@@ -1,272 +1,1423 @@
 #include <algorithm>
+#include <cstring>
+#include <cstdio>
 #include <iostream>
+#include <iterator>
 #include <control.hpp>
+#include <libusb_backend.hpp>
+#include <metrics.hpp>
+#include <trace_buffer.hpp>
 
 namespace gemini
 {
 
-control::control()
+namespace
 {
-  device_list_.init();
+  // rule could match an interface of the device (interface fields aren't
+  // known, serials are read later)
+  bool device_match(rule const& r,descriptor const& device_desc)
+  {
+    const unsigned short device_fields[] = {BUS,PORT,VENDOR_ID,PRODUCT_ID,
+                                            DEVICE_CLASS};
+
+    for(auto field_it = std::begin(device_fields) ;
+             field_it != std::end(device_fields)  ; ++field_it)
+    {
+      if(!r.uses(*field_it)) continue;
+
+      value_set const values = r.values(*field_it);
+
+      bool inside = false;
+
+      for(auto range_it = values.begin() ; range_it != values.end() ; ++range_it)
+      {
+        if(range_it->first <= device_desc[*field_it] &&
+           device_desc[*field_it] <= range_it->last) inside = true;
+      }
+
+      if(!inside) return false;
+    }
+
+    return true;
+  }
+}
+
+
+const std::size_t    control::DECISION_CACHE_SIZE = 4096;
+
+const unsigned short control::RETRY_ATTEMPTS      = 8;
+const unsigned int   control::RETRY_DELAY         = 200;
+
+const unsigned int   control::VERIFICATION_BUDGET = 2000;
+
+
+control::control(std::unique_ptr<device_backend> backend,
+                 std::string const& state_path,
+                 std::string const& journal_path,
+                 std::string const& history_path,
+                 std::uint64_t history_budget) :
+presence_(history_path,history_budget),
+backend_(std::move(backend)),
+decision_fingerprint_(0),
+state_(state_path),
+state_changed_(false),
+journal_(journal_path),
+pass_(0),
+verify_cursor_(0)
+{
+  if(!backend_) backend_.reset(new libusb_backend());
+
+  // backends probed by the caller (authorization support) are initialized
+  // once, init writes authorized_default and walks the buses again
+  if(backend_->init_error() != LIBUSB_SUCCESS) backend_->init();
+
+  // continue with the state of the previous daemon instance
+  if(state_.open())
+  {
+    state_.load(disabled_,decisions_,decision_fingerprint_);
+  }
+
+  journal_.open();
+
+  presence_.open();
+}
+
+
+void control::enforce_rule_set(bool gather_intf_info)
+{
+  // library was correct initialized
+  if(backend_->init_error() == LIBUSB_SUCCESS)
+  {
+    trace_scope pass_trace("enforce_rule_set");
+
+    // present devices
+    std::vector<device_type *> devices;
+    std::vector<std::uint32_t> keys;
+
+    // new, changed and failing devices are enforced at once, the others are
+    // verified in the background (ordered by key)
+    std::vector<std::pair<device_type *,instance *> > urgent;
+    std::map<std::uint32_t,device_type *>             background;
+
+    clock::time_point start = clock::now();
+
+
+    // a new rule set is enforced on every device at once
+    bool rules_changed = validate_decisions();
+
+
+    // scan new device list
+    scan_time_ = clock::now();
+
+    {
+      trace_scope scan_trace("scan");
+
+      backend_->enumerate(devices);
+    }
+
+    ++pass_;
+
+    metrics().devices_scanned.add(devices.size());
+    metrics().devices_present.set(devices.size());
+
+    for(auto device_it = devices.begin() ; device_it != devices.end() ; ++device_it)
+    {
+      keys.push_back(instance_key(*device_it));
+
+      auto instance_it = instances_.find(keys.back());
+
+      if(instance_it == instances_.end())
+      {
+        instance device_instance = {pass_,true,descriptor(),false,MASKED,0,
+                                   "","",""};
+
+        instance_it = instances_.insert
+
+                      (std::make_pair(keys.back(),device_instance)).first;
+      }
+
+      instance & device_instance = instance_it->second;
+
+      device_instance.last_pass = pass_;
+
+
+      if(device_instance.urgent || rules_changed ||
+         (gather_intf_info && device_instance.product_string.empty()))
+      {
+        urgent.push_back(std::make_pair(*device_it,&device_instance));
+      }
+
+      else
+      {
+        background.insert(std::make_pair(keys.back(),*device_it));
+
+        // waiting for verification isn't departing
+        present(device_instance.device_desc);
+      }
+    }
+
+
+    // arrival to block latency doesn't depend on the attached devices
+    for(auto urgent_it = urgent.begin() ; urgent_it != urgent.end() ; ++urgent_it)
+    {
+      enforce_device(urgent_it->first,gather_intf_info,*urgent_it->second);
+
+      metrics().devices_prioritized.add();
+    }
+
+
+    // re-verify enforced devices round robin (drivers bound by hand), at
+    // least one device a pass
+    {
+      trace_scope verification_trace("verification");
+
+      clock::time_point verification_start = clock::now();
+
+      auto background_it = background.upper_bound(verify_cursor_);
+
+      for(std::size_t verified = 0 ; verified < background.size() ; ++verified)
+      {
+        if(background_it == background.end()) background_it = background.begin();
+
+        if(verified > 0 && clock::now() - verification_start >=
+           std::chrono::microseconds(VERIFICATION_BUDGET)) break;
+
+
+        enforce_device(background_it->second,gather_intf_info,
+                       instances_[background_it->first]);
+
+        verify_cursor_ = background_it->first;
+
+        metrics().devices_verified.add();
+
+        ++background_it;
+      }
+    }
+
+
+    // interface info of every present device, unverified devices report
+    // their latest verification
+    if(gather_intf_info)
+    {
+      intf_info_.clear();
+
+      for(auto key_it = keys.begin() ; key_it != keys.end() ; ++key_it)
+      {
+        std::string const& intf_info = instances_[*key_it].intf_info;
+
+        if(!intf_info.empty()) intf_info_.push_back(intf_info);
+      }
+    }
+
+
+    store_state();
+
+    finish_pass(start);
+  }
+}
+
+
+void control::initial_sweep()
+{
+  // library was correct initialized
+  if(backend_->init_error() == LIBUSB_SUCCESS)
+  {
+    trace_scope pass_trace("initial_sweep");
+
+    // present devices
+    std::vector<device_type *> devices;
+
+    // devices and their instances grouped by bus number
+    std::map<uint8_t,std::vector<std::pair<device_type *,instance *> > >
+    bus_devices;
+
+    // bus workers
+    std::vector<std::thread> workers;
+
+    clock::time_point start = clock::now();
+
+
+    validate_decisions();
+
+
+    // scan new device list
+    scan_time_ = clock::now();
+
+    {
+      trace_scope scan_trace("scan");
+
+      backend_->enumerate(devices);
+    }
+
+    ++pass_;
+
+    metrics().devices_scanned.add(devices.size());
+    metrics().devices_present.set(devices.size());
+
+    // instances are created before the workers share the map
+    for(auto device_it = devices.begin() ; device_it != devices.end() ; ++device_it)
+    {
+      instance & device_instance = instances_[instance_key(*device_it)];
+
+      device_instance.last_pass = pass_;
+
+      bus_devices[backend_->bus_number(*device_it)].push_back
+
+      (std::make_pair(*device_it,&device_instance));
+    }
+
+
+    // one worker for every bus, buses don't share devices
+    for(auto bus_it = bus_devices.begin() ; bus_it != bus_devices.end() ; ++bus_it)
+    {
+      std::vector<std::pair<device_type *,instance *> > const& bus =
+
+      bus_it->second;
+
+      workers.push_back(std::thread([this,&bus]()
+      {
+        for(auto device_it = bus.begin() ; device_it != bus.end() ; ++device_it)
+        {
+          enforce_device(device_it->first,false,*device_it->second);
+        }
+      }));
+    }
+
+    // wait until every bus is enforced
+    for(auto worker_it = workers.begin() ; worker_it != workers.end() ; ++worker_it)
+    {
+      worker_it->join();
+    }
+
+
+    store_state();
+
+    finish_pass(start);
+  }
+}
+
+
+// kernel driver bound to an interface, the prohibited interface is detached
+// again without a pass over every device
+bool control::enforce_interface(std::uint8_t bus,
+                                std::vector<std::uint8_t> const& ports,
+                                std::uint8_t interface_number)
+{
+  bool found = false;
+
+  // library wasn't correct initialized
+  if(backend_->init_error() != LIBUSB_SUCCESS || ports.empty()) return found;
+
+
+  const std::uint8_t port = ports.back();
+
+  trace_scope interface_trace("enforce_interface",(bus << 8) | port);
+
+  std::vector<device_type *> devices;
+
+  backend_->enumerate(devices);
+
+  for(auto device_it = devices.begin() ; device_it != devices.end() ; ++device_it)
+  {
+    device_type * device = *device_it;
+
+    // devices behind other hubs can have the same last port
+    std::uint8_t device_ports[7];
+
+    int port_number = backend_->bus_number(device) != bus ? 0 :
+
+                      backend_->port_numbers(device,device_ports,
+                                             sizeof(device_ports));
+
+    if(port_number <= 0 ||
+       std::vector<std::uint8_t>(device_ports,device_ports + port_number) != ports)
+    {
+      continue;
+    }
+
+    found = true;
+
+
+    libusb_device_descriptor   device_descriptor;
+    libusb_config_descriptor * config_descriptor;
+
+    if(backend_->device_descriptor(device,device_descriptor) != LIBUSB_SUCCESS ||
+       backend_->config_descriptor(device,&config_descriptor) != LIBUSB_SUCCESS)
+    {
+      continue;
+    }
+
+
+    descriptor rule_desc;
+
+    rule_desc.read_device_address(bus,port);
+    rule_desc.read_device_descriptor(device_descriptor);
+
+    const descriptor device_desc(rule_desc);
+
+    bool storming,
+         known,
+         attempt;
+
+    {
+      std::lock_guard<std::mutex> lock(state_mutex_);
+
+      storming = storms_.storming(rule_desc,clock::now());
+
+      // failing devices cost no work until their next attempt, like in a
+      // pass, unknown devices are attempted and registered by the next pass
+      auto arrival_it = arrivals_.find(device_desc);
+
+      known   = arrival_it != arrivals_.end();
+      attempt = !known ||
+                (arrival_it->second.state != STATE_FAILED_TO_BLOCK &&
+                 clock::now() >= arrival_it->second.next_attempt);
+    }
+
+    // serial of the latest pass, a new instance is read now
+    auto instance_it = instances_.find(instance_key(device));
+
+    if(instance_it != instances_.end() && instance_it->second.serial_read)
+    {
+      rule_desc[SERIAL_HASH] = instance_it->second.serial_hash;
+    }
+
+    else if(!storming && rule_set_.uses(SERIAL_HASH))
+    {
+      bool open_failed = false;
+
+      rule_desc[SERIAL_HASH] = read_serial_hash(device,device_descriptor,
+                                                open_failed);
+    }
+
+    std::uint64_t fingerprint =
+
+    instance_it != instances_.end() && instance_it->second.fingerprint != 0 ?
+    instance_it->second.fingerprint :
+    descriptor::fingerprint(device_descriptor,*config_descriptor);
+
+
+    bool attempted_intf = false,
+         failed         = false;
+
+    // storming devices wait for their pass
+    for(uint8_t intf = 0 ; !storming && attempt &&
+                           intf < config_descriptor->bNumInterfaces ; ++intf)
+    {
+      libusb_interface const& interface = config_descriptor->interface[intf];
+
+      if(interface.num_altsetting == 0 ||
+         interface.altsetting[0].bInterfaceNumber != interface_number) continue;
+
+
+      latency_stamps stamps = {clock::now(),clock::time_point(),false};
+
+      bool intf_permission = true;
+
+      for(int setting = 0 ; setting < interface.num_altsetting ; ++setting)
+      {
+        rule_desc.read_interface_descriptor(interface.altsetting[setting]);
+
+        if(!permission(rule_desc,fingerprint))
+        {
+          stamps.decided = clock::now();
+
+          if(!disable(device,intf,rule_desc,fingerprint,stamps)) failed = true;
+
+          metrics().uevent_enforcements.add();
+
+          attempted_intf  = true;
+          intf_permission = false;
+
+          break;
+        }
+      }
+
+      // permitted interfaces of an authorizing backend get their driver now
+      if(intf_permission && backend_->blocks_by_default())
+      {
+        if(!enable(device,intf,rule_desc,fingerprint)) failed = true;
+
+        attempted_intf = true;
+      }
+    }
+
+    // failures back off the next attempt of the pass and of uevents
+    if(known && attempted_intf) attempted(device_desc,failed,false);
+
+
+    // important frees allocated memory from config descriptor
+    backend_->free_config_descriptor(config_descriptor);
+  }
+
+
+  store_state();
+
+
+  return found;
+}
+
+
+// enforce rule set on every interface of a device, returns false if the
+// descriptors of the device couldn't be read
+bool control::enforce_device(device_type * device,bool gather_intf_info,
+                             instance & device_instance)
+{
+  // libusb native typs
+  libusb_config_descriptor      * config_descriptor;
+  libusb_device_descriptor        device_descriptor;
+  libusb_interface                interface;
+  libusb_interface_descriptor     interface_descriptor;
+
+  // libusb errors
+  int device_descriptor_error = 0,
+      config_descriptor_error = 0;
+
+  // gemini native types
+  descriptor                      rule_desc;
+
+  // device information
+  std::string                   & intf_info = device_instance.intf_info;
+
+  std::string                     product_string("undefined"),
+                                  vendor_string("undefined");
+
+  bool                            intf_permission,
+                                  settled = true;
+
+  latency_stamps                  stamps;
+
+  const std::uint16_t             address = trace_address(device);
+
+  trace_scope                     device_trace("enforce_device",address);
+
+
+  {
+    trace_scope             descriptor_trace("read_descriptors",address);
+    device_profiler::scope  descriptor_cost(profiler_,address,COST_DESCRIPTOR);
+
+    // try to read device descriptor
+    device_descriptor_error =
+
+    backend_->device_descriptor(device,device_descriptor);
+
+    // try to read config descriptor
+    config_descriptor_error =
+
+    backend_->config_descriptor(device,&config_descriptor);
+
+    if(device_descriptor_error != LIBUSB_SUCCESS ||
+       config_descriptor_error != LIBUSB_SUCCESS   ) descriptor_cost.fail();
+  }
+
+  // device descriptor couldn't be read
+  if(device_descriptor_error != LIBUSB_SUCCESS)
+  {
+    // config descriptor has allocated memory
+    if(config_descriptor_error == LIBUSB_SUCCESS)
+    {
+      // important frees allocated memory from config descriptor
+      backend_->free_config_descriptor(config_descriptor);
+    }
+
+    device_instance.urgent = true;
+
+    return false;
+  }
+
+  // config descriptor couldn't be read
+  if(config_descriptor_error != LIBUSB_SUCCESS)
+  {
+    device_instance.urgent = true;
+
+    return false;
+  }
+
+  // gather device information
+  rule_desc.read_device_address(backend_->bus_number(device),
+                                backend_->port_number(device));
+  rule_desc.read_device_descriptor(device_descriptor);
+
+
+  // device seen first in this pass, measure its way to be blocked
+  const descriptor device_desc(rule_desc);
+
+  profiler_.identify(address,device_desc);
+
+  device_instance.device_desc = device_desc;
+
+  arrival device_arrival = arrived(device_desc);
+
+  stamps.seen     = device_arrival.seen;
+  stamps.arriving = !device_arrival.settled;
+
+
+  // failing devices cost no work until their next attempt
+  const bool attempt = device_arrival.state != STATE_FAILED_TO_BLOCK &&
+                       clock::now() >= device_arrival.next_attempt;
+
+  bool       failed  = false;
+
+
+  // string descriptors are read once per instance, strings of a storming
+  // device aren't worth an open every cycle
+  if(gather_intf_info && device_instance.product_string.empty() &&
+     attempt && !device_arrival.storming)
+  {
+    bool open_failed = false;
+
+    product_string =
+
+    read_string_descriptor(device,device_descriptor.iProduct,open_failed);
+
+    vendor_string  =
+
+    read_string_descriptor(device,device_descriptor.iManufacturer,open_failed);
+
+    std::replace(product_string.begin(),product_string.end(),' ','_');
+    std::replace(vendor_string.begin(),vendor_string.end(),' ','_');
+
+    if(open_failed) failed = true;
+
+    else
+    {
+      device_instance.product_string = product_string;
+      device_instance.vendor_string  = vendor_string;
+    }
+  }
+
+  else if(!device_instance.product_string.empty())
+  {
+    product_string = device_instance.product_string;
+    vendor_string  = device_instance.vendor_string;
+  }
+
+  // serial numbers cost an open, they are read if a rule needs them only
+  if(rule_set_.uses(SERIAL_HASH) && !device_instance.serial_read &&
+     attempt && !device_arrival.storming)
+  {
+    bool open_failed = false;
+
+    device_instance.serial_hash =
+
+    read_serial_hash(device,device_descriptor,open_failed);
+
+    if(open_failed) failed = true;
+
+    else            device_instance.serial_read = true;
+  }
+
+  rule_desc[SERIAL_HASH] = device_instance.serial_hash;
+
+  // descriptors of an instance don't change, hashed once per arrival
+  if(device_instance.fingerprint == 0)
+  {
+    device_instance.fingerprint =
+
+    descriptor::fingerprint(device_descriptor,*config_descriptor);
+  }
+
+  // device description
+  intf_info = product_string
+            + " "
+            + vendor_string
+            + rule_desc.device_info()
+            + " "
+            + std::to_string(config_descriptor->bNumInterfaces);
+
+
+  // for every interface on specific device config
+  for(uint8_t intf = 0 ; intf < config_descriptor->bNumInterfaces; ++intf)
+  {
+    // reset interface permission
+    intf_permission = true;
+
+    // get actual interface
+    interface = config_descriptor->interface[intf];
+
+
+    intf_info += " " + std::to_string(interface.num_altsetting);
+
+
+    // for every setting on interface
+    for(int setting = 0 ; setting < interface.num_altsetting ; ++setting)
+    {
+      // get interface descriptor for setting
+      interface_descriptor = interface.altsetting[setting];
+
+
+      // gather interface information
+      rule_desc.read_interface_descriptor(interface_descriptor);
+
+      metrics().interfaces_enforced.add();
+
+      // append setting interface class
+      intf_info += " " + std::to_string(interface_descriptor.bInterfaceClass);
+
+
+      if(intf_permission)
+      {
+        bool setting_permission = permission(rule_desc,
+                                             device_instance.fingerprint);
+
+        stamps.decided = clock::now();
+
+        // first decision on the interface of an arriving device
+        if(setting == 0 && device_arrival.first_pass == pass_)
+        {
+          arrival_to_decision_.record
+
+          (std::chrono::duration_cast<std::chrono::microseconds>
+           (stamps.decided - stamps.seen).count());
+        }
+
+
+        // actual interface is prohibited
+        if(setting_permission == false)
+        {
+          // remove kernel driver
+          if(!attempt)
+          {
+            settled = false;
+          }
+
+          else if(!disable(device,intf,rule_desc,device_instance.fingerprint,
+                           stamps))
+          {
+            settled = false;
+            failed  = true;
+          }
+
+          intf_permission = false;
+        }
+
+        // actual interface is permitted and in disabled list or blocked
+        // until it is attached (authorization)
+        else if(attempt && (backend_->blocks_by_default() || disabled(rule_desc)))
+        {
+          // reattach kernel driver
+          if(!enable(device,intf,rule_desc,device_instance.fingerprint))
+          {
+            failed = true;
+          }
+        }
+      }
+    }
+
+    // append permission on interface info string
+    if(intf_permission) intf_info += " 1";
+
+    // prohibited, but the kernel driver couldn't be detached
+    else if(device_arrival.state == STATE_FAILED_TO_BLOCK) intf_info += " 2";
+
+    else                intf_info += " 0";
+  }
+
+  // fingerprint follows the interfaces (clients pin devices with it)
+  char fingerprint[19];
+
+  std::snprintf(fingerprint,sizeof(fingerprint),"0x%016llx",
+                static_cast<unsigned long long> (device_instance.fingerprint));
+
+  intf_info += " ";
+  intf_info += fingerprint;
+
+
+  // important frees allocated memory from config descriptor
+  backend_->free_config_descriptor(config_descriptor);
+
+
+  device_state state = device_arrival.state;
+
+  if(attempt) state = attempted(device_desc,failed,settled);
+
+  // pending devices are retried ahead of the background verification
+  device_instance.urgent = state == STATE_PENDING;
+
+
+  return true;
+}
+
+
+// scheduled rules changed, only decisions and devices they match are redone
+bool control::schedule(std::time_t time)
+{
+  const std::uint64_t previous = rule_set_.fingerprint();
+
+  std::vector<rule> toggled;
+
+  rule_set_.advance(time,toggled);
+
+  if(toggled.empty()) return false;
+
+  metrics().schedule_transitions.add(toggled.size());
+
+
+  std::lock_guard<std::mutex> lock(state_mutex_);
+
+  // a cache of the previous activity keeps decisions of other interfaces,
+  // other caches are cleared by the next pass
+  if(decision_fingerprint_ == previous)
+  {
+    for(auto decision_it = decisions_.begin() ; decision_it != decisions_.end() ;)
+    {
+      bool matched = false;
+
+      for(auto rule_it = toggled.begin() ; rule_it != toggled.end() ; ++rule_it)
+      {
+        if(rule_it->evaluate(decision_it->first) != IGNORE) matched = true;
+      }
+
+      if(matched) decision_it = decisions_.erase(decision_it);
+
+      else ++decision_it;
+    }
+
+    decision_fingerprint_ = rule_set_.fingerprint();
+    state_changed_        = true;
+  }
+
+
+  for(auto instance_it = instances_.begin() ; instance_it != instances_.end() ;
+      ++instance_it)
+  {
+    descriptor const& device_desc = instance_it->second.device_desc;
+
+    bool matched = false;
+
+    for(auto rule_it = toggled.begin() ; rule_it != toggled.end() ; ++rule_it)
+    {
+      if(device_match(*rule_it,device_desc)) matched = true;
+    }
+
+    if(!matched) continue;
+
+    instance_it->second.urgent = true;
+
+    // the new activity deserves new attempts on failed devices
+    auto arrival_it = arrivals_.find(device_desc);
+
+    if(arrival_it != arrivals_.end() && arrival_it->second.state != STATE_BLOCKED)
+    {
+      arrival_it->second.state        = STATE_PENDING;
+      arrival_it->second.failures     = 0;
+      arrival_it->second.next_attempt = clock::time_point();
+    }
+  }
+
+
+  return true;
+}
+
+
+// get complete interface information
+std::vector<std::string> const control::interface_info() const
+{
+  return intf_info_;
 }
 
 
-void control::enforce_rule_set(bool gather_intf_info)
+// latency histograms of arriving devices and enforcement passes
+std::vector<std::string> const control::latency_info() const
 {
-  // library was correct initialized
-  if(device_list_.init_error() == LIBUSB_SUCCESS)
+  std::vector<std::string> latency_strings;
+
+  latency_strings.push_back("arrival_to_decision " + arrival_to_decision_.info());
+  latency_strings.push_back("decision_to_block "   + decision_to_block_.info());
+  latency_strings.push_back("arrival_to_block "    + arrival_to_block_.info());
+  latency_strings.push_back("pass_duration "       + pass_duration_.info());
+
+  return latency_strings;
+}
+
+
+// most expensive devices
+std::vector<std::string> const control::device_cost_info(std::size_t number) const
+{
+  return profiler_.top(number);
+}
+
+
+// rule set changed, cached decisions are invalid
+bool control::validate_decisions()
+{
+  std::lock_guard<std::mutex> lock(state_mutex_);
+
+  bool changed = decision_fingerprint_ != rule_set_.fingerprint();
+
+  if(changed)
   {
-    // libusb native typs
-    libusb_device                 * device;
-    libusb_config_descriptor      * config_descriptor;
-    libusb_device_descriptor        device_descriptor;
-    libusb_interface                interface;
-    libusb_interface_descriptor     interface_descriptor;
+    decisions_.clear();
+
+    decision_fingerprint_ = rule_set_.fingerprint();
+    state_changed_        = true;
 
-    // libusb errors
-    int device_descriptor_error = 0,
-        config_descriptor_error = 0;
 
-    // gemini native types
-    descriptor                      rule_desc;
-    std::list<descriptor>::iterator descriptor_iterator;
+    // the new rule set deserves new attempts on failed devices
+    for(auto arrival_it = arrivals_.begin() ; arrival_it != arrivals_.end() ; ++arrival_it)
+    {
+      if(arrival_it->second.state != STATE_BLOCKED)
+      {
+        arrival_it->second.state        = STATE_PENDING;
+        arrival_it->second.failures     = 0;
+        arrival_it->second.next_attempt = clock::time_point();
+      }
+    }
+  }
 
-    // device information strings
-    std::string                     intf_info(""),
-                                    product_string("undefined"),
-                                    vendor_string("undefined");
+  return changed;
+}
 
-    bool                            intf_permission;
 
+// decision of the rule set, cached until the rule set changes
+bool control::permission(descriptor const& intf_desc,std::uint64_t fingerprint)
+{
+  bool pin_permission;
 
+  // pinned devices skip the cache and the rules
+  if(rule_set_.pinned(fingerprint,pin_permission))
+  {
+    metrics().pinned_decisions.add();
 
-    // if method should gather device info strings, clear the old
-    if(gather_intf_info) intf_info_.clear();
+    return pin_permission;
+  }
 
+  {
+    std::lock_guard<std::mutex> lock(state_mutex_);
 
-    // scan new device list
-    ssize_t device_number = device_list_.scan();
+    auto decision_it = decisions_.find(intf_desc);
 
-    // for every usb device
-    for(ssize_t device_id = 0 ; device_id < device_number ; ++device_id)
+    if(decision_it != decisions_.end())
     {
-      // get actual device
-      device = device_list_.get_device();
+      metrics().cache_hits.add();
 
+      // the deciding rule counts every decision, hot rules are reordered
+      rule_set_.hit(decision_it->second.rule);
 
-      // try to read device descriptor
-      device_descriptor_error =
+      return decision_it->second.permission;
+    }
+  }
 
-      libusb_get_device_descriptor(device,&device_descriptor);
+  metrics().cache_misses.add();
 
-      // try to read config descriptor
-      config_descriptor_error = 
 
-      libusb_get_active_config_descriptor(device,&config_descriptor);
+  // evaluate without lock, bus workers shouldn't wait for each other
+  cached_decision decision;
 
-      // device descriptor couldn't be read
-      if(device_descriptor_error != LIBUSB_SUCCESS)
-      {
-        // config descriptor has allocated memory
-        if(config_descriptor_error == LIBUSB_SUCCESS)
-        {
-          // important frees allocated memory from config descriptor
-          libusb_free_config_descriptor(config_descriptor);
-        }
+  decision.permission = rule_set_.permission(intf_desc,decision.rule);
 
-        continue;
+  bool intf_permission = decision.permission;
+
+
+  std::lock_guard<std::mutex> lock(state_mutex_);
+
+  // keep the cache (and the state file) bounded
+  if(decisions_.size() >= DECISION_CACHE_SIZE) decisions_.clear();
+
+  decisions_.insert(std::make_pair(intf_desc,decision));
+
+  state_changed_ = true;
+
+
+  return intf_permission;
+}
+
+
+// devices are new until a scan misses them
+control::arrival const control::arrived(descriptor const& device_desc)
+{
+  std::lock_guard<std::mutex> lock(state_mutex_);
+
+  auto arrival_it = arrivals_.find(device_desc);
+
+  if(arrival_it == arrivals_.end())
+  {
+    arrival device_arrival = {scan_time_,pass_,pass_,false,
+                              STATE_PENDING,0,clock::time_point(),
+                              storms_.arrival(device_desc,scan_time_)};
+
+    arrival_it = arrivals_.insert(std::make_pair(device_desc,device_arrival)).first;
+  }
+
+  // device re-enumerated during a storm, one arrival with its old state
+  else if(arrival_it->second.last_pass + 1 < pass_)
+  {
+    arrival & device_arrival = arrival_it->second;
+
+    device_arrival.storming = storms_.arrival(device_desc,scan_time_);
+
+    // the new instance has its kernel drivers again, enforce it at once
+    device_arrival.next_attempt = clock::time_point();
+
+    if(device_arrival.state == STATE_FAILED_TO_BLOCK)
+    {
+      device_arrival.state    = STATE_PENDING;
+      device_arrival.failures = RETRY_ATTEMPTS - 1;
+    }
+  }
+
+  else
+  {
+    arrival_it->second.storming = storms_.storming(device_desc,scan_time_);
+  }
+
+  arrival_it->second.last_pass = pass_;
+
+
+  return arrival_it->second;
+}
+
+
+// device waits for the background verification
+void control::present(descriptor const& device_desc)
+{
+  std::lock_guard<std::mutex> lock(state_mutex_);
+
+  auto arrival_it = arrivals_.find(device_desc);
+
+  if(arrival_it != arrivals_.end()) arrival_it->second.last_pass = pass_;
+}
+
+
+// failed attempts delay the next attempt, exponential backoff
+control::device_state control::attempted(descriptor const& device_desc,
+                                         bool failed,bool settled)
+{
+  std::lock_guard<std::mutex> lock(state_mutex_);
+
+  arrival & device_arrival = arrivals_[device_desc];
+
+  // later detaches (rule set changes) are no arrivals anymore
+  if(settled) device_arrival.settled = true;
+
+
+  if(!failed)
+  {
+    device_arrival.state    = STATE_BLOCKED;
+    device_arrival.failures = 0;
+  }
+
+  else if(++device_arrival.failures >= RETRY_ATTEMPTS)
+  {
+    device_arrival.state = STATE_FAILED_TO_BLOCK;
+
+    metrics().enforcement_failures.add();
+  }
+
+  else
+  {
+    device_arrival.state        = STATE_PENDING;
+    device_arrival.next_attempt = clock::now() + std::chrono::milliseconds
+
+                                  (RETRY_DELAY << (device_arrival.failures - 1));
+
+    metrics().enforcement_failures.add();
+  }
+
+  return device_arrival.state;
+}
+
+
+void control::finish_pass(clock::time_point const& start)
+{
+  {
+    std::lock_guard<std::mutex> lock(state_mutex_);
+
+    std::int64_t pending = 0,
+                 failed  = 0;
+
+    clock::time_point now = clock::now();
+
+    storms_.expire(now);
+
+    for(auto arrival_it = arrivals_.begin() ; arrival_it != arrivals_.end() ;)
+    {
+      arrival const& device_arrival = arrival_it->second;
+
+      if(device_arrival.last_pass == pass_)
+      {
+        if(device_arrival.state == STATE_PENDING)         ++pending;
+        if(device_arrival.state == STATE_FAILED_TO_BLOCK) ++failed;
       }
 
-      // config descriptor couldn't be read
-      if(config_descriptor_error != LIBUSB_SUCCESS)
+      // storming devices keep their state while they are away
+      else if(!storms_.storming(arrival_it->first,now))
       {
+        arrival_it = arrivals_.erase(arrival_it);
+
         continue;
       }
 
-      // gather device information
-      rule_desc.read_device_address(device);
-      rule_desc.read_device_descriptor(device_descriptor);
+      ++arrival_it;
+    }
 
-      // gather device information
-      if(gather_intf_info)
-      {
-        product_string =
+    metrics().devices_pending.set(pending);
+    metrics().devices_failed_to_block.set(failed);
+  }
 
-        read_string_descriptor(device,device_descriptor.iProduct);
+  std::time_t now = std::time(nullptr);
 
-        vendor_string  =
+  for(auto instance_it = instances_.begin() ; instance_it != instances_.end() ;)
+  {
+    instance const& device_instance = instance_it->second;
 
-        read_string_descriptor(device,device_descriptor.iManufacturer);
+    if(device_instance.last_pass != pass_)
+    {
+      instance_it = instances_.erase(instance_it);
 
-        std::replace(product_string.begin(),product_string.end(),' ','_');
-        std::replace(vendor_string.begin(),vendor_string.end(),' ','_');
+      continue;
+    }
 
-        // append device description
-        intf_info = product_string
-                  + " "
-                  + vendor_string
-                  + rule_desc.device_info()
-                  + " "
-                  + std::to_string(config_descriptor->bNumInterfaces);
-      }
+    // instances are devices once they were enforced
+    if(device_instance.fingerprint != 0)
+    {
+      descriptor const& desc = device_instance.device_desc;
 
+      presence_device device = {device_instance.fingerprint,
+                                static_cast<std::uint16_t> (desc[VENDOR_ID]),
+                                static_cast<std::uint16_t> (desc[PRODUCT_ID]),
+                                static_cast<std::uint8_t>  (desc[BUS]),
+                                static_cast<std::uint8_t>  (desc[PORT])};
 
-      // for every interface on specific device config
-      for(uint8_t intf = 0 ; intf < config_descriptor->bNumInterfaces; ++intf)
-      {
-        // reset interface permission
-        intf_permission = true;
+      presence_.seen(instance_it->first,device,now);
+    }
 
-        // get actual interface
-        interface = config_descriptor->interface[intf];
+    ++instance_it;
+  }
 
+  // departed devices are disconnected
+  presence_.finish(now);
 
-        if(gather_intf_info)
-        {
-          intf_info += " " + std::to_string(interface.num_altsetting);
-        }
 
+  std::int64_t duration = std::chrono::duration_cast<std::chrono::microseconds>
+                          (clock::now() - start).count();
 
-        // for every setting on interface
-        for(int setting = 0 ; setting < interface.num_altsetting ; ++setting)
-        {
-          // get interface descriptor for setting
-          interface_descriptor = interface.altsetting[setting];
+  pass_duration_.record(duration);
 
+  profiler_.finish_pass();
 
-          // gather interface information
-          rule_desc.read_interface_descriptor(interface_descriptor);
+  metrics().passes.add();
+  metrics().pass_duration.add(duration);
+  metrics().last_pass_duration.set(duration);
+}
 
-          // append setting interface class
-          if(gather_intf_info)
-          {
-            intf_info += " "
-                      +  std::to_string(interface_descriptor.bInterfaceClass);
-          }
 
+// write state after changes, a restarted daemon continues with it
+void control::store_state()
+{
+  {
+    std::lock_guard<std::mutex> lock(state_mutex_);
 
-          // actual interface is prohibited
-          if(intf_permission && rule_set_.permission(rule_desc) == false)
-          {
-            // remove kernel driver
-            disable(device,intf,rule_desc);
+    if(state_changed_)
+    {
+      state_.store(disabled_,decisions_,decision_fingerprint_);
 
-            intf_permission = false;
-          }
+      state_changed_ = false;
+    }
+  }
 
-          // actual interface is permitted
-          else if(intf_permission)
-          {
-            // find interface in disabled list
-            descriptor_iterator = std::find(disabled_.begin(),
-                                            disabled_.end()  ,
-                                            rule_desc         );
-
-            // interface is in disabled list
-            if(descriptor_iterator != disabled_.end())
-            {
-              // reattach kernel driver
-              enable(device,intf,descriptor_iterator);
-            }
-          }
-        }
 
-        // append permission on interface info string
-        if(intf_permission) intf_info += " 1";
-        else                intf_info += " 0";
-      }
+  std::vector<journal_record> records;
 
+  journal_.drain(records);
 
-      // memorize actual interface info
-      if(gather_intf_info) intf_info_.push_back(intf_info);
+  // the rule set is the one of the enforcement (changes wait for the pass)
+  for(auto record_it = records.begin() ; record_it != records.end() ; ++record_it)
+  {
+    descriptor::info_type info;
 
+    std::copy(record_it->info,record_it->info + DESCRIPTOR_SIZE,info.begin());
 
-      // important frees allocated memory from config descriptor
-      libusb_free_config_descriptor(config_descriptor);   
-    }
+    std::size_t position = rule_set_.deciding_rule(descriptor(info),
+                                                   record_it->fingerprint);
+
+    record_it->rule = position == rule_index::NO_MATCH ?
+                      journal_record::NO_RULE : position;
   }
+
+  journal_.append(records);
+
+  metrics().journal_records.add(records.size());
 }
 
 
-// get complete interface information
-std::vector<std::string> const control::interface_info() const
+void control::journal(descriptor const& desc,std::uint64_t fingerprint,
+                      int interface_id,journal_decision decision,
+                      journal_outcome outcome)
 {
-  return intf_info_;
+  if(!journal_.is_open()) return;
+
+
+  journal_record record;
+
+  std::memset(&record,0,sizeof(record));
+
+  record.time        = audit_journal::now();
+  record.fingerprint = fingerprint;
+
+  for(unsigned short index = BUS ; index != UNDEFINED ; ++index)
+  {
+    record.info[index] = desc[index];
+  }
+
+  // resolved when the journal is written
+  record.rule             = journal_record::NO_RULE;
+  record.interface_number = interface_id;
+  record.decision         = decision;
+  record.outcome          = outcome;
+
+  if(!journal_.enqueue(record)) metrics().journal_dropped.add();
+}
+
+
+// interface was detached by the daemon
+bool control::disabled(descriptor const& intf_desc)
+{
+  std::lock_guard<std::mutex> lock(state_mutex_);
+
+  return std::find(disabled_.begin(),disabled_.end(),intf_desc)
+         != disabled_.end();
 }
 
 
 // disable a device for usb communication
-void control::disable(libusb_device * device , int interface_id ,
-                      descriptor const& desc)
+bool control::disable(device_type * device , int interface_id ,
+                      descriptor const& desc , std::uint64_t fingerprint ,
+                      latency_stamps const& stamps)
 {
-  libusb_device_handle * device_handle;
+  handle_type * device_handle;
+
+  bool blocked = false,
+       changed = false;
 
-  int open_error = libusb_open(device,&device_handle);
+  int open_error = open(device,&device_handle);
 
   if(open_error == LIBUSB_SUCCESS)
   {
-    int kernel_driver = libusb_kernel_driver_active(device_handle,interface_id); 
+    int kernel_driver = kernel_driver_active(device,device_handle,interface_id);
   
 
     if(kernel_driver == 1)
     {
-      int dettach_error = 
+      int dettach_error = 0;
 
-      libusb_detach_kernel_driver(device_handle,interface_id);
+      {
+        trace_scope            detach_trace("detach_kernel_driver",
+                                            trace_address(device));
+        device_profiler::scope detach_cost(profiler_,trace_address(device),
+                                           COST_DRIVER);
+
+        dettach_error = backend_->detach_kernel_driver(device_handle,interface_id);
+
+        if(dettach_error != LIBUSB_SUCCESS) detach_cost.fail();
+      }
 
       if(dettach_error == LIBUSB_SUCCESS)
       {
-        disabled_.push_back(desc);
+        clock::time_point detached = clock::now();
+
+        decision_to_block_.record
+
+        (std::chrono::duration_cast<std::chrono::microseconds>
+         (detached - stamps.decided).count());
+
+        if(stamps.arriving)
+        {
+          arrival_to_block_.record
+
+          (std::chrono::duration_cast<std::chrono::microseconds>
+           (detached - stamps.seen).count());
+        }
+
+
+        metrics().detach_successes.add();
+
+
+        std::lock_guard<std::mutex> lock(state_mutex_);
+
+        // re-enumerated devices are detached again, keep the list unique
+        if(std::find(disabled_.begin(),disabled_.end(),desc) == disabled_.end())
+        {
+          disabled_.push_back(desc);
+        }
+
+        state_changed_ = true;
+
+        blocked = true;
+        changed = true;
       }
+
+      else metrics().detach_failures.add();
     }
 
+    // no kernel driver bound to the interface
+    else if(kernel_driver == 0)
+    {
+      blocked = true;
+    }
+
+
+    backend_->close(device_handle);
+  }
+
 
-    libusb_close(device_handle);
+  // interfaces already without kernel driver aren't journaled
+  if(changed || !blocked)
+  {
+    journal(desc,fingerprint,interface_id,JOURNAL_BLOCK,
+            blocked ? JOURNAL_DONE : JOURNAL_FAILED);
   }
+
+
+  return blocked;
 }
 
 // enable a device for usb communication
-void control::enable(libusb_device * device , int interface_id,
-                     std::list<descriptor>::iterator desc_it)
+bool control::enable(device_type * device , int interface_id,
+                     descriptor const& desc , std::uint64_t fingerprint)
 {
-  libusb_device_handle * device_handle;
+  handle_type * device_handle;
+
+  bool attached = false;
 
-  int open_error = libusb_open(device,&device_handle);
+  journal_outcome outcome = JOURNAL_FAILED;
+
+  int open_error = open(device,&device_handle);
 
   if(open_error == LIBUSB_SUCCESS)
   {
-    int kernel_driver = libusb_kernel_driver_active(device_handle,interface_id); 
+    int kernel_driver = kernel_driver_active(device,device_handle,interface_id);
   
 
     if(kernel_driver == 0)
     {
-      int attach_error = 
+      int attach_error = 0;
+
+      {
+        trace_scope            attach_trace("attach_kernel_driver",
+                                            trace_address(device));
+        device_profiler::scope attach_cost(profiler_,trace_address(device),
+                                           COST_DRIVER);
+
+        attach_error = backend_->attach_kernel_driver(device_handle,interface_id);
 
-      libusb_attach_kernel_driver(device_handle,interface_id);
+        if(attach_error != LIBUSB_SUCCESS) attach_cost.fail();
+      }
 
       if(attach_error == LIBUSB_SUCCESS)
       {
-        disabled_.erase(desc_it);
+        metrics().attach_successes.add();
+
+
+        std::lock_guard<std::mutex> lock(state_mutex_);
+
+        disabled_.remove(desc);
+
+        state_changed_ = true;
+
+        attached = true;
+        outcome  = JOURNAL_DONE;
+      }
+
+      else metrics().attach_failures.add();
+    }
+
+    // kernel driver was attached by someone else, nothing left to enable
+    else if(kernel_driver == 1)
+    {
+      std::lock_guard<std::mutex> lock(state_mutex_);
+
+      std::size_t disabled_number = disabled_.size();
+
+      disabled_.remove(desc);
+
+      // permitted interfaces of an authorizing backend are checked every
+      // attempt, the state changes only if the interface was disabled
+      if(disabled_.size() != disabled_number)
+      {
+        state_changed_ = true;
+        outcome        = JOURNAL_EXTERNAL;
       }
+
+      attached = true;
     }
 
 
-    libusb_close(device_handle);
+    backend_->close(device_handle);
+  }
+
+
+  // attached interfaces that weren't disabled aren't journaled
+  if(!attached || outcome != JOURNAL_FAILED)
+  {
+    journal(desc,fingerprint,interface_id,JOURNAL_UNBLOCK,outcome);
   }
+
+
+  return attached;
+}
+
+
+// open a device handle and count it
+int control::open(device_type * device,handle_type ** device_handle)
+{
+  trace_scope            open_trace("open",trace_address(device));
+  device_profiler::scope open_cost(profiler_,trace_address(device),COST_OPEN);
+
+  int open_error = backend_->open(device,device_handle);
+
+  if(open_error != LIBUSB_SUCCESS) open_cost.fail();
+
+  if(open_error == LIBUSB_SUCCESS) metrics().handle_opens.add();
+  else                             metrics().handle_open_failures.add();
+
+  return open_error;
+}
+
+
+int control::kernel_driver_active(device_type * device,
+                                  handle_type * device_handle,int interface_id)
+{
+  trace_scope            driver_trace("kernel_driver_active",
+                                      trace_address(device));
+  device_profiler::scope driver_cost(profiler_,trace_address(device),
+                                     COST_DRIVER);
+
+  int kernel_driver = backend_->kernel_driver_active(device_handle,interface_id);
+
+  if(kernel_driver < 0) driver_cost.fail();
+
+
+  return kernel_driver;
+}
+
+
+// bus and port of a device for trace events
+std::uint16_t control::trace_address(device_type * device)
+{
+  return (backend_->bus_number(device) << 8) | backend_->port_number(device);
+}
+
+
+// bus, port and address identify an enumerated device
+std::uint32_t control::instance_key(device_type * device)
+{
+  return (backend_->bus_number(device) << 16) |
+         (backend_->port_number(device) << 8) | backend_->device_address(device);
 }
 
 
 // read a string descriptor of a device
 std::string const control::
 
-read_string_descriptor(libusb_device * device,uint8_t index)
+read_string_descriptor(device_type * device,uint8_t index,bool & open_failed)
 {
   std::string string_desc("undefined");
 
-  libusb_device_handle * device_handle;
+  handle_type * device_handle;
 
 
-  int open_error = libusb_open(device,&device_handle);
+  int open_error = open(device,&device_handle);
 
   if(open_error == LIBUSB_SUCCESS)
   {
@@ -275,9 +1426,20 @@ read_string_descriptor(libusb_device * device,uint8_t index)
     unsigned char * buffer = new unsigned char[max_length];
 
 
-    int char_number =
+    int char_number = 0;
+
+    {
+      trace_scope            string_trace("string_descriptor",
+                                          trace_address(device));
+      device_profiler::scope string_cost(profiler_,trace_address(device),
+                                         COST_STRING);
+
+      char_number =
+
+      backend_->string_descriptor(device_handle,index,buffer,max_length);
 
-    libusb_get_string_descriptor_ascii(device_handle,index,buffer,max_length);
+      if(char_number < 0) string_cost.fail();
+    }
 
 
     if(char_number > 0)
@@ -293,13 +1455,42 @@ read_string_descriptor(libusb_device * device,uint8_t index)
     }
 
 
-    delete buffer;
+    delete[] buffer;
 
-    libusb_close(device_handle);
+    backend_->close(device_handle);
   }
 
+  else open_failed = true;
+
 
   return string_desc;
 }
 
+
+// serial number string hashed for matching
+descriptor::value_type control::
+
+read_serial_hash(device_type                    * device,
+                 libusb_device_descriptor const& dev_desc,
+                 bool                           & open_failed)
+{
+  if(dev_desc.iSerialNumber == 0) return MASKED;
+
+
+  bool serial_failed = false;
+
+  std::string serial =
+
+  read_string_descriptor(device,dev_desc.iSerialNumber,serial_failed);
+
+  if(serial_failed)
+  {
+    open_failed = true;
+
+    return MASKED;
+  }
+
+  return descriptor::serial_hash(serial);
+}
+
 }
@@ -3,13 +3,25 @@
 
 
 // std
+#include <chrono>
+#include <ctime>
 #include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
 #include <vector>
 
 // gemini
+#include <audit_journal.hpp>
 #include <descriptor.hpp>
-#include <device_list.hpp>
+#include <device_backend.hpp>
+#include <device_profiler.hpp>
+#include <latency_histogram.hpp>
+#include <presence_history.hpp>
 #include <rule_set.hpp>
+#include <state_file.hpp>
+#include <storm_detector.hpp>
 
 
 namespace gemini
@@ -19,32 +31,237 @@ class control
 {
   public :
 
-  control();
+  // without backend real usb devices (libusb) are controlled, an empty state
+  // path disables the warm start state file, an empty journal path the audit
+  // journal and an empty history path the presence history on disk, the
+  // history is trimmed to its disk budget when it's opened
+  control(std::unique_ptr<device_backend> backend = nullptr,
+          std::string const& state_path =
+          rule_set::gemini_home_path() + "gemini.state",
+          std::string const& journal_path =
+          rule_set::gemini_home_path() + "journal",
+          std::string const& history_path =
+          rule_set::gemini_home_path() + "history",
+          std::uint64_t history_budget = presence_history::DEFAULT_BUDGET);
 
   void enforce_rule_set(bool gather_intf_info = false);
 
+  // enforcement pass with one worker thread per usb bus, used before the
+  // daemon starts its event loop
+  void initial_sweep();
+
+  // enforce the rule set on one interface (kernel driver bound outside of a
+  // pass), the device is at the port chain (uevent::ports), failing devices
+  // wait for their next attempt, returns false if no device is on the port
+  bool enforce_interface(std::uint8_t bus,
+                         std::vector<std::uint8_t> const& ports,
+                         std::uint8_t interface_number);
+
+  // activate and deactivate scheduled rules, devices a changed rule could
+  // match are enforced with the next pass, returns true if a rule changed
+  bool schedule(std::time_t time);
+
   // get interface info for client applications
   std::vector<std::string> const interface_info() const;
 
+  // latency histograms for client applications, one line per histogram
+  // "<name> <count> <p50> <p99> <max>" in microseconds
+  std::vector<std::string> const latency_info() const;
+
+  // most expensive devices for client applications (see device_profiler)
+  std::vector<std::string> const device_cost_info(std::size_t number) const;
+
 
   rule_set rule_set_;
 
+  // connections of enforced devices, updated after every pass
+  presence_history presence_;
+
 
   private :
 
-  void disable(libusb_device * device,int interface_id,descriptor const& desc);
+  typedef device_backend::device_type device_type;
+  typedef device_backend::handle_type handle_type;
+
+  typedef std::chrono::steady_clock   clock;
+
+  // enforcement of a device, failing devices are retried with exponential
+  // backoff until RETRY_ATTEMPTS attempts failed
+  enum device_state{STATE_PENDING,STATE_BLOCKED,STATE_FAILED_TO_BLOCK};
+
+  // device seen by the daemon, keyed by its device descriptor
+  struct arrival
+  {
+    clock::time_point seen;
+
+    // first and latest pass the device was seen in
+    unsigned long     first_pass,
+                      last_pass;
+
+    // every prohibited interface was without kernel driver once
+    bool              settled;
+
+    // enforcement state, failed attempts in a row and earliest next attempt
+    device_state      state;
+    unsigned short    failures;
+    clock::time_point next_attempt;
+
+    // port or identity of the device re-enumerate in a storm
+    bool              storming;
+  };
+
+  // enumerated device, keyed by bus << 16 | port << 8 | address (a
+  // re-enumerated device is a new instance)
+  struct instance
+  {
+    // latest pass the instance was enumerated in
+    unsigned long last_pass;
+
+    // enforce in the next pass ahead of the background verification
+    bool          urgent;
+
+    // device descriptor of the latest enforcement
+    descriptor    device_desc;
+
+    // serial number hash, read once if a rule matches on serials
+    bool                   serial_read;
+    descriptor::value_type serial_hash;
+
+    // hash over every descriptor (descriptor::fingerprint), 0 until the
+    // instance is enforced
+    std::uint64_t          fingerprint;
+
+    // string descriptors (empty until read) and interface info
+    std::string   product_string,
+                  vendor_string,
+                  intf_info;
+  };
+
+  // timestamps of an interface on its way to be blocked
+  struct latency_stamps
+  {
+    clock::time_point seen,
+                      decided;
+
+    bool              arriving;
+  };
+
+
+  // string descriptors are read if gather_intf_info is set
+  bool enforce_device(device_type * device,bool gather_intf_info,
+                      instance & device_instance);
+
+  // clear cached decisions of an old rule set, returns true if the rule set
+  // changed
+  bool validate_decisions();
+
+  // decision of a rule pinning the device fingerprint or the cached rule set
+  // decision for an interface
+  bool permission(descriptor const& intf_desc,std::uint64_t fingerprint);
 
-  void enable(libusb_device * device,int interface_id,
-              std::list<descriptor>::iterator desc_it);
+  // arrival of a device, the first scan seeing it sets its timestamp
+  arrival const arrived(descriptor const& device_desc);
 
-  std::string const read_string_descriptor(libusb_device * device_handle,
-                                           uint8_t         index         );
+  // device seen by a pass without being enforced
+  void present(descriptor const& device_desc);
 
+  // state after an enforcement attempt on a device
+  device_state attempted(descriptor const& device_desc,bool failed,
+                         bool settled);
 
-  device_list device_list_;
+  // forget departed devices and instances, record the pass duration
+  void finish_pass(clock::time_point const& start);
+
+  // write changed state to the state file and queued blocks and unblocks to
+  // the audit journal
+  void store_state();
+
+  // queue a block or unblock for the audit journal (lock free)
+  void journal(descriptor const& desc,std::uint64_t fingerprint,
+               int interface_id,journal_decision decision,
+               journal_outcome outcome);
+
+  bool disabled(descriptor const& intf_desc);
+
+  // returns true if the interface is without kernel driver
+  bool disable(device_type * device,int interface_id,descriptor const& desc,
+               std::uint64_t fingerprint,latency_stamps const& stamps);
+
+  // returns true if the interface has its kernel driver
+  bool enable(device_type * device,int interface_id,descriptor const& desc,
+              std::uint64_t fingerprint);
+
+  int open(device_type * device,handle_type ** device_handle);
+
+  int kernel_driver_active(device_type * device,handle_type * device_handle,
+                           int interface_id);
+
+  std::uint16_t trace_address(device_type * device);
+
+  std::uint32_t instance_key(device_type * device);
+
+  // open_failed is set if the device couldn't be opened
+  std::string const read_string_descriptor(device_type * device,
+                                           uint8_t       index ,
+                                           bool        & open_failed);
+
+  // hash of the serial number string, MASKED if the device has none
+  descriptor::value_type read_serial_hash(device_type                    * device,
+                                          libusb_device_descriptor const& dev_desc,
+                                          bool                           & open_failed);
+
+
+  std::unique_ptr<device_backend> backend_;
 
   std::list<descriptor>    disabled_;
   std::vector<std::string> intf_info_;
+
+  // decisions of the rule set with the fingerprint decision_fingerprint_
+  std::map<descriptor,cached_decision> decisions_;
+  std::uint64_t                        decision_fingerprint_;
+
+  // warm start state of the daemon
+  state_file                state_;
+  bool                      state_changed_;
+
+  // blocks and unblocks
+  audit_journal             journal_;
+
+  // present devices (departed devices are kept during storms) and
+  // enforcement pass counter
+  std::map<descriptor,arrival> arrivals_;
+  storm_detector            storms_;
+  unsigned long             pass_;
+  clock::time_point         scan_time_;
+
+  // present device instances and the latest instance verified in the
+  // background
+  std::map<std::uint32_t,instance> instances_;
+  std::uint32_t             verify_cursor_;
+
+  // guards disabled list, decisions, arrivals, storms and state during
+  // parallel enforcement
+  std::mutex                state_mutex_;
+
+  // device seen to interface decided, interface decided to kernel driver
+  // detached, device seen to kernel driver detached and enforcement pass
+  latency_histogram         arrival_to_decision_,
+                            decision_to_block_,
+                            arrival_to_block_,
+                            pass_duration_;
+
+  // usb operation costs of every device
+  device_profiler           profiler_;
+
+  static const std::size_t    DECISION_CACHE_SIZE;
+
+  // failed attempts until a device is given up, delay after the first
+  // failure (milliseconds, doubled with every failure)
+  static const unsigned short RETRY_ATTEMPTS;
+  static const unsigned int   RETRY_DELAY;
+
+  // time of a pass for re-verification of enforced devices (microseconds)
+  static const unsigned int   VERIFICATION_BUDGET;
 };
 
 }
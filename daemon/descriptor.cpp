@@ -6,21 +6,53 @@
 namespace gemini
 {
 
-descriptor::
+namespace
+{
+  const std::uint64_t FNV_OFFSET = 14695981039346656037ULL,
+                      FNV_PRIME  = 1099511628211ULL;
+
+  void hash_byte(std::uint64_t & hash,std::uint8_t byte)
+  {
+    hash ^= byte;
+    hash *= FNV_PRIME;
+  }
+
+  // multi byte fields are little endian on the wire
+  void hash_word(std::uint64_t & hash,std::uint16_t word)
+  {
+    hash_byte(hash,word & 0xff);
+    hash_byte(hash,word >> 8);
+  }
+
+  void hash_extra(std::uint64_t & hash,unsigned char const* extra,int length)
+  {
+    for(int position = 0 ; extra != nullptr && position < length ; ++position)
+    {
+      hash_byte(hash,extra[position]);
+    }
+  }
+}
 
-descriptor(unsigned short bus,
-           unsigned short port,
-           unsigned short product_id,
-           unsigned short vendor_id,
-           unsigned short interface_class) :
+descriptor::
 
-info_(std::array<unsigned short,DESCRIPTOR_SIZE>
-      {bus,port,vendor_id,product_id,interface_class})
+descriptor(value_type bus,
+           value_type port,
+           value_type vendor_id,
+           value_type product_id,
+           value_type interface_class,
+           value_type interface_subclass,
+           value_type interface_protocol,
+           value_type device_class,
+           value_type serial_hash) :
+
+info_(info_type{{bus,port,vendor_id,product_id,interface_class,
+                 interface_subclass,interface_protocol,device_class,
+                 serial_hash}})
 {}
 
 descriptor::
 
-descriptor(std::array<unsigned short,DESCRIPTOR_SIZE> const& info) :
+descriptor(info_type const& info) :
 
 info_(info)
 {}
@@ -28,41 +60,41 @@ info_(info)
 
 bool descriptor::relevant(descriptor const& descriptor) const
 {
-  bool relevant = true;
-
-  for(unsigned short index = BUS ; index != UNDEFINED ; ++index)
-  {
-    if(info_[index] != MASKED && info_[index] != descriptor[index])
-    {
-      relevant = false;
-    }
-  }
-
-  return relevant;
+  return field_match<BUS>::relevant(*this,descriptor);
 }
 
 
 void descriptor::
 
-read_device_address(libusb_device * device)
+read_device_address(uint8_t bus,uint8_t port)
 {
-  info_[BUS]    = libusb_get_bus_number(device);
-  info_[PORT]   = libusb_get_port_number(device);
+  info_[BUS]    = bus;
+  info_[PORT]   = port;
 }
 
 void descriptor::
 
 read_device_descriptor(libusb_device_descriptor const& dev_desc)
 {
-  info_[VENDOR_ID]  = dev_desc.idVendor;
-  info_[PRODUCT_ID] = dev_desc.idProduct;
+  info_[VENDOR_ID]    = dev_desc.idVendor;
+  info_[PRODUCT_ID]   = dev_desc.idProduct;
+  info_[DEVICE_CLASS] = dev_desc.bDeviceClass;
 }
 
 void descriptor::
 
 read_interface_descriptor(libusb_interface_descriptor const& intf_desc)
 {
-  info_[INTERFACE_CLASS] = intf_desc.bInterfaceClass;
+  info_[INTERFACE_CLASS]    = intf_desc.bInterfaceClass;
+  info_[INTERFACE_SUBCLASS] = intf_desc.bInterfaceSubClass;
+  info_[INTERFACE_PROTOCOL] = intf_desc.bInterfaceProtocol;
+}
+
+void descriptor::
+
+read_serial(std::string const& serial)
+{
+  info_[SERIAL_HASH] = serial_hash(serial);
 }
 
 
@@ -76,14 +108,9 @@ std::string const descriptor::info(bool readable) const
 
       if(readable)
       {
-        switch(index)
-        {
-          case BUS             : descriptor_info += "[BUS:";            break;
-          case PORT            : descriptor_info += "[PORT:";            break;
-          case VENDOR_ID       : descriptor_info += "[VENDOR ID:";       break;
-          case PRODUCT_ID      : descriptor_info += "[PRODUCT ID:";      break;
-          case INTERFACE_CLASS : descriptor_info += "[INTERFACE CLASS:"; break;
-        }
+        descriptor_info += "[";
+        descriptor_info += DESCRIPTOR_FIELDS[index].label;
+        descriptor_info += ":";
       }
 
       descriptor_info += std::to_string(info_[index])
@@ -93,6 +120,8 @@ std::string const descriptor::info(bool readable) const
     return descriptor_info;
 }
 
+// device values of interface info strings (clients parse bus, port, vendor
+// and product id)
 std::string const descriptor::device_info() const
 {
   std::string device_info;
@@ -107,16 +136,101 @@ std::string const descriptor::device_info() const
 }
 
 
-unsigned short descriptor::operator [] (unsigned short index) const
+std::uint64_t descriptor::
+
+fingerprint(libusb_device_descriptor const& dev_desc,
+            libusb_config_descriptor const& config_desc)
 {
-  return info_[index];
+  std::uint64_t hash = FNV_OFFSET;
+
+  hash_byte(hash,dev_desc.bLength);
+  hash_byte(hash,dev_desc.bDescriptorType);
+  hash_word(hash,dev_desc.bcdUSB);
+  hash_byte(hash,dev_desc.bDeviceClass);
+  hash_byte(hash,dev_desc.bDeviceSubClass);
+  hash_byte(hash,dev_desc.bDeviceProtocol);
+  hash_byte(hash,dev_desc.bMaxPacketSize0);
+  hash_word(hash,dev_desc.idVendor);
+  hash_word(hash,dev_desc.idProduct);
+  hash_word(hash,dev_desc.bcdDevice);
+  hash_byte(hash,dev_desc.iManufacturer);
+  hash_byte(hash,dev_desc.iProduct);
+  hash_byte(hash,dev_desc.iSerialNumber);
+  hash_byte(hash,dev_desc.bNumConfigurations);
+
+  hash_byte(hash,config_desc.bLength);
+  hash_byte(hash,config_desc.bDescriptorType);
+  hash_word(hash,config_desc.wTotalLength);
+  hash_byte(hash,config_desc.bNumInterfaces);
+  hash_byte(hash,config_desc.bConfigurationValue);
+  hash_byte(hash,config_desc.iConfiguration);
+  hash_byte(hash,config_desc.bmAttributes);
+  hash_byte(hash,config_desc.MaxPower);
+  hash_extra(hash,config_desc.extra,config_desc.extra_length);
+
+  for(uint8_t intf = 0 ; intf < config_desc.bNumInterfaces ; ++intf)
+  {
+    libusb_interface const& interface = config_desc.interface[intf];
+
+    for(int setting = 0 ; setting < interface.num_altsetting ; ++setting)
+    {
+      libusb_interface_descriptor const& intf_desc = interface.altsetting[setting];
+
+      hash_byte(hash,intf_desc.bLength);
+      hash_byte(hash,intf_desc.bDescriptorType);
+      hash_byte(hash,intf_desc.bInterfaceNumber);
+      hash_byte(hash,intf_desc.bAlternateSetting);
+      hash_byte(hash,intf_desc.bNumEndpoints);
+      hash_byte(hash,intf_desc.bInterfaceClass);
+      hash_byte(hash,intf_desc.bInterfaceSubClass);
+      hash_byte(hash,intf_desc.bInterfaceProtocol);
+      hash_byte(hash,intf_desc.iInterface);
+      hash_extra(hash,intf_desc.extra,intf_desc.extra_length);
+
+      for(uint8_t endpoint = 0 ; intf_desc.endpoint != nullptr &&
+                                endpoint < intf_desc.bNumEndpoints ; ++endpoint)
+      {
+        libusb_endpoint_descriptor const& ep_desc = intf_desc.endpoint[endpoint];
+
+        hash_byte(hash,ep_desc.bLength);
+        hash_byte(hash,ep_desc.bDescriptorType);
+        hash_byte(hash,ep_desc.bEndpointAddress);
+        hash_byte(hash,ep_desc.bmAttributes);
+        hash_word(hash,ep_desc.wMaxPacketSize);
+        hash_byte(hash,ep_desc.bInterval);
+
+        // audio endpoints
+        if(ep_desc.bLength >= LIBUSB_DT_ENDPOINT_AUDIO_SIZE)
+        {
+          hash_byte(hash,ep_desc.bRefresh);
+          hash_byte(hash,ep_desc.bSynchAddress);
+        }
+
+        hash_extra(hash,ep_desc.extra,ep_desc.extra_length);
+      }
+    }
+  }
+
+  // 0 pins no device
+  return hash == 0 ? 1 : hash;
 }
 
-unsigned short & descriptor::operator [] (unsigned short index)
+
+descriptor::value_type descriptor::serial_hash(std::string const& serial)
 {
-  return info_[index];
+  value_type hash = 2166136261U;
+
+  for(auto c_it = serial.begin() ; c_it != serial.end() ; ++c_it)
+  {
+    hash ^= static_cast<unsigned char> (*c_it);
+    hash *= 16777619U;
+  }
+
+  // a hash of MASKED would match every serial
+  return hash == MASKED ? 1 : hash;
 }
 
+
 bool operator == (descriptor const& i1,descriptor const& i2)
 {
   bool equal =  true;
@@ -129,6 +243,16 @@ bool operator == (descriptor const& i1,descriptor const& i2)
   return equal;
 }
 
+bool operator < (descriptor const& i1,descriptor const& i2)
+{
+  for(unsigned short index = BUS ; index != UNDEFINED ; ++index)
+  {
+    if(i1[index] != i2[index]) return i1[index] < i2[index];
+  }
+
+  return false;
+}
+
 // stream operator
 std::ostream  & operator << (std::ostream & out,descriptor const& intf_info)
 {
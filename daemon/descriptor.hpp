@@ -3,6 +3,7 @@
 
 
 #include <array>
+#include <cstdint>
 #include <fstream>
 
 #include <QtNetwork>
@@ -10,7 +11,9 @@
 #include <libusb-1.0/libusb.h>
 
 
-enum information_type{BUS,PORT,VENDOR_ID,PRODUCT_ID,INTERFACE_CLASS,UNDEFINED};
+enum information_type{BUS,PORT,VENDOR_ID,PRODUCT_ID,INTERFACE_CLASS,
+                      INTERFACE_SUBCLASS,INTERFACE_PROTOCOL,DEVICE_CLASS,
+                      SERIAL_HASH,UNDEFINED};
 enum mask{MASKED};
 
 #define DESCRIPTOR_SIZE UNDEFINED
@@ -18,40 +21,106 @@ enum mask{MASKED};
 namespace gemini
 {
 
+// field schema in information_type order, readable label and rule keyword
+// of every field
+struct descriptor_field
+{
+  char const* label;
+  char const* name;
+};
+
+constexpr descriptor_field DESCRIPTOR_FIELDS[DESCRIPTOR_SIZE] =
+{
+  {"BUS","BUS"},{"PORT","PORT"},{"VENDOR ID","VENDOR_ID"},
+  {"PRODUCT ID","PRODUCT_ID"},{"INTERFACE CLASS","INTERFACE_CLASS"},
+  {"INTERFACE SUBCLASS","INTERFACE_SUBCLASS"},
+  {"INTERFACE PROTOCOL","INTERFACE_PROTOCOL"},
+  {"DEVICE CLASS","DEVICE_CLASS"},{"SERIAL HASH","SERIAL_HASH"}
+};
+
+
 class descriptor
 {
   public :
 
-  descriptor(unsigned short bus             = MASKED ,
-             unsigned short port            = MASKED ,
-             unsigned short vendor_id       = MASKED ,
-             unsigned short product_id      = MASKED ,
-             unsigned short interface_class = MASKED  );
+  typedef std::uint32_t                               value_type;
+  typedef std::array<value_type,DESCRIPTOR_SIZE>      info_type;
+
+
+  descriptor(value_type bus                = MASKED ,
+             value_type port               = MASKED ,
+             value_type vendor_id          = MASKED ,
+             value_type product_id         = MASKED ,
+             value_type interface_class    = MASKED ,
+             value_type interface_subclass = MASKED ,
+             value_type interface_protocol = MASKED ,
+             value_type device_class       = MASKED ,
+             value_type serial_hash        = MASKED  );
+
+  descriptor(info_type const& info);
 
-  descriptor(std::array<unsigned short,DESCRIPTOR_SIZE> const& info);
+  // inline, every rule match reads fields
+  value_type   operator [] (unsigned short index) const
+  {
+    return info_[index];
+  }
 
-  unsigned short   operator [] (unsigned short index) const;
-  unsigned short & operator [] (unsigned short index);
+  value_type & operator [] (unsigned short index)
+  {
+    return info_[index];
+  }
 
   bool relevant(descriptor const& desc) const;
 
-  void read_device_address(libusb_device * device);
+  void read_device_address(uint8_t bus,uint8_t port);
   void read_device_descriptor(libusb_device_descriptor const& dev_desc);
   void read_interface_descriptor(libusb_interface_descriptor const& intf_desc);
+  void read_serial(std::string const& serial);
 
   std::string const info(bool readable) const;
   std::string const device_info() const;
 
+  // FNV-1a of a serial number string, never MASKED
+  static value_type serial_hash(std::string const& serial);
+
+  // FNV-1a over the device, config, interface and endpoint descriptors in
+  // their wire format (extra descriptors included), never 0
+  static std::uint64_t fingerprint(libusb_device_descriptor const& dev_desc,
+                                   libusb_config_descriptor const& config_desc);
+
 
   private :
 
-  std::array<unsigned short,DESCRIPTOR_SIZE> info_;
+  info_type info_;
 };
 
 bool operator == (descriptor const& d1,descriptor const& d2);
+bool operator  < (descriptor const& d1,descriptor const& d2);
 
 std::ostream  & operator << (std::ostream & out,descriptor const& descriptor);
 
+
+// field wise match unrolled at compile time, masked rule fields match every
+// value
+template<unsigned short INDEX>
+struct field_match
+{
+  static bool relevant(descriptor const& rule_desc,descriptor const& desc)
+  {
+    return (rule_desc[INDEX] == MASKED || rule_desc[INDEX] == desc[INDEX]) &&
+           field_match<INDEX + 1>::relevant(rule_desc,desc);
+  }
+};
+
+template<>
+struct field_match<DESCRIPTOR_SIZE>
+{
+  static bool relevant(descriptor const&,descriptor const&)
+  {
+    return true;
+  }
+};
+
 }
 
 
@@ -0,0 +1,27 @@
+#include <device_backend.hpp>
+
+
+namespace gemini
+{
+
+device_backend::~device_backend()
+{}
+
+
+int device_backend::port_numbers(device_type * device,uint8_t * ports,
+                                 int length)
+{
+  if(length < 1) return LIBUSB_ERROR_OVERFLOW;
+
+  ports[0] = port_number(device);
+
+  return 1;
+}
+
+
+bool device_backend::blocks_by_default() const
+{
+  return false;
+}
+
+}
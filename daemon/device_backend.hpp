@@ -0,0 +1,79 @@
+#ifndef GEMINI_DEVICE_BACKEND
+#define GEMINI_DEVICE_BACKEND
+
+
+// std
+#include <vector>
+
+// libusb
+#include <libusb-1.0/libusb.h>
+
+
+namespace gemini
+{
+
+// source of usb devices and kernel driver control, results and error codes
+// follow libusb (LIBUSB_SUCCESS, LIBUSB_ERROR_*), descriptors use the libusb
+// structures
+class device_backend
+{
+  public :
+
+  // opaque device and device handle of a backend
+  struct device_type;
+  struct handle_type;
+
+
+  virtual ~device_backend();
+
+  // init_error is LIBUSB_SUCCESS once init succeeded (backends without
+  // initialization always succeed)
+  virtual int init()             = 0;
+  virtual int init_error() const = 0;
+
+  // list every present device, returns the number of devices or an error
+  virtual ssize_t enumerate(std::vector<device_type *> & devices) = 0;
+
+  // device address
+  virtual uint8_t bus_number(device_type * device)  = 0;
+  virtual uint8_t port_number(device_type * device) = 0;
+
+  // ports from the root hub to the device (libusb_get_port_numbers), the
+  // last one is port_number, returns the number of ports or an error,
+  // backends without hubs return port_number alone
+  virtual int port_numbers(device_type * device,uint8_t * ports,int length);
+
+  // bus address, new with every enumeration of a device
+  virtual uint8_t device_address(device_type * device) = 0;
+
+  // descriptors (no device handle needed)
+  virtual int  device_descriptor(device_type * device,
+                                 libusb_device_descriptor & dev_desc)     = 0;
+  virtual int  config_descriptor(device_type * device,
+                                 libusb_config_descriptor ** config_desc) = 0;
+  virtual void free_config_descriptor(libusb_config_descriptor * config_desc)
+                                                                          = 0;
+
+  virtual int  open(device_type * device,handle_type ** device_handle) = 0;
+  virtual void close(handle_type * device_handle)                      = 0;
+
+  // kernel driver of an interface
+  virtual int kernel_driver_active(handle_type * device_handle,
+                                   int interface_id) = 0;
+  virtual int detach_kernel_driver(handle_type * device_handle,
+                                   int interface_id) = 0;
+  virtual int attach_kernel_driver(handle_type * device_handle,
+                                   int interface_id) = 0;
+
+  // ascii string descriptor, returns the number of characters or an error
+  virtual int string_descriptor(handle_type * device_handle,uint8_t index,
+                                unsigned char * buffer,int length) = 0;
+
+  // interfaces get no driver until they are attached (authorization), the
+  // permitted interfaces have to be attached
+  virtual bool blocks_by_default() const;
+};
+
+}
+
+#endif // GEMINI_DEVICE_BACKEND
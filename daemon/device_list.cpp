@@ -4,8 +4,9 @@
 namespace gemini
 {
 
+// not initialized until init succeeds
 device_list::device_list() :
-init_error_(0),
+init_error_(LIBUSB_ERROR_OTHER),
 device_index_(0),
 device_number_(0)
 {}
@@ -0,0 +1,200 @@
+// std
+#include <algorithm>
+
+// class
+#include <device_profiler.hpp>
+
+
+namespace gemini
+{
+
+device_profiler::device_profiler() :
+pass_(0)
+{}
+
+
+void device_profiler::identify(std::uint16_t address,
+                               descriptor const& device_desc)
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+
+  device_cost & device = cost(address);
+
+  // new device on the address, costs of the old device are meaningless
+  if(!(device.identity == device_desc))
+  {
+    if(!(device.identity == descriptor()))
+    {
+      device.total.fill(0);
+      device.failures.fill(0);
+
+      device.pass_cost = 0;
+      device.recent    = 0;
+    }
+
+    device.identity = device_desc;
+  }
+}
+
+
+void device_profiler::record(std::uint16_t address,cost_type type,
+                             std::uint64_t duration,bool failed)
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+
+  device_cost & device = cost(address);
+
+  device.total[type] += duration;
+  device.pass_cost   += duration;
+
+  if(failed) ++device.failures[type];
+}
+
+
+void device_profiler::finish_pass()
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+
+  for(auto cost_it = costs_.begin() ; cost_it != costs_.end() ;)
+  {
+    device_cost & device = cost_it->second;
+
+    if(pass_ - device.last_pass > FORGET_PASSES)
+    {
+      cost_it = costs_.erase(cost_it);
+
+      continue;
+    }
+
+
+    // exponential moving average, a pass weights 1/8
+    if(device.last_pass == pass_)
+    {
+      device.recent    = (7 * device.recent + device.pass_cost) / 8;
+      device.pass_cost = 0;
+    }
+
+    ++cost_it;
+  }
+
+  ++pass_;
+}
+
+
+std::vector<std::string> const device_profiler::top(std::size_t number) const
+{
+  std::vector<std::pair<std::uint64_t,std::string> > ranking;
+
+  std::vector<std::string> cost_strings;
+
+
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    for(auto cost_it = costs_.begin() ; cost_it != costs_.end() ; ++cost_it)
+    {
+      device_cost const& device = cost_it->second;
+
+      std::uint64_t total = 0;
+
+      std::string   type_info;
+
+
+      for(unsigned short type = COST_OPEN ; type != COST_UNDEFINED ; ++type)
+      {
+        total += device.total[type];
+
+        type_info += " " + std::to_string(device.total[type] / 1000)
+                   + " " + std::to_string(device.failures[type]);
+      }
+
+
+      ranking.push_back(std::make_pair(device.recent,
+
+                                       std::to_string(cost_it->first >> 8)
+                                       + " "
+                                       + std::to_string(cost_it->first & 0xff)
+                                       + " "
+                                       + std::to_string(device.identity[VENDOR_ID])
+                                       + " "
+                                       + std::to_string(device.identity[PRODUCT_ID])
+                                       + " "
+                                       + std::to_string(device.recent / 1000)
+                                       + " "
+                                       + std::to_string(total / 1000)
+                                       + type_info));
+    }
+  }
+
+
+  number = std::min(number,ranking.size());
+
+  std::partial_sort(ranking.begin(),ranking.begin() + number,ranking.end(),
+                    [](std::pair<std::uint64_t,std::string> const& c1,
+                       std::pair<std::uint64_t,std::string> const& c2)
+  {
+    return c1.first > c2.first;
+  });
+
+  for(std::size_t index = 0 ; index < number ; ++index)
+  {
+    cost_strings.push_back(ranking[index].second);
+  }
+
+
+  return cost_strings;
+}
+
+
+// costs of an address, created on first use (mutex is locked)
+device_profiler::device_cost & device_profiler::cost(std::uint16_t address)
+{
+  auto cost_it = costs_.find(address);
+
+  if(cost_it == costs_.end())
+  {
+    device_cost device;
+
+    device.total.fill(0);
+    device.failures.fill(0);
+
+    device.pass_cost = 0;
+    device.recent    = 0;
+
+    cost_it = costs_.insert(std::make_pair(address,device)).first;
+  }
+
+  cost_it->second.last_pass = pass_;
+
+
+  return cost_it->second;
+}
+
+
+
+device_profiler::scope::scope(device_profiler & profiler,std::uint16_t address,
+                              cost_type type) :
+profiler_(profiler),
+address_(address),
+type_(type),
+failed_(false),
+start_(std::chrono::steady_clock::now())
+{}
+
+device_profiler::scope::~scope()
+{
+  profiler_.record(address_,type_,
+
+                   std::chrono::duration_cast<std::chrono::nanoseconds>
+                   (std::chrono::steady_clock::now() - start_).count(),
+
+                   failed_);
+}
+
+
+void device_profiler::scope::fail()
+{
+  failed_ = true;
+}
+
+}
@@ -0,0 +1,104 @@
+#ifndef GEMINI_DEVICE_PROFILER
+#define GEMINI_DEVICE_PROFILER
+
+
+// std
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// gemini
+#include <descriptor.hpp>
+
+
+namespace gemini
+{
+
+enum cost_type{COST_OPEN,COST_DESCRIPTOR,COST_STRING,COST_DRIVER,
+               COST_UNDEFINED                                   };
+
+// wall time spent on usb operations of every device, devices are identified
+// by address (bus << 8 | port) and device descriptor
+class device_profiler
+{
+  public :
+
+  device_profiler();
+
+  // device seen by an enforcement pass, another device on the same address
+  // starts without costs
+  void identify(std::uint16_t address,descriptor const& device_desc);
+
+  // safe from bus workers, duration in nanoseconds
+  void record(std::uint16_t address,cost_type type,std::uint64_t duration,
+              bool failed);
+
+  // fold the costs of the pass into the recent costs, forget departed devices
+  void finish_pass();
+
+  // most expensive devices by recent cost per pass, one line each
+  // "<bus> <port> <vendor> <product> <recent> <total>" followed by
+  // "<total> <failures>" for every cost type, times in microseconds
+  std::vector<std::string> const top(std::size_t number) const;
+
+
+  // measures an operation from construction to destruction
+  class scope
+  {
+    public :
+
+    scope(device_profiler & profiler,std::uint16_t address,cost_type type);
+    ~scope();
+
+    scope(scope const&)              = delete;
+    scope & operator = (scope const&) = delete;
+
+    void fail();
+
+
+    private :
+
+    device_profiler &                     profiler_;
+    std::uint16_t                         address_;
+    cost_type                             type_;
+    bool                                  failed_;
+    std::chrono::steady_clock::time_point start_;
+  };
+
+
+  private :
+
+  struct device_cost
+  {
+    descriptor                                identity;
+
+    std::array<std::uint64_t,COST_UNDEFINED>  total,
+                                              failures;
+
+    // cost of the running pass and moving average over passes
+    std::uint64_t                             pass_cost,
+                                              recent;
+
+    unsigned long                             last_pass;
+  };
+
+  // passes a departed device stays listed
+  static const unsigned long FORGET_PASSES = 300;
+
+
+  device_cost & cost(std::uint16_t address);
+
+
+  std::map<std::uint16_t,device_cost> costs_;
+  unsigned long                       pass_;
+
+  mutable std::mutex                  mutex_;
+};
+
+}
+
+#endif // GEMINI_DEVICE_PROFILER
@@ -0,0 +1,37 @@
+# daemon core library, daemon, benchmarks, tools and tests
+
+TEMPLATE        = subdirs
+
+SUBDIRS        += core \
+                  daemon \
+                  bench \
+                  rules \
+                  journal \
+                  simulate \
+                  verify \
+                  test
+
+core.file       = gemini_core.pro
+core.makefile   = Makefile.core
+
+daemon.file     = gemini_daemon.pro
+daemon.makefile = Makefile.daemon
+daemon.depends  = core
+
+bench.subdir    = bench
+bench.depends   = core
+
+rules.subdir    = rules
+rules.depends   = core
+
+journal.subdir  = journal
+journal.depends = core
+
+simulate.subdir  = simulate
+simulate.depends = core
+
+verify.subdir    = verify
+verify.depends   = core
+
+test.subdir      = test
+test.depends     = core
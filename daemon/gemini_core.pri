@@ -0,0 +1,9 @@
+# link the daemon core library (gemini_core.pro)
+
+INCLUDEPATH    += $$PWD
+DEPENDPATH     += $$PWD
+
+LIBS           += -L$$shadowed($$PWD) -lgemini_core
+PRE_TARGETDEPS += $$shadowed($$PWD)/libgemini_core.a
+
+unix:!macx: LIBS += -lusb-1.0
@@ -0,0 +1,60 @@
+TARGET    = gemini_core
+
+TEMPLATE  = lib
+
+CONFIG   += staticlib
+CONFIG   += c++11
+
+QT       += core
+QT       += network
+QT       -= gui
+
+SOURCES  += descriptor.cpp \
+            device_list.cpp \
+            device_backend.cpp \
+            libusb_backend.cpp \
+            simulated_backend.cpp \
+            sysfs_backend.cpp \
+            recording_backend.cpp \
+            replay_backend.cpp \
+            usb_trace.cpp \
+            rule.cpp \
+            rule_index.cpp \
+            rule_optimizer.cpp \
+            rule_set.cpp \
+            timer_wheel.cpp \
+            state_file.cpp \
+            audit_journal.cpp \
+            presence_history.cpp \
+            latency_histogram.cpp \
+            metrics.cpp \
+            trace_buffer.cpp \
+            device_profiler.cpp \
+            storm_detector.cpp \
+            uevent_listener.cpp \
+            control.cpp
+
+HEADERS  += descriptor.hpp \
+            device_list.hpp \
+            device_backend.hpp \
+            libusb_backend.hpp \
+            simulated_backend.hpp \
+            sysfs_backend.hpp \
+            recording_backend.hpp \
+            replay_backend.hpp \
+            usb_trace.hpp \
+            rule.hpp \
+            rule_index.hpp \
+            rule_optimizer.hpp \
+            rule_set.hpp \
+            timer_wheel.hpp \
+            state_file.hpp \
+            audit_journal.hpp \
+            presence_history.hpp \
+            latency_histogram.hpp \
+            metrics.hpp \
+            trace_buffer.hpp \
+            device_profiler.hpp \
+            storm_detector.hpp \
+            uevent_listener.hpp \
+            control.hpp
@@ -11,18 +11,8 @@ QT       += network
 QT       -= gui
 
 SOURCES  += main.cpp \
-            server.cpp \
-            descriptor.cpp \
-            device_list.cpp \
-            rule.cpp \
-            rule_set.cpp \
-            control.cpp
+            server.cpp
 
-HEADERS  += server.hpp \
-            descriptor.hpp \
-            device_list.hpp \
-            rule.hpp \
-            rule_set.hpp \
-            control.hpp
+HEADERS  += server.hpp
 
-unix:!macx: LIBS += -lusb-1.0
+include(gemini_core.pri)
@@ -0,0 +1,164 @@
+// std
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <iostream>
+#include <iterator>
+
+// gemini
+#include <audit_journal.hpp>
+#include <rule_set.hpp>
+
+
+namespace
+{
+  // seconds since the epoch or local time "2026-10-19 02:00[:00]"
+  bool parse_time(std::string const& spec,std::uint64_t & time)
+  {
+    char * end;
+
+    unsigned long long seconds = std::strtoull(spec.c_str(),&end,10);
+
+    if(!spec.empty() && *end == '\0')
+    {
+      time = seconds * 1000000;
+
+      return true;
+    }
+
+
+    const char * formats[] = {"%Y-%m-%d %H:%M:%S","%Y-%m-%dT%H:%M:%S",
+                              "%Y-%m-%d %H:%M","%Y-%m-%d"};
+
+    for(auto format_it = std::begin(formats) ; format_it != std::end(formats) ;
+        ++format_it)
+    {
+      std::tm local;
+
+      std::memset(&local,0,sizeof(local));
+
+      const char * parsed = strptime(spec.c_str(),*format_it,&local);
+
+      if(parsed == nullptr || *parsed != '\0') continue;
+
+      local.tm_isdst = -1;
+
+      std::time_t local_time = std::mktime(&local);
+
+      if(local_time < 0) return false;
+
+      time = static_cast<std::uint64_t> (local_time) * 1000000;
+
+      return true;
+    }
+
+    return false;
+  }
+
+  // "<first>:<second>" in hexadecimal (vendor:product) or decimal (bus:port)
+  bool parse_pair(std::string const& spec,int base,std::uint32_t & first,
+                  std::uint32_t & second)
+  {
+    char * end;
+
+    first = std::strtoul(spec.c_str(),&end,base);
+
+    if(end == spec.c_str() || *end != ':') return false;
+
+    const char * second_spec = end + 1;
+
+    second = std::strtoul(second_spec,&end,base);
+
+    return end != second_spec && *end == '\0' && first != 0 && second != 0;
+  }
+}
+
+
+// print the blocks and unblocks of the audit journal, segments outside the
+// time range or without the device aren't read
+int main(int argc,char * argv[])
+{
+  std::string directory(gemini::rule_set::gemini_home_path() + "journal");
+
+  gemini::journal_query query = {0,~std::uint64_t(0),0,MASKED,MASKED,MASKED,
+                                 MASKED};
+
+  bool valid = true;
+
+  for(int arg = 1 ; arg < argc && valid ; ++arg)
+  {
+    std::string option(argv[arg]);
+
+    if(arg + 1 == argc)
+    {
+      valid = false;
+    }
+
+    else if(option == "--directory")
+    {
+      directory = argv[++arg];
+    }
+
+    else if(option == "--from")
+    {
+      valid = parse_time(argv[++arg],query.from);
+    }
+
+    else if(option == "--to")
+    {
+      valid = parse_time(argv[++arg],query.to);
+    }
+
+    else if(option == "--fingerprint")
+    {
+      char * end;
+
+      query.fingerprint = std::strtoull(argv[++arg],&end,16);
+
+      valid = *end == '\0' && query.fingerprint != 0;
+    }
+
+    else if(option == "--device")
+    {
+      valid = parse_pair(argv[++arg],16,query.vendor_id,query.product_id);
+    }
+
+    else if(option == "--port")
+    {
+      valid = parse_pair(argv[++arg],10,query.bus,query.port);
+    }
+
+    else valid = false;
+  }
+
+  if(!valid || query.from > query.to)
+  {
+    std::cerr << "usage: gemini_journal [--directory <dir>] [--from <time>]"
+              << " [--to <time>]" << std::endl
+              << "                      [--fingerprint <hex>]"
+              << " [--device <vendor>:<product>]" << std::endl
+              << "                      [--port <bus>:<port>]" << std::endl
+              << "times are seconds since the epoch or local times"
+              << " (\"2026-10-19 02:00\")" << std::endl;
+
+    return EXIT_FAILURE;
+  }
+
+
+  std::vector<gemini::journal_record> records;
+
+  if(!gemini::audit_journal::read(directory,query,records))
+  {
+    std::cerr << "can't read " << directory << std::endl;
+
+    return EXIT_FAILURE;
+  }
+
+  for(auto record_it = records.begin() ; record_it != records.end() ; ++record_it)
+  {
+    std::cout << record_it->info_line() << std::endl;
+  }
+
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,134 @@
+#include <latency_histogram.hpp>
+
+
+namespace gemini
+{
+
+latency_histogram::latency_histogram()
+{
+  reset();
+}
+
+
+void latency_histogram::record(std::uint64_t value)
+{
+  // values beyond the range are counted in the last bucket
+  const std::uint64_t max_value = (std::uint64_t(1) << VALUE_BITS) - 1;
+
+  if(value > max_value) value = max_value;
+
+
+  buckets_[bucket(value)].fetch_add(1,std::memory_order_relaxed);
+
+  count_.fetch_add(1,std::memory_order_relaxed);
+  sum_.fetch_add(value,std::memory_order_relaxed);
+
+
+  std::uint64_t current_max = max_.load(std::memory_order_relaxed);
+
+  while(value > current_max &&
+        !max_.compare_exchange_weak(current_max,value,
+                                    std::memory_order_relaxed))
+  {}
+}
+
+
+void latency_histogram::reset()
+{
+  for(auto bucket_it = buckets_.begin() ; bucket_it != buckets_.end() ; ++bucket_it)
+  {
+    bucket_it->store(0,std::memory_order_relaxed);
+  }
+
+  count_.store(0,std::memory_order_relaxed);
+  sum_.store(0,std::memory_order_relaxed);
+  max_.store(0,std::memory_order_relaxed);
+}
+
+
+std::uint64_t latency_histogram::count() const
+{
+  return count_.load(std::memory_order_relaxed);
+}
+
+std::uint64_t latency_histogram::max() const
+{
+  return max_.load(std::memory_order_relaxed);
+}
+
+std::uint64_t latency_histogram::mean() const
+{
+  std::uint64_t value_number = count();
+
+  return value_number > 0 ? sum_.load(std::memory_order_relaxed) / value_number
+                          : 0;
+}
+
+
+std::uint64_t latency_histogram::percentile(double quantile) const
+{
+  std::uint64_t value_number = count();
+
+  if(value_number == 0) return 0;
+
+
+  // rank of the quantile (at least the first value)
+  std::uint64_t rank       = static_cast<std::uint64_t> (quantile * value_number),
+                cumulative = 0;
+
+  if(rank == 0) rank = 1;
+
+
+  for(unsigned short index = 0 ; index < BUCKETS ; ++index)
+  {
+    cumulative += buckets_[index].load(std::memory_order_relaxed);
+
+    if(cumulative >= rank)
+    {
+      std::uint64_t value = bucket_max(index);
+
+      return value < max() ? value : max();
+    }
+  }
+
+  return max();
+}
+
+
+std::string const latency_histogram::info() const
+{
+  return std::to_string(count())            + " "
+       + std::to_string(percentile(0.5))    + " "
+       + std::to_string(percentile(0.99))   + " "
+       + std::to_string(max());
+}
+
+
+unsigned short latency_histogram::bucket(std::uint64_t value)
+{
+  // small values have their own bucket
+  if(value < SUB_BUCKETS) return value;
+
+
+  unsigned short msb = 63 - __builtin_clzll(value);
+
+  unsigned short group = msb - SUB_BUCKET_BITS + 1,
+                 sub   = (value >> (msb - SUB_BUCKET_BITS)) & (SUB_BUCKETS - 1);
+
+  return group * SUB_BUCKETS + sub;
+}
+
+std::uint64_t latency_histogram::bucket_max(unsigned short index)
+{
+  unsigned short group = index / SUB_BUCKETS,
+                 sub   = index % SUB_BUCKETS;
+
+  if(group == 0) return sub;
+
+
+  std::uint64_t lowest = std::uint64_t(SUB_BUCKETS + sub) << (group - 1);
+
+  return lowest + (std::uint64_t(1) << (group - 1)) - 1;
+}
+
+}
@@ -0,0 +1,63 @@
+#ifndef GEMINI_LATENCY_HISTOGRAM
+#define GEMINI_LATENCY_HISTOGRAM
+
+
+// std
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+
+namespace gemini
+{
+
+// lock free log linear histogram (hdr style, 16 sub buckets per power of two,
+// relative error below 6.25%), values in microseconds
+class latency_histogram
+{
+  public :
+
+  latency_histogram();
+
+  latency_histogram(latency_histogram const&)              = delete;
+  latency_histogram & operator = (latency_histogram const&) = delete;
+
+  // safe from any thread
+  void record(std::uint64_t value);
+
+  void reset();
+
+  std::uint64_t count() const;
+  std::uint64_t max() const;
+  std::uint64_t mean() const;
+
+  // highest value of the bucket holding the given quantile [0,1]
+  std::uint64_t percentile(double quantile) const;
+
+  // "<count> <p50> <p99> <max>"
+  std::string const info() const;
+
+
+  private :
+
+  static const unsigned short SUB_BUCKET_BITS = 4,
+                              SUB_BUCKETS     = 1 << SUB_BUCKET_BITS,
+                              VALUE_BITS      = 40,
+                              BUCKETS         = (VALUE_BITS - SUB_BUCKET_BITS
+                                                 + 1) * SUB_BUCKETS;
+
+  static unsigned short bucket(std::uint64_t value);
+  static std::uint64_t  bucket_max(unsigned short index);
+
+
+  std::array<std::atomic<std::uint64_t>,BUCKETS> buckets_;
+
+  std::atomic<std::uint64_t>                     count_,
+                                                 sum_,
+                                                 max_;
+};
+
+}
+
+#endif // GEMINI_LATENCY_HISTOGRAM
@@ -0,0 +1,134 @@
+#include <libusb_backend.hpp>
+
+
+namespace gemini
+{
+
+int libusb_backend::init()
+{
+  return device_list_.init();
+}
+
+int libusb_backend::init_error() const
+{
+  return device_list_.init_error();
+}
+
+
+ssize_t libusb_backend::enumerate(std::vector<device_type *> & devices)
+{
+  devices.clear();
+
+  // scan new device list
+  ssize_t device_number = device_list_.scan();
+
+  for(ssize_t device_id = 0 ; device_id < device_number ; ++device_id)
+  {
+    devices.push_back(reinterpret_cast<device_type *>
+
+                      (device_list_.get_device()));
+  }
+
+  return device_number;
+}
+
+
+uint8_t libusb_backend::bus_number(device_type * device)
+{
+  return libusb_get_bus_number(native(device));
+}
+
+uint8_t libusb_backend::port_number(device_type * device)
+{
+  return libusb_get_port_number(native(device));
+}
+
+int libusb_backend::port_numbers(device_type * device,uint8_t * ports,
+                                 int length)
+{
+  return libusb_get_port_numbers(native(device),ports,length);
+}
+
+uint8_t libusb_backend::device_address(device_type * device)
+{
+  return libusb_get_device_address(native(device));
+}
+
+
+int libusb_backend::device_descriptor(device_type * device,
+                                      libusb_device_descriptor & dev_desc)
+{
+  return libusb_get_device_descriptor(native(device),&dev_desc);
+}
+
+int libusb_backend::config_descriptor(device_type * device,
+                                      libusb_config_descriptor ** config_desc)
+{
+  return libusb_get_active_config_descriptor(native(device),config_desc);
+}
+
+void libusb_backend::free_config_descriptor(libusb_config_descriptor * config_desc)
+{
+  libusb_free_config_descriptor(config_desc);
+}
+
+
+int libusb_backend::open(device_type * device,handle_type ** device_handle)
+{
+  libusb_device_handle * native_handle;
+
+  int open_error = libusb_open(native(device),&native_handle);
+
+  if(open_error == LIBUSB_SUCCESS)
+  {
+    *device_handle = reinterpret_cast<handle_type *> (native_handle);
+  }
+
+  return open_error;
+}
+
+void libusb_backend::close(handle_type * device_handle)
+{
+  libusb_close(native(device_handle));
+}
+
+
+int libusb_backend::kernel_driver_active(handle_type * device_handle,
+                                         int interface_id)
+{
+  return libusb_kernel_driver_active(native(device_handle),interface_id);
+}
+
+int libusb_backend::detach_kernel_driver(handle_type * device_handle,
+                                         int interface_id)
+{
+  return libusb_detach_kernel_driver(native(device_handle),interface_id);
+}
+
+int libusb_backend::attach_kernel_driver(handle_type * device_handle,
+                                         int interface_id)
+{
+  return libusb_attach_kernel_driver(native(device_handle),interface_id);
+}
+
+
+int libusb_backend::string_descriptor(handle_type * device_handle,
+                                      uint8_t index,
+                                      unsigned char * buffer,int length)
+{
+  return libusb_get_string_descriptor_ascii(native(device_handle),index,
+                                            buffer,length);
+}
+
+
+libusb_device * libusb_backend::native(device_type * device)
+{
+  return reinterpret_cast<libusb_device *> (device);
+}
+
+libusb_device_handle * libusb_backend::native(handle_type * device_handle)
+{
+  return reinterpret_cast<libusb_device_handle *> (device_handle);
+}
+
+}
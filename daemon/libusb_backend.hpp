@@ -0,0 +1,56 @@
+#ifndef GEMINI_LIBUSB_BACKEND
+#define GEMINI_LIBUSB_BACKEND
+
+
+// gemini
+#include <device_backend.hpp>
+#include <device_list.hpp>
+
+
+namespace gemini
+{
+
+// backend of real usb devices
+class libusb_backend : public device_backend
+{
+  public :
+
+  int init();
+  int init_error() const;
+
+  ssize_t enumerate(std::vector<device_type *> & devices);
+
+  uint8_t bus_number(device_type * device);
+  uint8_t port_number(device_type * device);
+  int     port_numbers(device_type * device,uint8_t * ports,int length);
+  uint8_t device_address(device_type * device);
+
+  int  device_descriptor(device_type * device,
+                         libusb_device_descriptor & dev_desc);
+  int  config_descriptor(device_type * device,
+                         libusb_config_descriptor ** config_desc);
+  void free_config_descriptor(libusb_config_descriptor * config_desc);
+
+  int  open(device_type * device,handle_type ** device_handle);
+  void close(handle_type * device_handle);
+
+  int kernel_driver_active(handle_type * device_handle,int interface_id);
+  int detach_kernel_driver(handle_type * device_handle,int interface_id);
+  int attach_kernel_driver(handle_type * device_handle,int interface_id);
+
+  int string_descriptor(handle_type * device_handle,uint8_t index,
+                        unsigned char * buffer,int length);
+
+
+  private :
+
+  static libusb_device        * native(device_type * device);
+  static libusb_device_handle * native(handle_type * device_handle);
+
+
+  device_list device_list_;
+};
+
+}
+
+#endif // GEMINI_LIBUSB_BACKEND
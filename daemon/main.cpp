@@ -1,14 +1,159 @@
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <syslog.h>
 #include <unistd.h>
 
+#include <algorithm>
+#include <csignal>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+
 #include <QCoreApplication>
 
+#include <libusb_backend.hpp>
+#include <recording_backend.hpp>
+#include <replay_backend.hpp>
 #include <server.hpp>
+#include <sysfs_backend.hpp>
+#include <trace_buffer.hpp>
+
+
+// SIGUSR1 dumps the trace buffer (event loop writes it)
+void request_trace_dump(int)
+{
+  gemini::trace_buffer::instance().request_dump();
+}
+
+
+// feed a recorded trace through the enforcement path, report pass durations
+int replay(std::string const& trace_path,std::string const& rules_path,
+           bool real_time)
+{
+  std::unique_ptr<gemini::replay_backend> backend
+
+  (new gemini::replay_backend(trace_path,real_time));
+
+  if(!backend->valid())
+  {
+    std::cerr << "invalid trace " << trace_path << std::endl;
+
+    return EXIT_FAILURE;
+  }
+
+
+  gemini::replay_backend * trace = backend.get();
+
+  // replay mustn't touch the state and history of an installed daemon
+  gemini::control control(std::move(backend),"","","");
+
+  control.rule_set_.load(rules_path);
+
+
+  long long total_time = 0,
+            max_time   = 0;
+
+  std::size_t pass = 0;
+
+  while(!trace->finished())
+  {
+    trace->pace();
+
+    auto start = std::chrono::steady_clock::now();
+
+    control.enforce_rule_set(true);
+
+    long long pass_time = std::chrono::duration_cast<std::chrono::microseconds>
+                          (std::chrono::steady_clock::now() - start).count();
+
+    std::cout << "pass " << pass << " "
+              << control.interface_info().size() << " devices "
+              << pass_time << " us" << std::endl;
+
+    total_time += pass_time;
+    max_time    = std::max(max_time,pass_time);
+
+    ++pass;
+  }
+
+  std::cout << "passes " << pass
+            << " total "  << total_time << " us"
+            << " mean "   << (pass > 0 ? total_time / pass : 0) << " us"
+            << " max "    << max_time << " us" << std::endl;
+
+
+  return EXIT_SUCCESS;
+}
 
 
 int main(int argc , char * argv[])
 {
+  // start of enforcement latency measurement
+  auto start_time = std::chrono::steady_clock::now();
+
+  // command line options
+  std::string record_path,
+              replay_path,
+              sysfs_root,
+              rules_path(gemini::rule_set::gemini_home_path() + "default.rules");
+
+  bool        max_speed = false,
+              authorize = false,
+              reorder   = false;
+
+  // disk budget of the presence history (MiB)
+  unsigned long history_budget = gemini::presence_history::DEFAULT_BUDGET >> 20;
+
+  for(int arg = 1 ; arg < argc ; ++arg)
+  {
+    if(std::strcmp(argv[arg],"--record") == 0 && arg + 1 < argc)
+    {
+      record_path = argv[++arg];
+    }
+
+    else if(std::strcmp(argv[arg],"--replay") == 0 && arg + 1 < argc)
+    {
+      replay_path = argv[++arg];
+    }
+
+    else if(std::strcmp(argv[arg],"--rules") == 0 && arg + 1 < argc)
+    {
+      rules_path = argv[++arg];
+    }
+
+    else if(std::strcmp(argv[arg],"--sysfs") == 0 && arg + 1 < argc)
+    {
+      sysfs_root = argv[++arg];
+    }
+
+    else if(std::strcmp(argv[arg],"--authorize") == 0)
+    {
+      authorize = true;
+    }
+
+    else if(std::strcmp(argv[arg],"--history-budget") == 0 && arg + 1 < argc)
+    {
+      history_budget = std::strtoul(argv[++arg],nullptr,10);
+    }
+
+    else if(std::strcmp(argv[arg],"--reorder-rules") == 0)
+    {
+      reorder = true;
+    }
+
+    else if(std::strcmp(argv[arg],"--max-speed") == 0)
+    {
+      max_speed = true;
+    }
+  }
+
+  // replay runs in foreground
+  if(!replay_path.empty())
+  {
+    return replay(replay_path,rules_path,!max_speed);
+  }
+
+
   pid_t pid, sid;
 
  //Fork the Parent Process
@@ -38,7 +183,56 @@ int main(int argc , char * argv[])
 
   QCoreApplication app(argc,argv);
 
-  gemini::server server;
+  // create the trace buffer before the handler can use it
+  gemini::trace_buffer::instance();
+
+  std::signal(SIGUSR1,request_trace_dump);
+
+  std::unique_ptr<gemini::device_backend> backend;
+
+  // devices and drivers through sysfs, no device is opened
+  if(!sysfs_root.empty() || authorize)
+  {
+    backend.reset(new gemini::sysfs_backend(sysfs_root.empty() ? "/sys" :
+                                            sysfs_root,authorize));
+
+    // kernels without interface authorization fall back to detaching drivers
+    if(authorize && backend->init() != LIBUSB_SUCCESS)
+    {
+      syslog(LOG_WARNING,"usb authorization unavailable, detaching drivers");
+
+      backend.reset(sysfs_root.empty() ? nullptr :
+                    new gemini::sysfs_backend(sysfs_root));
+    }
+  }
+
+  // capture every observation of the real devices
+  if(!record_path.empty())
+  {
+    std::unique_ptr<gemini::device_backend> recorded(std::move(backend));
+
+    if(!recorded) recorded.reset(new gemini::libusb_backend());
+
+    backend.reset(new gemini::recording_backend(std::move(recorded),record_path));
+  }
+
+  gemini::server server(std::move(backend),
+                        static_cast<std::uint64_t> (history_budget) << 20);
+
+  server.reorder_rules(reorder);
+
+  // block devices plugged in during boot as early as possible
+  server.enforce();
+
+
+  auto enforcement_time = std::chrono::duration_cast<std::chrono::microseconds>
+                          (std::chrono::steady_clock::now() - start_time);
+
+  // standard streams are closed, report to the system log
+  openlog("gemini_daemon",LOG_PID,LOG_DAEMON);
+
+  syslog(LOG_INFO,"first enforcement %lld us after start",
+         static_cast<long long> (enforcement_time.count()));
 
 
   // server starts correct
@@ -0,0 +1,220 @@
+// std
+#include <sstream>
+
+// class
+#include <metrics.hpp>
+
+
+namespace gemini
+{
+
+counter::counter(std::string const& name,std::string const& help,double scale) :
+name_(name),
+help_(help),
+scale_(scale)
+{
+  for(auto shard_it = shards_.begin() ; shard_it != shards_.end() ; ++shard_it)
+  {
+    shard_it->value.store(0,std::memory_order_relaxed);
+  }
+}
+
+
+void counter::add(std::uint64_t value)
+{
+  shards_[thread_shard()].value.fetch_add(value,std::memory_order_relaxed);
+}
+
+
+std::uint64_t counter::value() const
+{
+  std::uint64_t sum = 0;
+
+  for(auto shard_it = shards_.begin() ; shard_it != shards_.end() ; ++shard_it)
+  {
+    sum += shard_it->value.load(std::memory_order_relaxed);
+  }
+
+  return sum;
+}
+
+
+std::string const counter::exposition() const
+{
+  std::ostringstream out;
+
+  out << "# HELP " << name_ << " " << help_ << "\n"
+      << "# TYPE " << name_ << " counter\n"
+      << name_ << " " << value() * scale_ << "\n";
+
+  return out.str();
+}
+
+
+// threads get their shards round robin
+unsigned short counter::thread_shard()
+{
+  static std::atomic<unsigned short> next_shard(0);
+
+  thread_local unsigned short shard_index =
+
+  next_shard.fetch_add(1,std::memory_order_relaxed) % SHARDS;
+
+  return shard_index;
+}
+
+
+
+gauge::gauge(std::string const& name,std::string const& help,double scale) :
+name_(name),
+help_(help),
+scale_(scale),
+value_(0)
+{}
+
+
+void gauge::set(std::int64_t value)
+{
+  value_.store(value,std::memory_order_relaxed);
+}
+
+void gauge::add(std::int64_t value)
+{
+  value_.fetch_add(value,std::memory_order_relaxed);
+}
+
+
+std::int64_t gauge::value() const
+{
+  return value_.load(std::memory_order_relaxed);
+}
+
+
+std::string const gauge::exposition() const
+{
+  std::ostringstream out;
+
+  out << "# HELP " << name_ << " " << help_ << "\n"
+      << "# TYPE " << name_ << " gauge\n"
+      << name_ << " " << value() * scale_ << "\n";
+
+  return out.str();
+}
+
+
+
+daemon_metrics::daemon_metrics() :
+passes("gemini_passes_total","Enforcement passes."),
+pass_duration("gemini_pass_duration_seconds_total",
+              "Time spent in enforcement passes.",1e-6),
+devices_scanned("gemini_devices_scanned_total",
+                "Devices enumerated by enforcement passes."),
+interfaces_enforced("gemini_interfaces_enforced_total",
+                    "Interface settings the rule set was enforced on."),
+last_pass_duration("gemini_last_pass_duration_seconds",
+                   "Duration of the latest enforcement pass.",1e-6),
+devices_present("gemini_devices_present",
+                "Devices enumerated by the latest enforcement pass."),
+devices_prioritized("gemini_devices_prioritized_total",
+                    "New and pending devices enforced ahead of the others."),
+devices_verified("gemini_devices_verified_total",
+                 "Enforced devices re-verified in the background."),
+decisions("gemini_rule_set_decisions_total",
+          "Interfaces evaluated by the rule set."),
+rules_evaluated("gemini_rules_evaluated_total",
+                "Rules evaluated by rule set decisions."),
+cache_hits("gemini_decision_cache_hits_total",
+           "Decisions answered by the decision cache."),
+cache_misses("gemini_decision_cache_misses_total",
+             "Decisions missing in the decision cache."),
+pinned_decisions("gemini_pinned_decisions_total",
+                 "Decisions of rules pinning a device fingerprint."),
+schedule_transitions("gemini_schedule_transitions_total",
+                     "Scheduled rules activated or deactivated."),
+handle_opens("gemini_handle_opens_total","Opened usb device handles."),
+handle_open_failures("gemini_handle_open_failures_total",
+                     "Usb device handles that couldn't be opened."),
+detach_successes("gemini_detach_successes_total",
+                 "Detached kernel drivers."),
+detach_failures("gemini_detach_failures_total",
+                "Kernel drivers that couldn't be detached."),
+attach_successes("gemini_attach_successes_total",
+                 "Reattached kernel drivers."),
+attach_failures("gemini_attach_failures_total",
+                "Kernel drivers that couldn't be reattached."),
+enforcement_failures("gemini_enforcement_failures_total",
+                     "Failed enforcement attempts on devices."),
+devices_pending("gemini_devices_pending",
+                "Devices waiting for another enforcement attempt."),
+devices_failed_to_block("gemini_devices_failed_to_block",
+                        "Devices given up after repeated failures."),
+journal_records("gemini_journal_records_total",
+                "Blocks and unblocks written to the audit journal."),
+journal_dropped("gemini_journal_dropped_total",
+                "Audit journal records dropped by a full queue."),
+uevents("gemini_uevents_total",
+        "Kernel uevents of usb interfaces (driver bound, added)."),
+uevent_enforcements("gemini_uevent_enforcements_total",
+                    "Prohibited interfaces enforced after a uevent."),
+storms("gemini_storms_total",
+       "Arrival storms detected on ports or device identities."),
+storm_arrivals("gemini_storm_arrivals_total",
+               "Device arrivals coalesced into a storm."),
+storming_ports("gemini_storming_ports","Ports in an arrival storm."),
+storming_identities("gemini_storming_identities",
+                    "Device identities in an arrival storm."),
+ipc_connections("gemini_ipc_connections_total",
+                "Client connections to the local servers."),
+ipc_bytes_sent("gemini_ipc_bytes_sent_total","Bytes sent to clients."),
+ipc_bytes_received("gemini_ipc_bytes_received_total",
+                   "Bytes received from clients.")
+{}
+
+
+std::string const daemon_metrics::exposition() const
+{
+  return passes.exposition()
+       + pass_duration.exposition()
+       + devices_scanned.exposition()
+       + interfaces_enforced.exposition()
+       + last_pass_duration.exposition()
+       + devices_present.exposition()
+       + devices_prioritized.exposition()
+       + devices_verified.exposition()
+       + decisions.exposition()
+       + rules_evaluated.exposition()
+       + cache_hits.exposition()
+       + cache_misses.exposition()
+       + pinned_decisions.exposition()
+       + schedule_transitions.exposition()
+       + handle_opens.exposition()
+       + handle_open_failures.exposition()
+       + detach_successes.exposition()
+       + detach_failures.exposition()
+       + attach_successes.exposition()
+       + attach_failures.exposition()
+       + enforcement_failures.exposition()
+       + devices_pending.exposition()
+       + devices_failed_to_block.exposition()
+       + journal_records.exposition()
+       + journal_dropped.exposition()
+       + uevents.exposition()
+       + uevent_enforcements.exposition()
+       + storms.exposition()
+       + storm_arrivals.exposition()
+       + storming_ports.exposition()
+       + storming_identities.exposition()
+       + ipc_connections.exposition()
+       + ipc_bytes_sent.exposition()
+       + ipc_bytes_received.exposition();
+}
+
+
+daemon_metrics & metrics()
+{
+  static daemon_metrics process_metrics;
+
+  return process_metrics;
+}
+
+}
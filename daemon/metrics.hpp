@@ -0,0 +1,156 @@
+#ifndef GEMINI_METRICS
+#define GEMINI_METRICS
+
+
+// std
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+
+namespace gemini
+{
+
+// monotonic counter, every thread adds to its own shard (relaxed), the
+// shards are summed on read
+class counter
+{
+  public :
+
+  // the exposed value is the counted value multiplied with scale
+  counter(std::string const& name,std::string const& help,double scale = 1.0);
+
+  counter(counter const&)              = delete;
+  counter & operator = (counter const&) = delete;
+
+  void add(std::uint64_t value = 1);
+
+  std::uint64_t value() const;
+
+  std::string const exposition() const;
+
+
+  static const unsigned short SHARDS = 16;
+
+  // shard of the calling thread, other per thread counters share it
+  static unsigned short thread_shard();
+
+
+  private :
+
+  // own cache line for every shard, threads don't share lines
+  struct alignas(64) shard
+  {
+    std::atomic<std::uint64_t> value;
+  };
+
+
+  std::string                name_,
+                             help_;
+  double                     scale_;
+
+  std::array<shard,SHARDS>   shards_;
+};
+
+
+// value that goes up and down (relaxed)
+class gauge
+{
+  public :
+
+  gauge(std::string const& name,std::string const& help,double scale = 1.0);
+
+  gauge(gauge const&)              = delete;
+  gauge & operator = (gauge const&) = delete;
+
+  void set(std::int64_t value);
+  void add(std::int64_t value);
+
+  std::int64_t value() const;
+
+  std::string const exposition() const;
+
+
+  private :
+
+  std::string               name_,
+                            help_;
+  double                    scale_;
+
+  std::atomic<std::int64_t> value_;
+};
+
+
+// internals of the daemon
+struct daemon_metrics
+{
+  daemon_metrics();
+
+  // prometheus text format of every metric
+  std::string const exposition() const;
+
+
+  // enforcement passes
+  counter passes,
+          pass_duration,
+          devices_scanned,
+          interfaces_enforced;
+
+  gauge   last_pass_duration,
+          devices_present;
+
+  // new and pending devices enforced first, devices re-verified in the
+  // background
+  counter devices_prioritized,
+          devices_verified;
+
+  // rule set
+  counter decisions,
+          rules_evaluated,
+          cache_hits,
+          cache_misses,
+          pinned_decisions,
+          schedule_transitions;
+
+  // usb
+  counter handle_opens,
+          handle_open_failures,
+          detach_successes,
+          detach_failures,
+          attach_successes,
+          attach_failures,
+          enforcement_failures;
+
+  // devices waiting for another attempt and devices given up
+  gauge   devices_pending,
+          devices_failed_to_block;
+
+  // audit journal records written and dropped (queue full)
+  counter journal_records,
+          journal_dropped;
+
+  // kernel uevents of usb interfaces, interfaces detached after them
+  counter uevents,
+          uevent_enforcements;
+
+  // arrival storms
+  counter storms,
+          storm_arrivals;
+
+  gauge   storming_ports,
+          storming_identities;
+
+  // ipc
+  counter ipc_connections,
+          ipc_bytes_sent,
+          ipc_bytes_received;
+};
+
+// metrics of this process
+daemon_metrics & metrics();
+
+}
+
+#endif // GEMINI_METRICS
@@ -0,0 +1,692 @@
+// posix
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// std
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+// class
+#include <presence_history.hpp>
+
+
+namespace gemini
+{
+
+namespace
+{
+  void put_varint(std::string & out,std::uint64_t value)
+  {
+    while(value >= 0x80)
+    {
+      out += static_cast<char> ((value & 0x7f) | 0x80);
+
+      value >>= 7;
+    }
+
+    out += static_cast<char> (value);
+  }
+
+  bool get_varint(std::string const& in,std::size_t & position,
+                  std::uint64_t & value)
+  {
+    value = 0;
+
+    for(unsigned short shift = 0 ; shift < 64 && position < in.size() ; shift += 7)
+    {
+      unsigned char byte = in[position++];
+
+      value |= std::uint64_t(byte & 0x7f) << shift;
+
+      if((byte & 0x80) == 0) return true;
+    }
+
+    return false;
+  }
+
+  bool read_all(int file_descriptor,char * buffer,std::size_t size,off_t offset)
+  {
+    while(size > 0)
+    {
+      ssize_t bytes = pread(file_descriptor,buffer,size,offset);
+
+      if(bytes <= 0) return false;
+
+      buffer += bytes;
+      size   -= bytes;
+      offset += bytes;
+    }
+
+    return true;
+  }
+
+  bool write_all(int file_descriptor,char const* buffer,std::size_t size)
+  {
+    while(size > 0)
+    {
+      ssize_t bytes = write(file_descriptor,buffer,size);
+
+      if(bytes < 0 && errno == EINTR) continue;
+
+      if(bytes <= 0) return false;
+
+      buffer += bytes;
+      size   -= bytes;
+    }
+
+    return true;
+  }
+
+  std::string const utc_time(std::time_t time)
+  {
+    std::tm utc;
+
+    gmtime_r(&time,&utc);
+
+    char stamp[32];
+
+    std::strftime(stamp,sizeof(stamp),"%Y-%m-%dT%H:%M:%SZ",&utc);
+
+    return stamp;
+  }
+}
+
+
+const std::uint64_t presence_history::DEFAULT_BUDGET  = 16 << 20;
+
+const std::size_t   presence_history::BLOCK_INTERVALS = 256;
+const std::size_t   presence_history::SEGMENT_NUMBER  = 8;
+const std::time_t   presence_history::SEAL_DELAY      = 3600;
+
+const std::uint32_t presence_history::MAGIC           = 0x47454d50; // "GEMP"
+
+
+presence_history::presence_history(std::string const& directory,
+                                   std::uint64_t budget) :
+directory_(directory),
+budget_(budget),
+file_descriptor_(-1),
+sequence_(0)
+{}
+
+presence_history::~presence_history()
+{
+  close();
+}
+
+
+bool presence_history::open()
+{
+  if(is_open()) return true;
+
+  if(directory_.empty()) return false;
+
+
+  if(mkdir(directory_.c_str(),S_IRWXU) != 0 && errno != EEXIST) return false;
+
+  DIR * history_directory = opendir(directory_.c_str());
+
+  if(!history_directory) return false;
+
+
+  std::vector<std::uint64_t> sequences;
+
+  for(dirent * entry = readdir(history_directory) ; entry ;
+      entry = readdir(history_directory))
+  {
+    if(std::strncmp(entry->d_name,"segment.",8) != 0) continue;
+
+    char * end;
+
+    std::uint64_t sequence = std::strtoull(entry->d_name + 8,&end,16);
+
+    if(*end == '\0' && sequence != 0) sequences.push_back(sequence);
+  }
+
+  closedir(history_directory);
+
+  std::sort(sequences.begin(),sequences.end());
+
+
+  segments_.clear();
+  index_.clear();
+
+  for(auto sequence_it = sequences.begin() ; sequence_it != sequences.end() ;
+      ++sequence_it)
+  {
+    segments_[*sequence_it] = load(*sequence_it);
+  }
+
+
+  // the latest segment is continued
+  sequence_ = sequences.empty() ? 1 : sequences.back();
+
+  file_descriptor_ = ::open(segment_path(directory_,sequence_).c_str(),
+                            O_WRONLY | O_APPEND | O_CREAT | O_CLOEXEC,
+                            S_IRUSR | S_IWUSR);
+
+  if(file_descriptor_ < 0) return false;
+
+  segments_.insert(std::make_pair(sequence_,0));
+
+  trim();
+
+
+  return true;
+}
+
+void presence_history::close()
+{
+  std::time_t now = std::time(nullptr);
+
+  // the history ends with the daemon
+  for(auto open_it = open_.begin() ; open_it != open_.end() ; ++open_it)
+  {
+    presence_interval interval = {open_it->second.start,now,
+                                  open_it->second.device,false};
+
+    pending_.push_back(interval);
+  }
+
+  open_.clear();
+
+  seal();
+
+
+  if(file_descriptor_ >= 0)
+  {
+    ::close(file_descriptor_);
+
+    file_descriptor_ = -1;
+  }
+}
+
+
+bool presence_history::is_open() const
+{
+  return file_descriptor_ >= 0;
+}
+
+
+void presence_history::budget(std::uint64_t bytes)
+{
+  budget_ = bytes;
+
+  trim();
+}
+
+
+void presence_history::seen(std::uint32_t key,presence_device const& device,
+                            std::time_t time)
+{
+  auto open_it = open_.find(key);
+
+  // re-enumerated devices get a new key, an instance is one device
+  if(open_it == open_.end() ||
+     open_it->second.device.fingerprint != device.fingerprint)
+  {
+    if(open_it != open_.end())
+    {
+      presence_interval interval = {open_it->second.start,time,
+                                    open_it->second.device,false};
+
+      pending_.push_back(interval);
+    }
+
+    open_interval connection = {device,time,time,true};
+
+    open_[key] = connection;
+
+    return;
+  }
+
+  open_it->second.last_seen = time;
+  open_it->second.seen      = true;
+}
+
+void presence_history::finish(std::time_t time)
+{
+  for(auto open_it = open_.begin() ; open_it != open_.end() ;)
+  {
+    if(!open_it->second.seen)
+    {
+      presence_interval interval = {open_it->second.start,time,
+                                    open_it->second.device,false};
+
+      pending_.push_back(interval);
+
+      open_it = open_.erase(open_it);
+
+      continue;
+    }
+
+    open_it->second.seen = false;
+
+    ++open_it;
+  }
+
+
+  // full blocks, rare disconnects wait at most SEAL_DELAY
+  if(pending_.size() >= BLOCK_INTERVALS ||
+     (!pending_.empty() && time - pending_.front().end >= SEAL_DELAY))
+  {
+    seal();
+  }
+}
+
+
+void presence_history::query(presence_query const& query,
+                             std::vector<presence_interval> & intervals) const
+{
+  std::size_t first = intervals.size();
+
+  int           file_descriptor = -1;
+  std::uint64_t sequence        = 0;
+
+  // blocks outside the time range aren't read
+  for(auto entry_it = index_.begin() ; entry_it != index_.end() ; ++entry_it)
+  {
+    if(entry_it->first_start > query.to || entry_it->last_end < query.from)
+    {
+      continue;
+    }
+
+    if(file_descriptor < 0 || entry_it->sequence != sequence)
+    {
+      if(file_descriptor >= 0) ::close(file_descriptor);
+
+      sequence        = entry_it->sequence;
+      file_descriptor = ::open(segment_path(directory_,sequence).c_str(),
+                               O_RDONLY | O_CLOEXEC);
+
+      if(file_descriptor < 0) continue;
+    }
+
+
+    block_header header;
+
+    if(!read_all(file_descriptor,reinterpret_cast<char *> (&header),
+                 sizeof(header),entry_it->offset)) continue;
+
+    std::string payload(header.payload_size,'\0');
+
+    std::vector<presence_interval> block;
+
+    if(!read_all(file_descriptor,&payload[0],payload.size(),
+                 entry_it->offset + sizeof(header)) ||
+       !decode(header,payload,block)) continue;
+
+
+    for(auto interval_it = block.begin() ; interval_it != block.end() ; ++interval_it)
+    {
+      if(selected(*interval_it,query)) intervals.push_back(*interval_it);
+    }
+  }
+
+  if(file_descriptor >= 0) ::close(file_descriptor);
+
+
+  for(auto interval_it = pending_.begin() ; interval_it != pending_.end() ;
+      ++interval_it)
+  {
+    if(selected(*interval_it,query)) intervals.push_back(*interval_it);
+  }
+
+  for(auto open_it = open_.begin() ; open_it != open_.end() ; ++open_it)
+  {
+    presence_interval interval = {open_it->second.start,open_it->second.last_seen,
+                                  open_it->second.device,true};
+
+    if(selected(interval,query)) intervals.push_back(interval);
+  }
+
+
+  std::stable_sort(intervals.begin() + first,intervals.end(),
+                   [](presence_interval const& a,presence_interval const& b)
+                   {
+                     return a.start < b.start;
+                   });
+}
+
+
+std::string const presence_history::csv(std::vector<presence_interval> const& intervals)
+{
+  std::string csv_text("start,end,duration,fingerprint,vendor_id,product_id,"
+                       "bus,port,connected\n");
+
+  for(auto interval_it = intervals.begin() ; interval_it != intervals.end() ;
+      ++interval_it)
+  {
+    char device_info[64];
+
+    std::snprintf(device_info,sizeof(device_info),"0x%016llx,%04x,%04x,%u,%u,%u",
+                  static_cast<unsigned long long> (interval_it->device.fingerprint),
+                  interval_it->device.vendor_id,interval_it->device.product_id,
+                  interval_it->device.bus,interval_it->device.port,
+                  interval_it->connected ? 1U : 0U);
+
+    csv_text += utc_time(interval_it->start) + ","
+              + utc_time(interval_it->end)   + ","
+              + std::to_string(interval_it->end - interval_it->start) + ","
+              + device_info + "\n";
+  }
+
+  return csv_text;
+}
+
+
+std::string const presence_history::segment_path(std::string const& directory,
+                                                 std::uint64_t sequence)
+{
+  char name[32];
+
+  std::snprintf(name,sizeof(name),"segment.%016llx",
+                static_cast<unsigned long long> (sequence));
+
+  return directory + "/" + name;
+}
+
+
+// header, device dictionary (fingerprint, vendor and product id) and the
+// columns of starts (delta), durations, devices, buses and ports
+std::string const presence_history::encode(std::vector<presence_interval> & intervals)
+{
+  std::sort(intervals.begin(),intervals.end(),
+            [](presence_interval const& a,presence_interval const& b)
+            {
+              return a.start < b.start;
+            });
+
+  std::map<std::uint64_t,std::uint64_t> devices;
+
+  std::string dictionary,
+              starts,
+              durations,
+              device_column,
+              buses,
+              ports;
+
+  block_header header = {MAGIC,static_cast<std::uint32_t> (intervals.size()),0,0,
+                         static_cast<std::uint64_t> (intervals.front().start),0};
+
+  std::time_t previous = intervals.front().start;
+
+
+  for(auto interval_it = intervals.begin() ; interval_it != intervals.end() ;
+      ++interval_it)
+  {
+    presence_device const& device = interval_it->device;
+
+    auto device_it = devices.find(device.fingerprint);
+
+    if(device_it == devices.end())
+    {
+      device_it = devices.insert(std::make_pair(device.fingerprint,
+                                                devices.size())).first;
+
+      for(unsigned short byte = 0 ; byte < 8 ; ++byte)
+      {
+        dictionary += static_cast<char> (device.fingerprint >> (8 * byte));
+      }
+
+      put_varint(dictionary,device.vendor_id);
+      put_varint(dictionary,device.product_id);
+    }
+
+
+    put_varint(starts,interval_it->start - previous);
+    put_varint(durations,std::max<std::time_t> (interval_it->end -
+                                                 interval_it->start,0));
+    put_varint(device_column,device_it->second);
+    put_varint(buses,device.bus);
+    put_varint(ports,device.port);
+
+    previous = interval_it->start;
+
+    header.last_end = std::max<std::uint64_t> (header.last_end,interval_it->end);
+  }
+
+
+  std::string payload(dictionary + starts + durations + device_column + buses
+                      + ports);
+
+  header.device_number = devices.size();
+  header.payload_size  = payload.size();
+
+  return std::string(reinterpret_cast<char const*> (&header),sizeof(header))
+       + payload;
+}
+
+bool presence_history::decode(block_header const& header,
+                              std::string const& payload,
+                              std::vector<presence_interval> & intervals)
+{
+  std::size_t position = 0;
+
+  // a device takes at least 9 bytes, an interval 5, counts of a corrupt
+  // header mustn't allocate more than the payload holds
+  if(std::uint64_t(header.device_number) * 9 > payload.size() ||
+     std::uint64_t(header.interval_number) * 5 > payload.size())
+  {
+    return false;
+  }
+
+  std::vector<presence_device> devices(header.device_number);
+
+  for(auto device_it = devices.begin() ; device_it != devices.end() ; ++device_it)
+  {
+    if(position + 8 > payload.size()) return false;
+
+    device_it->fingerprint = 0;
+
+    for(unsigned short byte = 0 ; byte < 8 ; ++byte)
+    {
+      device_it->fingerprint |= std::uint64_t(static_cast<unsigned char>
+                                              (payload[position++])) << (8 * byte);
+    }
+
+    std::uint64_t vendor_id,
+                  product_id;
+
+    if(!get_varint(payload,position,vendor_id) ||
+       !get_varint(payload,position,product_id)) return false;
+
+    device_it->vendor_id  = vendor_id;
+    device_it->product_id = product_id;
+  }
+
+
+  std::vector<std::uint64_t> columns[5];
+
+  for(unsigned short column = 0 ; column < 5 ; ++column)
+  {
+    columns[column].resize(header.interval_number);
+
+    for(auto value_it = columns[column].begin() ; value_it != columns[column].end() ;
+        ++value_it)
+    {
+      if(!get_varint(payload,position,*value_it)) return false;
+    }
+  }
+
+
+  std::time_t start = header.first_start;
+
+  for(std::size_t index = 0 ; index < header.interval_number ; ++index)
+  {
+    if(columns[2][index] >= devices.size()) return false;
+
+    start += columns[0][index];
+
+    presence_interval interval = {start,
+                                  start + static_cast<std::time_t> (columns[1][index]),
+                                  devices[columns[2][index]],false};
+
+    interval.device.bus  = columns[3][index];
+    interval.device.port = columns[4][index];
+
+    intervals.push_back(interval);
+  }
+
+
+  return true;
+}
+
+
+bool presence_history::selected(presence_interval const& interval,
+                                presence_query const& query)
+{
+  return interval.start <= query.to && interval.end >= query.from &&
+
+         (query.fingerprint == 0 ||
+          interval.device.fingerprint == query.fingerprint) &&
+         (query.vendor_id   == 0 ||
+          interval.device.vendor_id   == query.vendor_id) &&
+         (query.product_id  == 0 ||
+          interval.device.product_id  == query.product_id);
+}
+
+
+std::uint64_t presence_history::load(std::uint64_t sequence)
+{
+  std::string path(segment_path(directory_,sequence));
+
+  int file_descriptor = ::open(path.c_str(),O_RDONLY | O_CLOEXEC);
+
+  if(file_descriptor < 0) return 0;
+
+
+  struct stat file_status;
+
+  std::uint64_t size   = fstat(file_descriptor,&file_status) == 0 ?
+                         file_status.st_size : 0,
+                offset = 0;
+
+  block_header header;
+
+  while(offset + sizeof(header) <= size &&
+        read_all(file_descriptor,reinterpret_cast<char *> (&header),
+                 sizeof(header),offset) &&
+        header.magic == MAGIC &&
+        offset + sizeof(header) + header.payload_size <= size)
+  {
+    block_entry entry = {sequence,offset,
+                         static_cast<std::time_t> (header.first_start),
+                         static_cast<std::time_t> (header.last_end)};
+
+    index_.push_back(entry);
+
+    offset += sizeof(header) + header.payload_size;
+  }
+
+  ::close(file_descriptor);
+
+
+  // a block torn by a crash is cut off, appends continue after the last one
+  if(offset < size) truncate(path.c_str(),offset);
+
+  return offset;
+}
+
+
+void presence_history::seal()
+{
+  if(pending_.empty()) return;
+
+  if(!is_open())
+  {
+    pending_.clear();
+
+    return;
+  }
+
+
+  std::string block(encode(pending_));
+
+  pending_.clear();
+
+
+  // next segment once the segment has its share of the budget
+  const std::uint64_t segment_size = budget_ / SEGMENT_NUMBER;
+
+  if(segments_[sequence_] > 0 && segments_[sequence_] + block.size() > segment_size)
+  {
+    int next = ::open(segment_path(directory_,sequence_ + 1).c_str(),
+                      O_WRONLY | O_APPEND | O_CREAT | O_TRUNC | O_CLOEXEC,
+                      S_IRUSR | S_IWUSR);
+
+    if(next >= 0)
+    {
+      ::close(file_descriptor_);
+
+      file_descriptor_ = next;
+
+      segments_[++sequence_] = 0;
+    }
+  }
+
+
+  std::uint64_t offset = segments_[sequence_];
+
+  if(!write_all(file_descriptor_,block.data(),block.size()))
+  {
+    // no partial block stays behind, appends continue at the real end if it
+    // can't be cut off
+    if(ftruncate(file_descriptor_,offset) != 0)
+    {
+      segments_[sequence_] = lseek(file_descriptor_,0,SEEK_END);
+    }
+
+    return;
+  }
+
+  block_header const* header = reinterpret_cast<block_header const*> (block.data());
+
+  block_entry entry = {sequence_,offset,
+                       static_cast<std::time_t> (header->first_start),
+                       static_cast<std::time_t> (header->last_end)};
+
+  index_.push_back(entry);
+
+  segments_[sequence_] += block.size();
+
+  trim();
+}
+
+
+void presence_history::trim()
+{
+  std::uint64_t total = 0;
+
+  for(auto segment_it = segments_.begin() ; segment_it != segments_.end() ;
+      ++segment_it)
+  {
+    total += segment_it->second;
+  }
+
+  // the segment appended to stays
+  while(total > budget_ && segments_.begin()->first != sequence_)
+  {
+    std::uint64_t oldest = segments_.begin()->first;
+
+    unlink(segment_path(directory_,oldest).c_str());
+
+    total -= segments_.begin()->second;
+
+    segments_.erase(segments_.begin());
+
+    index_.erase(std::remove_if(index_.begin(),index_.end(),
+                                [oldest](block_entry const& entry)
+                                {
+                                  return entry.sequence == oldest;
+                                }),
+                 index_.end());
+  }
+}
+
+}
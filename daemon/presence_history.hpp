@@ -0,0 +1,169 @@
+#ifndef GEMINI_PRESENCE_HISTORY
+#define GEMINI_PRESENCE_HISTORY
+
+
+// std
+#include <cstdint>
+#include <ctime>
+#include <map>
+#include <string>
+#include <vector>
+
+
+namespace gemini
+{
+
+// identity of a device (descriptor::fingerprint) and the port it was on
+struct presence_device
+{
+  std::uint64_t fingerprint;
+  std::uint16_t vendor_id,
+                product_id;
+  std::uint8_t  bus,
+                port;
+};
+
+// connection of a device, end is the latest pass of still connected devices
+struct presence_interval
+{
+  std::time_t     start,
+                  end;
+  presence_device device;
+  bool            connected;
+};
+
+// intervals overlapping [from,to] of a device, unset (0) device fields match
+// every device
+struct presence_query
+{
+  std::time_t   from,
+                to;
+  std::uint64_t fingerprint;
+  std::uint16_t vendor_id,
+                product_id;
+};
+
+
+// connect and disconnect intervals of devices, closed intervals are sealed
+// into column blocks (varint, delta coded) appended to segment files of a
+// directory, an index of the block time ranges is kept in memory, the oldest
+// segments are removed when the segments exceed the disk budget
+class presence_history
+{
+  public :
+
+  presence_history(std::string const& directory,
+                   std::uint64_t budget = DEFAULT_BUDGET);
+  ~presence_history();
+
+  presence_history(presence_history const&)              = delete;
+  presence_history & operator = (presence_history const&) = delete;
+
+  // index the segments of the directory, torn blocks at a segment end are
+  // cut off, fails without directory
+  bool open();
+
+  // connected devices are disconnected at once, pending intervals are sealed
+  void close();
+
+  bool is_open() const;
+
+  // disk budget in bytes, old segments are removed at once
+  void budget(std::uint64_t bytes);
+
+  // device instance key (see control) seen in a pass at time
+  void seen(std::uint32_t key,presence_device const& device,std::time_t time);
+
+  // instances not seen since the latest finish are disconnected
+  void finish(std::time_t time);
+
+  // sealed, pending and open intervals matching the query, ordered by start
+  void query(presence_query const& query,
+             std::vector<presence_interval> & intervals) const;
+
+  // "start,end,duration,fingerprint,vendor_id,product_id,bus,port,connected"
+  // with UTC times (ISO 8601) and durations in seconds
+  static std::string const csv(std::vector<presence_interval> const& intervals);
+
+
+  static const std::uint64_t DEFAULT_BUDGET;
+
+  // intervals of a block, segments of the budget and the time an interval
+  // waits for its block
+  static const std::size_t   BLOCK_INTERVALS,
+                             SEGMENT_NUMBER;
+  static const std::time_t   SEAL_DELAY;
+
+
+  private :
+
+  static const std::uint32_t MAGIC;
+
+  struct block_header
+  {
+    std::uint32_t magic,
+                  interval_number,
+                  device_number,
+                  payload_size;
+    std::uint64_t first_start,
+                  last_end;
+  };
+
+  // sealed block of a segment
+  struct block_entry
+  {
+    std::uint64_t sequence,
+                  offset;
+    std::time_t   first_start,
+                  last_end;
+  };
+
+  struct open_interval
+  {
+    presence_device device;
+    std::time_t     start,
+                    last_seen;
+    bool            seen;
+  };
+
+
+  static std::string const segment_path(std::string const& directory,
+                                        std::uint64_t sequence);
+
+  // block of the intervals (sorted by start)
+  static std::string const encode(std::vector<presence_interval> & intervals);
+
+  static bool decode(block_header const& header,std::string const& payload,
+                     std::vector<presence_interval> & intervals);
+
+  static bool selected(presence_interval const& interval,
+                       presence_query const& query);
+
+  // index the blocks of a segment, returns its valid size
+  std::uint64_t load(std::uint64_t sequence);
+
+  // write the pending intervals as a block
+  void seal();
+
+  // remove the oldest segments above the budget
+  void trim();
+
+
+  std::string   directory_;
+  std::uint64_t budget_;
+
+  // segment appended to, its sequence and the size of every segment
+  int           file_descriptor_;
+  std::uint64_t sequence_;
+
+  std::map<std::uint64_t,std::uint64_t> segments_;
+  std::vector<block_entry>              index_;
+
+  // connected instances and closed intervals waiting for their block
+  std::map<std::uint32_t,open_interval> open_;
+  std::vector<presence_interval>        pending_;
+};
+
+}
+
+#endif // GEMINI_PRESENCE_HISTORY
@@ -0,0 +1,281 @@
+#include <recording_backend.hpp>
+
+
+namespace gemini
+{
+
+recording_backend::recording_backend(std::unique_ptr<device_backend> backend,
+                                     std::string const& trace_path) :
+backend_(std::move(backend)),
+start_(clock::now())
+{
+  trace_.create(trace_path);
+}
+
+
+int recording_backend::init()
+{
+  return backend_->init();
+}
+
+int recording_backend::init_error() const
+{
+  return backend_->init_error();
+}
+
+
+ssize_t recording_backend::enumerate(std::vector<device_type *> & devices)
+{
+  clock::time_point start = clock::now();
+
+  ssize_t device_number = backend_->enumerate(devices);
+
+
+  std::lock_guard<std::mutex> lock(mutex_);
+
+  // new enumeration, device indices restart
+  devices_.clear();
+
+  for(std::size_t index = 0 ; index < devices.size() ; ++index)
+  {
+    devices_[devices[index]] = index;
+  }
+
+
+  // previous pass is complete, keep it even if the daemon is killed
+  trace_.flush();
+
+
+  trace_record record;
+
+  record.type     = TRACE_ENUMERATE;
+  record.time     = timestamp(start);
+  record.duration = timestamp(clock::now()) - record.time;
+  record.result   = device_number;
+
+  trace_.write(record);
+
+
+  return device_number;
+}
+
+
+uint8_t recording_backend::bus_number(device_type * device)
+{
+  return backend_->bus_number(device);
+}
+
+uint8_t recording_backend::port_number(device_type * device)
+{
+  return backend_->port_number(device);
+}
+
+int recording_backend::port_numbers(device_type * device,uint8_t * ports,
+                                    int length)
+{
+  return backend_->port_numbers(device,ports,length);
+}
+
+uint8_t recording_backend::device_address(device_type * device)
+{
+  return backend_->device_address(device);
+}
+
+
+int recording_backend::device_descriptor(device_type * device,
+                                         libusb_device_descriptor & dev_desc)
+{
+  clock::time_point start = clock::now();
+
+  int error = backend_->device_descriptor(device,dev_desc);
+
+  std::string payload;
+
+  if(error == LIBUSB_SUCCESS)
+  {
+    payload = usb_trace::encode(backend_->bus_number(device),
+                                backend_->port_number(device),dev_desc);
+  }
+
+  record(TRACE_DEVICE,device_index(device),start,error,0,payload);
+
+
+  return error;
+}
+
+int recording_backend::config_descriptor(device_type * device,
+                                         libusb_config_descriptor ** config_desc)
+{
+  clock::time_point start = clock::now();
+
+  int error = backend_->config_descriptor(device,config_desc);
+
+  std::string payload;
+
+  if(error == LIBUSB_SUCCESS) payload = usb_trace::encode(**config_desc);
+
+  record(TRACE_CONFIG,device_index(device),start,error,0,payload);
+
+
+  return error;
+}
+
+void recording_backend::free_config_descriptor(libusb_config_descriptor * config_desc)
+{
+  backend_->free_config_descriptor(config_desc);
+}
+
+
+int recording_backend::open(device_type * device,handle_type ** device_handle)
+{
+  clock::time_point start = clock::now();
+
+  int error = backend_->open(device,device_handle);
+
+  std::uint32_t index = device_index(device);
+
+  if(error == LIBUSB_SUCCESS)
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    handles_[*device_handle] = index;
+  }
+
+  record(TRACE_OPEN,index,start,error);
+
+
+  return error;
+}
+
+void recording_backend::close(handle_type * device_handle)
+{
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    handles_.erase(device_handle);
+  }
+
+  backend_->close(device_handle);
+}
+
+
+int recording_backend::kernel_driver_active(handle_type * device_handle,
+                                            int interface_id)
+{
+  clock::time_point start = clock::now();
+
+  int result = backend_->kernel_driver_active(device_handle,interface_id);
+
+  record(TRACE_DRIVER_ACTIVE,handle_index(device_handle),start,result,
+         interface_id);
+
+  return result;
+}
+
+int recording_backend::detach_kernel_driver(handle_type * device_handle,
+                                            int interface_id)
+{
+  clock::time_point start = clock::now();
+
+  int error = backend_->detach_kernel_driver(device_handle,interface_id);
+
+  record(TRACE_DETACH,handle_index(device_handle),start,error,interface_id);
+
+  return error;
+}
+
+int recording_backend::attach_kernel_driver(handle_type * device_handle,
+                                            int interface_id)
+{
+  clock::time_point start = clock::now();
+
+  int error = backend_->attach_kernel_driver(device_handle,interface_id);
+
+  record(TRACE_ATTACH,handle_index(device_handle),start,error,interface_id);
+
+  return error;
+}
+
+
+int recording_backend::string_descriptor(handle_type * device_handle,
+                                         uint8_t index,
+                                         unsigned char * buffer,int length)
+{
+  clock::time_point start = clock::now();
+
+  int char_number = backend_->string_descriptor(device_handle,index,
+                                                buffer,length);
+
+  std::string payload;
+
+  if(char_number > 0)
+  {
+    payload.assign(reinterpret_cast<char *> (buffer),char_number);
+  }
+
+  record(TRACE_STRING,handle_index(device_handle),start,char_number,index,
+         payload);
+
+
+  return char_number;
+}
+
+bool recording_backend::blocks_by_default() const
+{
+  return backend_->blocks_by_default();
+}
+
+
+std::uint64_t recording_backend::timestamp(clock::time_point const& time) const
+{
+  return std::chrono::duration_cast<std::chrono::microseconds>
+
+         (time - start_).count();
+}
+
+
+void recording_backend::record(trace_type type,std::uint32_t device,
+                               clock::time_point const& start,
+                               int result,int argument,
+                               std::string const& payload)
+{
+  trace_record record;
+
+  record.type     = type;
+  record.device   = device;
+  record.time     = timestamp(start);
+  record.duration = timestamp(clock::now()) - record.time;
+  record.result   = result;
+  record.argument = argument;
+  record.payload  = payload;
+
+
+  std::lock_guard<std::mutex> lock(mutex_);
+
+  trace_.write(record);
+}
+
+
+std::uint32_t recording_backend::device_index(device_type * device)
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+
+  auto device_it = devices_.find(device);
+
+  if(device_it == devices_.end()) return devices_.size();
+
+  return device_it->second;
+}
+
+std::uint32_t recording_backend::handle_index(handle_type * device_handle)
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+
+  auto handle_it = handles_.find(device_handle);
+
+  if(handle_it == handles_.end()) return devices_.size();
+
+  return handle_it->second;
+}
+
+}
@@ -0,0 +1,88 @@
+#ifndef GEMINI_RECORDING_BACKEND
+#define GEMINI_RECORDING_BACKEND
+
+
+// std
+#include <chrono>
+#include <map>
+#include <memory>
+#include <mutex>
+
+// gemini
+#include <device_backend.hpp>
+#include <usb_trace.hpp>
+
+
+namespace gemini
+{
+
+// forwards every operation to another backend and records results, descriptors
+// and timings in a trace file
+class recording_backend : public device_backend
+{
+  public :
+
+  recording_backend(std::unique_ptr<device_backend> backend,
+                    std::string const& trace_path);
+
+  int init();
+  int init_error() const;
+
+  ssize_t enumerate(std::vector<device_type *> & devices);
+
+  uint8_t bus_number(device_type * device);
+  uint8_t port_number(device_type * device);
+  int     port_numbers(device_type * device,uint8_t * ports,int length);
+  uint8_t device_address(device_type * device);
+
+  int  device_descriptor(device_type * device,
+                         libusb_device_descriptor & dev_desc);
+  int  config_descriptor(device_type * device,
+                         libusb_config_descriptor ** config_desc);
+  void free_config_descriptor(libusb_config_descriptor * config_desc);
+
+  int  open(device_type * device,handle_type ** device_handle);
+  void close(handle_type * device_handle);
+
+  int kernel_driver_active(handle_type * device_handle,int interface_id);
+  int detach_kernel_driver(handle_type * device_handle,int interface_id);
+  int attach_kernel_driver(handle_type * device_handle,int interface_id);
+
+  int string_descriptor(handle_type * device_handle,uint8_t index,
+                        unsigned char * buffer,int length);
+
+  bool blocks_by_default() const;
+
+
+  private :
+
+  typedef std::chrono::steady_clock clock;
+
+  // microseconds since the start of the recording
+  std::uint64_t timestamp(clock::time_point const& time) const;
+
+  void record(trace_type type,std::uint32_t device,
+              clock::time_point const& start,
+              int result,int argument = 0,
+              std::string const& payload = std::string());
+
+  std::uint32_t device_index(device_type * device);
+  std::uint32_t handle_index(handle_type * device_handle);
+
+
+  std::unique_ptr<device_backend>       backend_;
+
+  usb_trace                             trace_;
+  clock::time_point                     start_;
+
+  // index of devices and open handles in the latest enumeration
+  std::map<device_type *,std::uint32_t> devices_;
+  std::map<handle_type *,std::uint32_t> handles_;
+
+  // guards trace and index maps (parallel enforcement)
+  std::mutex                            mutex_;
+};
+
+}
+
+#endif // GEMINI_RECORDING_BACKEND
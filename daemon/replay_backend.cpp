@@ -0,0 +1,372 @@
+// std
+#include <functional>
+#include <thread>
+
+// class
+#include <replay_backend.hpp>
+
+
+namespace gemini
+{
+
+namespace
+{
+  // replayed devices come from the trace only
+  simulation_config const empty_population()
+  {
+    simulation_config config;
+
+    config.device_number = 0;
+
+    return config;
+  }
+}
+
+
+replay_backend::replay_backend(std::string const& trace_path,bool real_time) :
+simulated_backend(empty_population()),
+valid_(false),
+real_time_(real_time),
+pass_(0)
+{
+  load(trace_path);
+}
+
+
+bool replay_backend::valid() const
+{
+  return valid_;
+}
+
+bool replay_backend::finished() const
+{
+  return pass_ >= passes_.size();
+}
+
+std::size_t replay_backend::pass_number() const
+{
+  return passes_.size();
+}
+
+
+void replay_backend::pace()
+{
+  if(!real_time_ || finished()) return;
+
+
+  if(pass_ == 0) replay_start_ = std::chrono::steady_clock::now();
+
+  std::this_thread::sleep_until(replay_start_ + std::chrono::microseconds
+
+                                (passes_[pass_].time - passes_.front().time));
+}
+
+
+ssize_t replay_backend::enumerate(std::vector<device_type *> & devices)
+{
+  devices.clear();
+  devices_.clear();
+  indices_.clear();
+
+  if(finished()) return 0;
+
+
+  recorded_pass & pass = passes_[pass_];
+
+  if(real_time_) delay(pass.duration);
+
+
+  // devices of a pass are replayed once, move them into the population
+  for(auto device_it = pass.devices.begin() ; device_it != pass.devices.end() ; ++device_it)
+  {
+    (*device_it)->wire();
+
+    indices_[device_it->get()] = devices_.size();
+
+    devices_.push_back(std::move(*device_it));
+  }
+
+  pass.devices.clear();
+
+  ++pass_;
+
+
+  return simulated_backend::enumerate(devices);
+}
+
+
+int replay_backend::device_descriptor(device_type * device,
+                                      libusb_device_descriptor & dev_desc)
+{
+  recorded_call call;
+
+  if(replay(index(native(device)),TRACE_DEVICE,0,call) &&
+     call.result != LIBUSB_SUCCESS)
+  {
+    return call.result;
+  }
+
+  return simulated_backend::device_descriptor(device,dev_desc);
+}
+
+int replay_backend::config_descriptor(device_type * device,
+                                      libusb_config_descriptor ** config_desc)
+{
+  recorded_call call;
+
+  if(replay(index(native(device)),TRACE_CONFIG,0,call) &&
+     call.result != LIBUSB_SUCCESS)
+  {
+    return call.result;
+  }
+
+  return simulated_backend::config_descriptor(device,config_desc);
+}
+
+
+int replay_backend::open(device_type * device,handle_type ** device_handle)
+{
+  recorded_call call;
+
+  if(replay(index(native(device)),TRACE_OPEN,0,call) &&
+     call.result != LIBUSB_SUCCESS)
+  {
+    return call.result;
+  }
+
+  return simulated_backend::open(device,device_handle);
+}
+
+
+int replay_backend::kernel_driver_active(handle_type * device_handle,
+                                         int interface_id)
+{
+  recorded_call call;
+
+  int result = simulated_backend::kernel_driver_active(device_handle,
+                                                       interface_id);
+
+  if(replay(index(native(device_handle)),TRACE_DRIVER_ACTIVE,interface_id,
+            call))
+  {
+    result = call.result;
+  }
+
+  return result;
+}
+
+int replay_backend::detach_kernel_driver(handle_type * device_handle,
+                                         int interface_id)
+{
+  recorded_call call;
+
+  if(replay(index(native(device_handle)),TRACE_DETACH,interface_id,call) &&
+     call.result != LIBUSB_SUCCESS)
+  {
+    return call.result;
+  }
+
+  return simulated_backend::detach_kernel_driver(device_handle,interface_id);
+}
+
+int replay_backend::attach_kernel_driver(handle_type * device_handle,
+                                         int interface_id)
+{
+  recorded_call call;
+
+  if(replay(index(native(device_handle)),TRACE_ATTACH,interface_id,call) &&
+     call.result != LIBUSB_SUCCESS)
+  {
+    return call.result;
+  }
+
+  return simulated_backend::attach_kernel_driver(device_handle,interface_id);
+}
+
+
+int replay_backend::string_descriptor(handle_type * device_handle,
+                                      uint8_t index,
+                                      unsigned char * buffer,int length)
+{
+  recorded_call call;
+
+  if(replay(this->index(native(device_handle)),TRACE_STRING,index,call) &&
+     call.result <= 0)
+  {
+    return call.result;
+  }
+
+  return simulated_backend::string_descriptor(device_handle,index,
+                                              buffer,length);
+}
+
+
+void replay_backend::load(std::string const& trace_path)
+{
+  usb_trace trace;
+
+  valid_ = trace.open(trace_path);
+
+  if(!valid_) return;
+
+
+  trace_record record;
+
+  // first recorded driver state of the interfaces in the current pass
+  std::map<std::pair<std::uint32_t,std::int32_t>,bool> driver_states;
+
+  std::function<void()> apply_driver_states([this,&driver_states]()
+  {
+    if(passes_.empty()) return;
+
+    recorded_pass & pass = passes_.back();
+
+    for(auto state_it = driver_states.begin() ; state_it != driver_states.end() ; ++state_it)
+    {
+      simulated_device & device = *(pass.devices[state_it->first.first]);
+
+      device.driver_active.resize(device.settings.size(),true);
+
+      if(state_it->first.second < static_cast<int> (device.driver_active.size()))
+      {
+        device.driver_active[state_it->first.second] = state_it->second;
+      }
+    }
+
+    driver_states.clear();
+  });
+
+
+  while(trace.read(record))
+  {
+    // enumeration starts the next pass
+    if(record.type == TRACE_ENUMERATE)
+    {
+      apply_driver_states();
+
+      passes_.push_back(recorded_pass());
+
+      passes_.back().time     = record.time;
+      passes_.back().duration = record.duration;
+
+      for(std::int32_t device = 0 ; device < record.result ; ++device)
+      {
+        passes_.back().devices.push_back
+
+        (std::unique_ptr<simulated_device>(new simulated_device));
+      }
+
+      continue;
+    }
+
+    // operation before the first enumeration or on unknown device
+    if(passes_.empty() || record.device >= passes_.back().devices.size())
+    {
+      continue;
+    }
+
+
+    recorded_pass & pass = passes_.back();
+
+    simulated_device & device = *(pass.devices[record.device]);
+
+    switch(record.type)
+    {
+      case TRACE_DEVICE :
+
+      if(record.result == LIBUSB_SUCCESS)
+      {
+        usb_trace::decode_device(record.payload,device);
+      }
+
+      break;
+
+
+      case TRACE_CONFIG :
+
+      if(record.result == LIBUSB_SUCCESS)
+      {
+        usb_trace::decode_config(record.payload,device);
+      }
+
+      break;
+
+
+      case TRACE_STRING :
+
+      if(record.result > 0 && record.argument > 0)
+      {
+        if(device.strings.size() <= static_cast<std::size_t> (record.argument))
+        {
+          device.strings.resize(record.argument + 1);
+        }
+
+        device.strings[record.argument] = record.payload;
+      }
+
+      break;
+
+
+      case TRACE_DRIVER_ACTIVE :
+
+      if(record.result >= 0)
+      {
+        // keep the first state only, later ones are results of detach/attach
+        driver_states.insert(std::make_pair(std::make_pair(record.device,
+                                                           record.argument),
+                                            record.result == 1));
+      }
+
+      break;
+    }
+
+
+    recorded_call call;
+
+    call.result   = record.result;
+    call.duration = record.duration;
+
+    pass.calls[call_key(record.device,record.type,record.argument)].push_back(call);
+  }
+
+  apply_driver_states();
+}
+
+
+bool replay_backend::replay(std::uint32_t device,trace_type type,
+                            std::int32_t argument,recorded_call & call)
+{
+  // calls of the current pass (already advanced by enumerate)
+  if(pass_ == 0 || pass_ > passes_.size()) return false;
+
+  {
+    std::lock_guard<std::mutex> lock(replay_mutex_);
+
+    recorded_pass & pass = passes_[pass_ - 1];
+
+    auto call_it = pass.calls.find(call_key(device,type,argument));
+
+    if(call_it == pass.calls.end() || call_it->second.empty()) return false;
+
+    call = call_it->second.front();
+
+    call_it->second.pop_front();
+  }
+
+  if(real_time_) delay(call.duration);
+
+
+  return true;
+}
+
+
+std::uint32_t replay_backend::index(simulated_device const* device) const
+{
+  auto index_it = indices_.find(device);
+
+  if(index_it == indices_.end()) return indices_.size();
+
+  return index_it->second;
+}
+
+}
@@ -0,0 +1,103 @@
+#ifndef GEMINI_REPLAY_BACKEND
+#define GEMINI_REPLAY_BACKEND
+
+
+// std
+#include <chrono>
+#include <deque>
+#include <map>
+#include <tuple>
+
+// gemini
+#include <simulated_backend.hpp>
+#include <usb_trace.hpp>
+
+
+namespace gemini
+{
+
+// plays a recorded trace back, every enumeration starts the next recorded pass
+// with the recorded devices, results and (in real time) latencies
+class replay_backend : public simulated_backend
+{
+  public :
+
+  replay_backend(std::string const& trace_path,bool real_time = true);
+
+  // trace could be read
+  bool valid() const;
+  // every recorded pass was replayed
+  bool finished() const;
+
+  std::size_t pass_number() const;
+
+  // wait until the next pass starts relative to the first (real time only)
+  void pace();
+
+  ssize_t enumerate(std::vector<device_type *> & devices);
+
+  int  device_descriptor(device_type * device,
+                         libusb_device_descriptor & dev_desc);
+  int  config_descriptor(device_type * device,
+                         libusb_config_descriptor ** config_desc);
+
+  int  open(device_type * device,handle_type ** device_handle);
+
+  int kernel_driver_active(handle_type * device_handle,int interface_id);
+  int detach_kernel_driver(handle_type * device_handle,int interface_id);
+  int attach_kernel_driver(handle_type * device_handle,int interface_id);
+
+  int string_descriptor(handle_type * device_handle,uint8_t index,
+                        unsigned char * buffer,int length);
+
+
+  private :
+
+  // device index, operation and argument
+  typedef std::tuple<std::uint32_t,std::uint8_t,std::int32_t> call_key;
+
+  struct recorded_call
+  {
+    std::int32_t  result;
+    std::uint32_t duration;
+  };
+
+  struct recorded_pass
+  {
+    std::uint64_t                                  time;
+    std::uint32_t                                  duration;
+
+    std::vector<std::unique_ptr<simulated_device> > devices;
+
+    // recorded calls in call order
+    std::map<call_key,std::deque<recorded_call> >  calls;
+  };
+
+
+  void load(std::string const& trace_path);
+
+  // take the next recorded result of a call, false if the recording has none
+  bool replay(std::uint32_t device,trace_type type,std::int32_t argument,
+              recorded_call & call);
+
+  std::uint32_t index(simulated_device const* device) const;
+
+
+  bool                                         valid_,
+                                               real_time_;
+
+  std::vector<recorded_pass>                   passes_;
+  std::size_t                                  pass_;
+
+  // index of the devices in the current pass
+  std::map<simulated_device const*,std::uint32_t> indices_;
+
+  std::chrono::steady_clock::time_point        replay_start_;
+
+  // guards recorded calls (parallel enforcement)
+  std::mutex                                   replay_mutex_;
+};
+
+}
+
+#endif // GEMINI_REPLAY_BACKEND
@@ -1,41 +1,249 @@
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <iterator>
+#include <limits>
 #include <sstream>
 
 #include <rule.hpp>
 
 namespace gemini
 {
+
+namespace
+{
+  const unsigned short PERMISSION  = UNDEFINED,
+                       FINGERPRINT = UNDEFINED + 1,
+                       SCHEDULE    = UNDEFINED + 2;
+
+  const descriptor::value_type MINUTES_PER_DAY = 24 * 60;
+
+  // value specifications of a rule string, info format ends every field
+  // with ']' (labels end with ':'), other strings are separated by spaces
+  std::vector<std::string> split(std::string const& input)
+  {
+    std::vector<std::string> tokens;
+
+    std::istringstream ss(input);
+
+    std::string token;
+
+    if(input.find(']') != std::string::npos)
+    {
+      while(getline(ss,token,']'))
+      {
+        std::size_t begin = token.find_last_of("[:");
+
+        if(begin != std::string::npos) token.erase(0,begin + 1);
+
+        token.erase(std::remove_if(token.begin(),token.end(),::isspace),
+                    token.end());
+
+        if(!token.empty()) tokens.push_back(token);
+      }
+    }
+
+    else
+    {
+      while(ss >> token) tokens.push_back(token);
+    }
+
+    return tokens;
+  }
+
+  // field of a keyword, UNDEFINED if the token isn't one
+  unsigned short keyword(std::string const& token)
+  {
+    if(token == "PERMISSION")  return PERMISSION;
+    if(token == "FINGERPRINT") return FINGERPRINT;
+    if(token == "SCHEDULE")    return SCHEDULE;
+
+    for(unsigned short index = BUS ; index != UNDEFINED ; ++index)
+    {
+      if(token == DESCRIPTOR_FIELDS[index].name) return index;
+    }
+
+    return SCHEDULE + 1;
+  }
+
+  // minute of the day as "hh:mm", the end of the day is "24:00"
+  std::string const time_info(descriptor::value_type minute)
+  {
+    char time[6];
+
+    std::snprintf(time,sizeof(time),"%02u:%02u",
+                  static_cast<unsigned int> (minute / 60),
+                  static_cast<unsigned int> (minute % 60));
+
+    return time;
+  }
+
+  // "hh:mm" as minute of the day, "24:00" ends a window at midnight
+  bool parse_time(std::string const& spec,descriptor::value_type & minute)
+  {
+    if(spec.size() != 5 || spec[2] != ':' ||
+       !std::isdigit(spec[0]) || !std::isdigit(spec[1]) ||
+       !std::isdigit(spec[3]) || !std::isdigit(spec[4]))
+    {
+      return false;
+    }
+
+    descriptor::value_type hours   = (spec[0] - '0') * 10 + spec[1] - '0',
+                           minutes = (spec[3] - '0') * 10 + spec[4] - '0';
+
+    minute = hours * 60 + minutes;
+
+    return minutes < 60 && minute <= MINUTES_PER_DAY;
+  }
+}
+
+
   rule::rule(descriptor const& desc,bool permission) :
   descriptor_(desc),
-  permission_(permission)
+  fingerprint_(0),
+  ranged_(false),
+  permission_(permission),
+  valid_(true)
   {}
 
-  rule::rule(std::string const& input)
+  rule::rule(std::array<value_set,DESCRIPTOR_SIZE> const& values,
+             bool permission,value_set const& schedule) :
+  fingerprint_(0),
+  schedule_(schedule),
+  ranged_(false),
+  permission_(permission),
+  valid_(true)
   {
-    std::string token;
-    std::istringstream ss(input);
+    for(unsigned short index = BUS ; index != UNDEFINED ; ++index)
+    {
+      assign(index,values[index]);
+    }
+  }
+
+  rule::rule(std::uint64_t fingerprint,bool permission) :
+  fingerprint_(fingerprint),
+  ranged_(false),
+  permission_(permission),
+  valid_(fingerprint != 0)
+  {}
+
+  rule::rule(std::string const& input) :
+  fingerprint_(0),
+  ranged_(false),
+  permission_(false),
+  valid_(false)
+  {
+    std::vector<std::string> tokens(split(input));
+
+    if(tokens.empty()) return;
+
+
+    std::vector<std::pair<unsigned short,std::string> > specs;
+
+    // keyword value pairs
+    if(keyword(tokens.front()) <= SCHEDULE)
+    {
+      for(std::size_t token = 0 ; token + 1 < tokens.size() ; token += 2)
+      {
+        unsigned short index = keyword(tokens[token]);
+
+        if(index > SCHEDULE) return;
+
+        specs.push_back(std::make_pair(index,tokens[token + 1]));
+      }
+
+      if(tokens.size() % 2 != 0) return;
+    }
+
+    // values in field order, the last one is the permission: rules of older
+    // formats leave the trailing fields masked
+    else
+    {
+      for(std::size_t token = 0 ; token + 1 < tokens.size() ; ++token)
+      {
+        if(token == UNDEFINED) return;
+
+        specs.push_back(std::make_pair(token,tokens[token]));
+      }
 
-    // extract device description
-    for(unsigned short token_index  = BUS ;
-                       token_index != UNDEFINED ; ++token_index)
+      specs.push_back(std::make_pair(PERMISSION,tokens.back()));
+    }
+
+
+    for(auto spec_it = specs.begin() ; spec_it != specs.end() ; ++spec_it)
     {
-      ss >> token;
+      if(spec_it->first == PERMISSION)
+      {
+        descriptor::value_type permission;
+
+        if(!parse_value(spec_it->second,permission)) return;
+
+        permission_ = permission != 0;
+      }
+
+      else if(spec_it->first == FINGERPRINT)
+      {
+        if(!parse_fingerprint(spec_it->second,fingerprint_)) return;
+      }
+
+      else if(spec_it->first == SCHEDULE)
+      {
+        if(!parse_schedule(spec_it->second,schedule_)) return;
+      }
+
+      else
+      {
+        value_set set;
+
+        if(!parse_values(spec_it->second,set)) return;
 
-      descriptor_[token_index] = std::stoi(token);
+        assign(spec_it->first,set);
+      }
     }
 
+    // the fingerprint covers the descriptors, pins don't match on fields
+    // and aren't scheduled
+    if(fingerprint_ != 0 && scheduled()) return;
 
-    ss >> token;
+    for(unsigned short index = BUS ; fingerprint_ != 0 && index != UNDEFINED ;
+        ++index)
+    {
+      if(uses(index)) return;
+    }
 
-    permission_ = static_cast<bool> (std::stoi(token));
+    valid_ = true;
   }
 
 
   unsigned short rule::evaluate(descriptor const& intf_desc) const
   {
-    unsigned short warrant;         
+    unsigned short warrant;
 
 
-    if(!descriptor_.relevant(intf_desc))
+    // pins are decided by the fingerprint of the device (rule_set)
+    bool relevant = fingerprint_ == 0 && descriptor_.relevant(intf_desc);
+
+    // ranged fields are masked in the exact descriptor
+    for(unsigned short index = BUS ; relevant && ranged_ && index != UNDEFINED ;
+        ++index)
+    {
+      value_set const& set = ranges_[index];
+
+      if(set.empty()) continue;
+
+      auto range_it = std::upper_bound(set.begin(),set.end(),intf_desc[index],
+                                       [](descriptor::value_type value,
+                                          value_range const& range)
+      {
+        return value < range.first;
+      });
+
+      relevant = range_it != set.begin() &&
+                 intf_desc[index] <= (range_it - 1)->last;
+    }
+
+
+    if(!relevant)
     {
       warrant = IGNORE;
     }
@@ -55,11 +263,155 @@ namespace gemini
   }
 
 
+  bool rule::uses(unsigned short index) const
+  {
+    return descriptor_[index] != MASKED || !ranges_[index].empty();
+  }
+
+  value_set const rule::values(unsigned short index) const
+  {
+    if(descriptor_[index] != MASKED)
+    {
+      return value_set(1,value_range{descriptor_[index],descriptor_[index]});
+    }
+
+    return ranges_[index];
+  }
+
+  bool rule::permission() const
+  {
+    return permission_;
+  }
+
+  std::uint64_t rule::fingerprint() const
+  {
+    return fingerprint_;
+  }
+
+  value_set const& rule::schedule() const
+  {
+    return schedule_;
+  }
+
+  bool rule::scheduled() const
+  {
+    return !schedule_.empty();
+  }
+
+  bool rule::active(std::time_t time) const
+  {
+    if(schedule_.empty()) return true;
+
+    std::tm local;
+
+    localtime_r(&time,&local);
+
+    descriptor::value_type minute = local.tm_hour * 60 + local.tm_min;
+
+    for(auto range_it = schedule_.begin() ; range_it != schedule_.end() ; ++range_it)
+    {
+      if(range_it->first <= minute && minute <= range_it->last) return true;
+    }
+
+    return false;
+  }
+
+  std::time_t rule::transition(std::time_t time) const
+  {
+    if(schedule_.empty()) return 0;
+
+    std::tm local;
+
+    localtime_r(&time,&local);
+
+    descriptor::value_type minute = local.tm_hour * 60 + local.tm_min,
+                           next   = 2 * MINUTES_PER_DAY;
+
+    // windows begin at their first and end after their last minute, the
+    // next boundary is today or tomorrow
+    for(auto range_it = schedule_.begin() ; range_it != schedule_.end() ; ++range_it)
+    {
+      descriptor::value_type bounds[] = {range_it->first,range_it->last + 1};
+
+      for(auto bound_it = std::begin(bounds) ; bound_it != std::end(bounds) ;
+          ++bound_it)
+      {
+        descriptor::value_type bound = *bound_it > minute ?
+                                       *bound_it : *bound_it + MINUTES_PER_DAY;
+
+        next = std::min(next,bound);
+      }
+    }
+
+    // mktime normalizes minutes past the day (daylight saving included)
+    local.tm_hour  = 0;
+    local.tm_min   = next;
+    local.tm_sec   = 0;
+    local.tm_isdst = -1;
+
+    std::time_t boundary = std::mktime(&local);
+
+    return boundary > time ? boundary : time + 60;
+  }
+
+
+  bool rule::valid() const
+  {
+    return valid_;
+  }
+
+
   std::string const rule::info(bool readable) const
   {
-    std::string rule_info(descriptor_.info(readable));
+    std::string rule_info;
+
+    // info format has no fingerprint and schedule fields, pins and
+    // scheduled rules are keyword pairs
+    if(scheduled())
+    {
+      for(unsigned short index = BUS ; index != UNDEFINED ; ++index)
+      {
+        if(!uses(index)) continue;
+
+        rule_info += DESCRIPTOR_FIELDS[index].name;
+        rule_info += " " + value_info(index) + " ";
+      }
+
+      rule_info += "SCHEDULE ";
+
+      for(auto range_it = schedule_.begin() ; range_it != schedule_.end() ; ++range_it)
+      {
+        if(range_it != schedule_.begin()) rule_info += ",";
 
-    rule_info += " ";
+        rule_info += time_info(range_it->first) + "-" +
+                     time_info(range_it->last + 1);
+      }
+
+      return rule_info + " PERMISSION " + std::to_string(permission_);
+    }
+
+    if(fingerprint_ != 0)
+    {
+      char fingerprint[19];
+
+      std::snprintf(fingerprint,sizeof(fingerprint),"0x%016llx",
+                    static_cast<unsigned long long> (fingerprint_));
+
+      return std::string("FINGERPRINT ") + fingerprint
+           + " PERMISSION " + std::to_string(permission_);
+    }
+
+    for(unsigned short index = BUS ; index != UNDEFINED ; ++index)
+    {
+      if(readable)
+      {
+        rule_info += "[";
+        rule_info += DESCRIPTOR_FIELDS[index].label;
+        rule_info += ":";
+      }
+
+      rule_info += value_info(index) + "] ";
+    }
 
     if(readable) rule_info += "[PERMISSION:";
 
@@ -72,6 +424,248 @@ namespace gemini
   }
 
 
+  // "*" and "0" mask the field, ranges and sets are sorted and merged
+  bool rule::parse_values(std::string const& spec,value_set & set)
+  {
+    set.clear();
+
+    if(spec == "*") return true;
+
+
+    std::istringstream ss(spec);
+
+    std::string item;
+
+    bool single = true;
+
+    while(getline(ss,item,','))
+    {
+      value_range range;
+
+      std::size_t separator = item.find('-',1);
+
+      if(separator == std::string::npos)
+      {
+        if(!parse_value(item,range.first)) return false;
+
+        range.last = range.first;
+      }
+
+      else
+      {
+        single = false;
+
+        if(!parse_value(item.substr(0,separator),range.first) ||
+           !parse_value(item.substr(separator + 1),range.last) ||
+           range.last < range.first)
+        {
+          return false;
+        }
+      }
+
+      set.push_back(range);
+    }
+
+    if(set.empty()) return false;
+
+
+    // a single 0 is the masked value of older rule formats, "0-0" matches 0
+    if(single && set.size() == 1 && set.front().first == MASKED)
+    {
+      set.clear();
+
+      return true;
+    }
+
+
+    merge(set);
+
+
+    return true;
+  }
+
+  // windows end before their end minute, "22:00-06:00" wraps at midnight and
+  // a window beginning at its end is the whole day
+  bool rule::parse_schedule(std::string const& spec,value_set & set)
+  {
+    set.clear();
+
+    std::istringstream ss(spec);
+
+    std::string item;
+
+    while(getline(ss,item,','))
+    {
+      std::size_t separator = item.find('-');
+
+      descriptor::value_type first,
+                             end;
+
+      if(separator == std::string::npos ||
+         !parse_time(item.substr(0,separator),first) ||
+         !parse_time(item.substr(separator + 1),end) ||
+         first == MINUTES_PER_DAY)
+      {
+        return false;
+      }
+
+      if(end > first) set.push_back(value_range{first,end - 1});
+
+      else
+      {
+        set.push_back(value_range{first,MINUTES_PER_DAY - 1});
+
+        if(end > 0) set.push_back(value_range{0,end - 1});
+      }
+    }
+
+    if(set.empty()) return false;
+
+    merge(set);
+
+    return true;
+  }
+
+  void rule::merge(value_set & set)
+  {
+    std::sort(set.begin(),set.end(),[](value_range const& r1,
+                                       value_range const& r2)
+    {
+      return r1.first < r2.first;
+    });
+
+    value_set merged;
+
+    for(auto range_it = set.begin() ; range_it != set.end() ; ++range_it)
+    {
+      if(!merged.empty() &&
+         (range_it->first <= merged.back().last ||
+          range_it->first == merged.back().last + 1))
+      {
+        merged.back().last = std::max(merged.back().last,range_it->last);
+      }
+
+      else merged.push_back(*range_it);
+    }
+
+    set.swap(merged);
+  }
+
+  // decimal or hexadecimal ("0x") number
+  bool rule::parse_value(std::string const& spec,descriptor::value_type & value)
+  {
+    int base = 10;
+
+    std::size_t begin = 0;
+
+    if(spec.size() > 2 && spec[0] == '0' && (spec[1] == 'x' || spec[1] == 'X'))
+    {
+      base  = 16;
+      begin = 2;
+    }
+
+    if(begin == spec.size()) return false;
+
+
+    unsigned long long number = 0;
+
+    for(std::size_t position = begin ; position < spec.size() ; ++position)
+    {
+      int digit;
+
+      if(std::isdigit(spec[position]))          digit = spec[position] - '0';
+      else if(base == 16 && std::isxdigit(spec[position]))
+      {
+        digit = std::tolower(spec[position]) - 'a' + 10;
+      }
+      else return false;
+
+      number = number * base + digit;
+
+      if(number > std::numeric_limits<descriptor::value_type>::max())
+      {
+        return false;
+      }
+    }
+
+    value = static_cast<descriptor::value_type> (number);
+
+    return true;
+  }
+
+
+  // hexadecimal number ("0x"), 0 pins no device
+  bool rule::parse_fingerprint(std::string const& spec,std::uint64_t & fingerprint)
+  {
+    if(spec.size() < 3 || spec.size() > 18 || spec[0] != '0' ||
+       (spec[1] != 'x' && spec[1] != 'X'))
+    {
+      return false;
+    }
+
+    fingerprint = 0;
+
+    for(std::size_t position = 2 ; position < spec.size() ; ++position)
+    {
+      if(!std::isxdigit(spec[position])) return false;
+
+      int digit = std::isdigit(spec[position]) ? spec[position] - '0' :
+                  std::tolower(spec[position]) - 'a' + 10;
+
+      fingerprint = (fingerprint << 4) | digit;
+    }
+
+    return fingerprint != 0;
+  }
+
+
+  std::string const rule::value_info(unsigned short index) const
+  {
+    if(ranges_[index].empty()) return std::to_string(descriptor_[index]);
+
+
+    std::string values;
+
+    for(auto range_it  = ranges_[index].begin() ;
+             range_it != ranges_[index].end()   ; ++range_it)
+    {
+      if(range_it != ranges_[index].begin()) values += ",";
+
+      values += std::to_string(range_it->first);
+
+      // a single 0 would mask the field
+      if(range_it->last != range_it->first || range_it->first == MASKED)
+      {
+        values += "-" + std::to_string(range_it->last);
+      }
+    }
+
+    return values;
+  }
+
+
+  // single values stay exact matches of the descriptor
+  void rule::assign(unsigned short index,value_set const& set)
+  {
+    descriptor_[index] = MASKED;
+
+    ranges_[index].clear();
+
+    if(set.size() == 1 && set.front().first == set.front().last &&
+                          set.front().first != MASKED)
+    {
+      descriptor_[index] = set.front().first;
+    }
+
+    else if(!set.empty())
+    {
+      ranges_[index] = set;
+
+      ranged_ = true;
+    }
+  }
+
+
   std::ostream & operator << (std::ostream & out,rule const& r)
   {
     out << r.info(true)
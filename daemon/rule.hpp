@@ -2,6 +2,11 @@
 #define GEMINI_RULE
 
 
+#include <array>
+#include <cstdint>
+#include <ctime>
+#include <vector>
+
 #include <descriptor.hpp>
 
 namespace gemini
@@ -9,23 +14,101 @@ namespace gemini
 
 enum EVALUATION{PERMIT,PROHIBIT,IGNORE};
 
+// inclusive range of field values
+struct value_range
+{
+  descriptor::value_type first,
+                         last;
+};
+
+// sorted, disjoint ranges, empty if the field is masked
+typedef std::vector<value_range> value_set;
+
+
 class rule
 {
   public :
 
   rule(descriptor const& desc,bool permission);
+
+  // values of every field, empty sets are masked
+  rule(std::array<value_set,DESCRIPTOR_SIZE> const& values,bool permission,
+       value_set const& schedule = value_set());
+
+  // pins a device fingerprint (descriptor::fingerprint), every field masked
+  rule(std::uint64_t fingerprint,bool permission);
+
+  // fields in order and the permission last ("1 2 0 0 3 0 0 0 0 1"), as
+  // keyword value pairs ("VENDOR_ID 0x046d PERMISSION 0") or in info format,
+  // every field value may be a range or a set ("0x1000-0x10ff,0x2000"),
+  // pinning rules are keyword pairs without fields ("FINGERPRINT
+  // 0x8f3a51c0d2e47b16 PERMISSION 1"), scheduled rules are keyword pairs
+  // with daily time windows ("INTERFACE_CLASS 8 SCHEDULE 02:00-03:00
+  // PERMISSION 1")
   rule(std::string const& input);
 
   unsigned short evaluate(descriptor const& intf_desc) const;
 
+  // rule matches on the field (isn't masked)
+  bool uses(unsigned short index) const;
+
+  // values the field matches, empty if masked
+  value_set const values(unsigned short index) const;
+
+  bool permission() const;
+
+  // fingerprint the rule pins, 0 if the rule matches on fields
+  std::uint64_t fingerprint() const;
+
+  // minutes of the day (local time) the rule is active in, empty if the rule
+  // is always active
+  value_set const& schedule() const;
+
+  bool scheduled() const;
+  bool active(std::time_t time) const;
+
+  // next minute boundary after time the rule could change its activity, 0
+  // if the rule isn't scheduled
+  std::time_t transition(std::time_t time) const;
+
+  // rule string could be parsed
+  bool valid() const;
+
   std::string const info(bool readable) const;
 
 
   private :
 
+  // field value specification ("*", "5", "0x10-0x1f,0x30")
+  static bool parse_values(std::string const& spec,value_set & set);
+  static bool parse_value(std::string const& spec,descriptor::value_type & value);
+  static bool parse_fingerprint(std::string const& spec,std::uint64_t & fingerprint);
+
+  // time windows ("02:00-03:00,22:00-06:00", windows crossing midnight wrap)
+  static bool parse_schedule(std::string const& spec,value_set & set);
+
+  // sort and merge overlapping and adjacent ranges
+  static void merge(value_set & set);
+
+  // field values as rule text ("0x1000-0x10ff,0x2000" as "4096-4351,8192")
+  std::string const value_info(unsigned short index) const;
+
+  void assign(unsigned short index,value_set const& set);
+
+
+  // exact values, fields with ranges are masked here
   descriptor descriptor_;
-  
-  bool       permission_;
+
+  // ranges and sets of values by field
+  std::array<value_set,DESCRIPTOR_SIZE> ranges_;
+
+  std::uint64_t fingerprint_;
+
+  value_set     schedule_;
+
+  bool       ranged_,
+             permission_,
+             valid_;
 };
 
 std::ostream & operator << (std::ostream & out,rule const& r);
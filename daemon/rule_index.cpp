@@ -0,0 +1,255 @@
+// std
+#include <algorithm>
+#include <array>
+#include <limits>
+#include <utility>
+
+// gemini
+#include <metrics.hpp>
+
+// class
+#include <rule_index.hpp>
+
+
+namespace gemini
+{
+
+const std::size_t rule_index::NO_MATCH = std::numeric_limits<std::size_t>::max();
+
+
+rule_index::rule_index() :
+words_(0),
+stride_(0)
+{}
+
+
+void rule_index::build(std::list<rule>            const& rules,
+                       std::vector<std::uint64_t> const& hits,
+                       std::vector<bool>          const& active,
+                       std::vector<std::size_t>   const& order)
+{
+  fields_.clear();
+  permissions_.clear();
+
+  words_  = (rules.size() + 63) / 64;
+  stride_ = (rules.size() + 7) / 8 * 8;
+
+  // bit of every rule, its rank in the evaluation order
+  std::vector<std::size_t> bits(rules.size());
+
+  positions_.resize(rules.size());
+
+  for(std::size_t bit = 0 ; bit < rules.size() ; ++bit)
+  {
+    positions_[bit] = order.size() == rules.size() ? order[bit] : bit;
+
+    bits[positions_[bit]] = bit;
+  }
+
+  active_.assign(words_,0);
+
+  for(std::size_t position = 0 ; position < rules.size() ; ++position)
+  {
+    if(position >= active.size() || active[position])
+    {
+      active_[bits[position] / 64] |= 1ULL << (bits[position] % 64);
+    }
+  }
+
+  hits_.reset(new std::atomic<std::uint64_t>[counter::SHARDS * stride_]);
+
+  for(std::size_t position = 0 ; position < counter::SHARDS * stride_ ; ++position)
+  {
+    hits_[position].store(position < hits.size() ? hits[position] : 0,
+                          std::memory_order_relaxed);
+  }
+
+  for(auto rule_it = rules.begin() ; rule_it != rules.end() ; ++rule_it)
+  {
+    permissions_.push_back(rule_it->permission());
+  }
+
+
+  for(unsigned short index = BUS ; index != UNDEFINED ; ++index)
+  {
+    std::vector<std::uint64_t> wildcards(words_,0);
+
+    // ranges of the rules matching on the field and their bit
+    std::vector<std::pair<value_range,std::size_t> > ranges;
+
+    std::size_t position = 0;
+
+    for(auto rule_it = rules.begin() ; rule_it != rules.end() ;
+        ++rule_it , ++position)
+    {
+      if(!rule_it->uses(index))
+      {
+        wildcards[bits[position] / 64] |= 1ULL << (bits[position] % 64);
+
+        continue;
+      }
+
+      value_set set(rule_it->values(index));
+
+      for(auto range_it = set.begin() ; range_it != set.end() ; ++range_it)
+      {
+        ranges.push_back(std::make_pair(*range_it,bits[position]));
+      }
+    }
+
+    // every rule matches every value
+    if(ranges.empty()) continue;
+
+
+    field_index field;
+
+    field.index = index;
+
+    field.bounds.push_back(0);
+
+    for(auto range_it = ranges.begin() ; range_it != ranges.end() ; ++range_it)
+    {
+      field.bounds.push_back(range_it->first.first);
+
+      if(range_it->first.last != std::numeric_limits<descriptor::value_type>::max())
+      {
+        field.bounds.push_back(range_it->first.last + 1);
+      }
+    }
+
+    std::sort(field.bounds.begin(),field.bounds.end());
+
+    field.bounds.erase(std::unique(field.bounds.begin(),field.bounds.end()),
+                       field.bounds.end());
+
+
+    // a rule enters at the segment of its first value and leaves after the
+    // segment of its last value, ranges of a rule are disjoint
+    std::vector<std::pair<std::size_t,std::size_t> > toggles;
+
+    for(auto range_it = ranges.begin() ; range_it != ranges.end() ; ++range_it)
+    {
+      std::size_t first =
+
+      std::lower_bound(field.bounds.begin(),field.bounds.end(),
+                       range_it->first.first) - field.bounds.begin();
+
+      toggles.push_back(std::make_pair(first,range_it->second));
+
+      if(range_it->first.last != std::numeric_limits<descriptor::value_type>::max())
+      {
+        std::size_t last =
+
+        std::lower_bound(field.bounds.begin(),field.bounds.end(),
+                         range_it->first.last + 1) - field.bounds.begin();
+
+        toggles.push_back(std::make_pair(last,range_it->second));
+      }
+    }
+
+    std::sort(toggles.begin(),toggles.end());
+
+
+    field.segments.resize(field.bounds.size() * words_);
+
+    std::vector<std::uint64_t> active(wildcards);
+
+    auto toggle_it = toggles.begin();
+
+    for(std::size_t segment = 0 ; segment < field.bounds.size() ; ++segment)
+    {
+      for( ; toggle_it != toggles.end() && toggle_it->first == segment ;
+           ++toggle_it)
+      {
+        active[toggle_it->second / 64] ^= 1ULL << (toggle_it->second % 64);
+      }
+
+      std::copy(active.begin(),active.end(),
+                field.segments.begin() + segment * words_);
+    }
+
+    fields_.push_back(std::move(field));
+  }
+}
+
+
+std::size_t rule_index::first_match(descriptor const& desc,
+                                    std::size_t     & evaluated) const
+{
+  std::array<std::uint64_t const*,DESCRIPTOR_SIZE> segments;
+
+  for(std::size_t field = 0 ; field < fields_.size() ; ++field)
+  {
+    field_index const& field_idx = fields_[field];
+
+    const descriptor::value_type value = desc[field_idx.index];
+
+    // branchless search of the last bound not above the value, random values
+    // mispredict the branches of a binary search
+    descriptor::value_type const* bound  = field_idx.bounds.data();
+    std::size_t                   length = field_idx.bounds.size();
+
+    while(length > 1)
+    {
+      std::size_t half = length / 2;
+
+      bound   = bound[half] <= value ? bound + half : bound;
+      length -= half;
+    }
+
+    segments[field] = field_idx.segments.data() +
+                      (bound - field_idx.bounds.data()) * words_;
+  }
+
+
+  const std::size_t rules = permissions_.size();
+
+  for(std::size_t word = 0 ; word < words_ ; ++word)
+  {
+    std::uint64_t matches = active_[word];
+
+    for(std::size_t field = 0 ; matches != 0 && field < fields_.size() ; ++field)
+    {
+      matches &= segments[field][word];
+    }
+
+    if(matches != 0)
+    {
+      evaluated = std::min(rules,(word + 1) * 64);
+
+      return positions_[word * 64 + __builtin_ctzll(matches)];
+    }
+  }
+
+  evaluated = rules;
+
+  return NO_MATCH;
+}
+
+
+bool rule_index::permission(std::size_t position) const
+{
+  return permissions_[position];
+}
+
+
+void rule_index::hit(std::size_t position)
+{
+  hits_[counter::thread_shard() * stride_ + position].fetch_add
+
+  (1,std::memory_order_relaxed);
+}
+
+std::uint64_t rule_index::hits(std::size_t position) const
+{
+  std::uint64_t sum = 0;
+
+  for(unsigned short shard = 0 ; shard < counter::SHARDS ; ++shard)
+  {
+    sum += hits_[shard * stride_ + position].load(std::memory_order_relaxed);
+  }
+
+  return sum;
+}
+
+}
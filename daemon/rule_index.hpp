@@ -0,0 +1,87 @@
+#ifndef GEMINI_RULE_INDEX
+#define GEMINI_RULE_INDEX
+
+
+// std
+#include <atomic>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <vector>
+
+// gemini
+#include <rule.hpp>
+
+
+namespace gemini
+{
+
+// first matching rule without a scan over the rules: the values of a field
+// are split at the sorted range boundaries of every rule, each segment holds
+// a bit per rule matching its values (masked rules match every segment) and
+// the lowest bit set in the segments of every field is the first match
+class rule_index
+{
+  public :
+
+  rule_index();
+
+  // hits of the rules are carried over (reordered rules keep their hits),
+  // inactive rules (scheduled) keep their position but never match, every
+  // rule is active without flags, rules are evaluated in order (positions
+  // of the rules, the list order if empty)
+  void build(std::list<rule>            const& rules,
+             std::vector<std::uint64_t> const& hits   = std::vector<std::uint64_t>(),
+             std::vector<bool>          const& active = std::vector<bool>(),
+             std::vector<std::size_t>   const& order  = std::vector<std::size_t>());
+
+  // position (in the list) of the first rule matching the descriptor in
+  // evaluation order, NO_MATCH if none does, evaluated counts the rules
+  // compared (64 per word)
+  std::size_t first_match(descriptor const& desc,std::size_t & evaluated) const;
+
+  bool permission(std::size_t position) const;
+
+  // decisions of a rule, every thread counts in its own row
+  void hit(std::size_t position);
+  std::uint64_t hits(std::size_t position) const;
+
+
+  static const std::size_t NO_MATCH;
+
+
+  private :
+
+  struct field_index
+  {
+    unsigned short                      index;
+
+    // first value of every segment, the first segment starts at 0
+    std::vector<descriptor::value_type> bounds;
+
+    // words_ words per segment
+    std::vector<std::uint64_t>          segments;
+  };
+
+
+  // fields at least one rule matches on
+  std::vector<field_index> fields_;
+
+  std::vector<bool>        permissions_;
+
+  // position of the rule of every bit (evaluation order)
+  std::vector<std::size_t> positions_;
+
+  // bit per active rule, no bits past the last rule
+  std::vector<std::uint64_t> active_;
+
+  std::size_t              words_;
+
+  // hit counters, a row of stride_ counters (whole cache lines) per shard
+  std::unique_ptr<std::atomic<std::uint64_t>[]> hits_;
+  std::size_t                                   stride_;
+};
+
+}
+
+#endif // GEMINI_RULE_INDEX
@@ -0,0 +1,354 @@
+// std
+#include <algorithm>
+#include <limits>
+
+// class
+#include <rule_optimizer.hpp>
+
+
+namespace gemini
+{
+
+const std::size_t rule_optimizer::DEFAULT_RULE =
+
+std::numeric_limits<std::size_t>::max();
+
+
+namespace
+{
+  // rule of the working set and its position in the analyzed rule set
+  struct entry
+  {
+    rule        r;
+    std::size_t origin;
+  };
+
+  bool equal(value_set const& a,value_set const& b)
+  {
+    return a.size() == b.size() &&
+           std::equal(a.begin(),a.end(),b.begin(),
+                      [](value_range const& r1,value_range const& r2)
+    {
+      return r1.first == r2.first && r1.last == r2.last;
+    });
+  }
+
+  bool every_value(value_set const& set)
+  {
+    return set.empty() ||
+           (set.size() == 1 && set.front().first == 0 &&
+            set.front().last == std::numeric_limits<descriptor::value_type>::max());
+  }
+}
+
+
+std::string const rule_finding::info() const
+{
+  std::string finding_info("rule " + std::to_string(rule + 1));
+
+  std::string other_info(other == rule_optimizer::DEFAULT_RULE ?
+
+                         "the default permission" :
+                         "rule " + std::to_string(other + 1));
+
+  switch(type)
+  {
+    case FINDING_SHADOWED  : finding_info += " is shadowed by "     ; break;
+    case FINDING_REDUNDANT : finding_info += " is redundant to "    ; break;
+    case FINDING_MERGED    : finding_info += " is merged into "     ; break;
+    case FINDING_CONFLICT  : finding_info += " is partly decided by "; break;
+  }
+
+  return finding_info + other_info;
+}
+
+
+std::list<rule> rule_optimizer::
+
+optimize(std::list<rule> const& rules,std::vector<rule_finding> & findings)
+{
+  std::vector<entry> entries;
+
+  std::size_t origin = 0;
+
+  for(auto rule_it = rules.begin() ; rule_it != rules.end() ; ++rule_it)
+  {
+    entries.push_back(entry{*rule_it,origin++});
+  }
+
+
+  // a merge can shadow later rules, repeat until nothing changes
+  bool changed = true;
+
+  while(changed)
+  {
+    changed = false;
+
+    // shadowed: an earlier rule matches every value first
+    for(std::size_t later = 1 ; later < entries.size() ;)
+    {
+      std::size_t earlier = 0;
+
+      while(earlier < later && !covers(entries[earlier].r,entries[later].r))
+      {
+        ++earlier;
+      }
+
+      if(earlier < later)
+      {
+        findings.push_back(rule_finding{FINDING_SHADOWED,entries[later].origin,
+                                        entries[earlier].origin});
+
+        entries.erase(entries.begin() + later);
+
+        changed = true;
+      }
+
+      else ++later;
+    }
+
+
+    // redundant: values fall through to a rule of the same permission
+    for(std::size_t current = 0 ; current < entries.size() ;)
+    {
+      rule const& current_rule = entries[current].r;
+
+      std::size_t decider = current + 1;
+
+      bool redundant = false;
+
+      for( ; decider < entries.size() ; ++decider)
+      {
+        rule const& decider_rule = entries[decider].r;
+
+        if(!intersects(decider_rule,current_rule)) continue;
+
+        if(decider_rule.permission() != current_rule.permission()) break;
+
+        if(covers(decider_rule,current_rule))
+        {
+          redundant = true;
+
+          break;
+        }
+      }
+
+      // no later rule decides differently, interfaces no rule matches are
+      // permitted
+      if(decider == entries.size() && current_rule.permission())
+      {
+        redundant = true;
+      }
+
+      if(redundant)
+      {
+        findings.push_back(rule_finding{FINDING_REDUNDANT,entries[current].origin,
+                                        decider == entries.size() ?
+                                        DEFAULT_RULE : entries[decider].origin});
+
+        entries.erase(entries.begin() + current);
+
+        changed = true;
+      }
+
+      else ++current;
+    }
+
+
+    // merge: adjacent rules of the same permission differing in one field
+    for(std::size_t current = 0 ; current + 1 < entries.size() ;)
+    {
+      rule const& first  = entries[current].r;
+      rule const& second = entries[current + 1].r;
+
+      unsigned short differences = 0,
+                     field       = UNDEFINED;
+
+      for(unsigned short index = BUS ; index != UNDEFINED ; ++index)
+      {
+        if(!equal(first.values(index),second.values(index)))
+        {
+          ++differences;
+
+          field = index;
+        }
+      }
+
+      // rules of different schedules are active at different times
+      if(!equal(first.schedule(),second.schedule())) ++differences;
+
+      if(first.permission() == second.permission() && differences == 1 &&
+         field != UNDEFINED)
+      {
+        std::array<value_set,DESCRIPTOR_SIZE> values;
+
+        for(unsigned short index = BUS ; index != UNDEFINED ; ++index)
+        {
+          values[index] = index == field ?
+
+                          unite(first.values(index),second.values(index)) :
+                          first.values(index);
+        }
+
+        findings.push_back(rule_finding{FINDING_MERGED,entries[current + 1].origin,
+                                        entries[current].origin});
+
+        entries[current].r = rule(values,first.permission(),first.schedule());
+
+        entries.erase(entries.begin() + current + 1);
+
+        changed = true;
+      }
+
+      else ++current;
+    }
+  }
+
+
+  // conflicts of the remaining rules
+  for(std::size_t later = 1 ; later < entries.size() ; ++later)
+  {
+    for(std::size_t earlier = 0 ; earlier < later ; ++earlier)
+    {
+      if(entries[earlier].r.permission() != entries[later].r.permission() &&
+         intersects(entries[earlier].r,entries[later].r))
+      {
+        findings.push_back(rule_finding{FINDING_CONFLICT,entries[later].origin,
+                                        entries[earlier].origin});
+      }
+    }
+  }
+
+
+  std::list<rule> optimized;
+
+  for(auto entry_it = entries.begin() ; entry_it != entries.end() ; ++entry_it)
+  {
+    optimized.push_back(entry_it->r);
+  }
+
+  return optimized;
+}
+
+
+std::vector<std::size_t> rule_optimizer::
+
+reorder(std::list<rule> const& rules,std::vector<std::uint64_t> const& hits)
+{
+  std::vector<rule> positions(rules.begin(),rules.end());
+
+  std::vector<std::size_t> order;
+
+  // insertion, swaps of adjacent disjoint rules only
+  for(std::size_t position = 0 ; position < positions.size() ; ++position)
+  {
+    order.push_back(position);
+
+    for(std::size_t current = order.size() - 1 ; current > 0 ; --current)
+    {
+      std::size_t earlier = order[current - 1],
+                  later   = order[current];
+
+      if(hits[earlier] >= hits[later] ||
+         intersects(positions[earlier],positions[later])) break;
+
+      std::swap(order[current - 1],order[current]);
+    }
+  }
+
+  return order;
+}
+
+
+bool rule_optimizer::covers(value_set const& a,value_set const& b)
+{
+  if(every_value(a)) return true;
+  if(every_value(b)) return false;
+
+  // ranges are sorted and disjoint, every range of b lies in one of a
+  auto a_it = a.begin();
+
+  for(auto b_it = b.begin() ; b_it != b.end() ; ++b_it)
+  {
+    while(a_it != a.end() && a_it->last < b_it->first) ++a_it;
+
+    if(a_it == a.end() || a_it->first > b_it->first ||
+                          a_it->last  < b_it->last) return false;
+  }
+
+  return true;
+}
+
+bool rule_optimizer::intersects(value_set const& a,value_set const& b)
+{
+  if(a.empty() || b.empty()) return true;
+
+  auto a_it = a.begin();
+  auto b_it = b.begin();
+
+  while(a_it != a.end() && b_it != b.end())
+  {
+    if(a_it->last < b_it->first)      ++a_it;
+    else if(b_it->last < a_it->first) ++b_it;
+    else                              return true;
+  }
+
+  return false;
+}
+
+value_set const rule_optimizer::unite(value_set const& a,value_set const& b)
+{
+  if(every_value(a) || every_value(b)) return value_set();
+
+
+  value_set ranges(a);
+
+  ranges.insert(ranges.end(),b.begin(),b.end());
+
+  std::sort(ranges.begin(),ranges.end(),[](value_range const& r1,
+                                           value_range const& r2)
+  {
+    return r1.first < r2.first;
+  });
+
+  value_set united;
+
+  for(auto range_it = ranges.begin() ; range_it != ranges.end() ; ++range_it)
+  {
+    if(!united.empty() &&
+       (range_it->first <= united.back().last ||
+        range_it->first == united.back().last + 1))
+    {
+      united.back().last = std::max(united.back().last,range_it->last);
+    }
+
+    else united.push_back(*range_it);
+  }
+
+  return united;
+}
+
+
+// schedules are minute sets like field values, always active rules have an
+// empty schedule matching every minute
+bool rule_optimizer::covers(rule const& a,rule const& b)
+{
+  for(unsigned short index = BUS ; index != UNDEFINED ; ++index)
+  {
+    if(!covers(a.values(index),b.values(index))) return false;
+  }
+
+  return covers(a.schedule(),b.schedule());
+}
+
+bool rule_optimizer::intersects(rule const& a,rule const& b)
+{
+  for(unsigned short index = BUS ; index != UNDEFINED ; ++index)
+  {
+    if(!intersects(a.values(index),b.values(index))) return false;
+  }
+
+  return intersects(a.schedule(),b.schedule());
+}
+
+}
@@ -0,0 +1,75 @@
+#ifndef GEMINI_RULE_OPTIMIZER
+#define GEMINI_RULE_OPTIMIZER
+
+
+// std
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <string>
+#include <vector>
+
+// gemini
+#include <rule.hpp>
+
+
+namespace gemini
+{
+
+enum finding_type{FINDING_SHADOWED,FINDING_REDUNDANT,FINDING_MERGED,
+                  FINDING_CONFLICT};
+
+// finding about a rule, positions count from 0 in the analyzed rule set
+struct rule_finding
+{
+  finding_type type;
+
+  std::size_t  rule,
+               other;
+
+  std::string const info() const;
+};
+
+
+// minimizes a rule set without changing any decision of the first match:
+//
+// - shadowed rules are covered by an earlier rule and never match first
+// - redundant rules are covered by a later rule (or the default permission)
+//   of the same permission, no rule between them decides their values
+//   differently
+// - adjacent rules of the same permission differing in one field are merged
+//   into one rule matching the union of both values
+//
+// conflicts are overlapping rules of different permissions, the earlier one
+// decides the common values, they are reported but kept
+class rule_optimizer
+{
+  public :
+
+  static std::list<rule> optimize(std::list<rule>           const& rules,
+                                  std::vector<rule_finding>      & findings);
+
+  // order of the rules (positions) with hot rules ahead: a rule passes an
+  // earlier rule with fewer hits only if no interface matches both, so the
+  // first match of every interface is the same rule
+  static std::vector<std::size_t> reorder(std::list<rule>            const& rules,
+                                          std::vector<std::uint64_t> const& hits);
+
+  // the default permission of values no rule matches
+  static const std::size_t DEFAULT_RULE;
+
+
+  private :
+
+  // every value of field set b is a value of a (empty sets hold every value)
+  static bool covers(value_set const& a,value_set const& b);
+  static bool intersects(value_set const& a,value_set const& b);
+  static value_set const unite(value_set const& a,value_set const& b);
+
+  static bool covers(rule const& a,rule const& b);
+  static bool intersects(rule const& a,rule const& b);
+};
+
+}
+
+#endif // GEMINI_RULE_OPTIMIZER
@@ -1,5 +1,6 @@
 #include <sstream>
 
+#include <metrics.hpp>
 #include <rule_set.hpp>
 
 
@@ -7,7 +8,14 @@ namespace gemini
 {
 
 rule_set::rule_set(std::string const& path) :
-path_(path)
+path_(path),
+fields_(0),
+schedule_time_(std::time(nullptr)),
+wheel_(schedule_time_),
+schedule_valid_(false),
+index_valid_(false),
+fingerprint_(0),
+fingerprint_valid_(false)
 {}
 
 
@@ -34,32 +42,424 @@ std::string const rule_set::gemini_home_path()
 
 bool rule_set::permission(descriptor const& desc)
 {
+  std::size_t position;
+
+  return permission(desc,position);
+}
+
+bool rule_set::permission(descriptor const& desc,std::size_t & position)
+{
+  compile();
+
+
+  std::size_t evaluated = 0;
+
+  metrics().decisions.add();
+
+  position = index_.first_match(desc,evaluated);
+
+  metrics().rules_evaluated.add(evaluated);
+
+
+  // interfaces no rule matches are permitted
+  if(position == rule_index::NO_MATCH) return true;
+
+  index_.hit(position);
+
+  return index_.permission(position);
+}
+
+
+void rule_set::hit(std::size_t position)
+{
+  compile();
+
+  if(position < rules_.size()) index_.hit(position);
+}
+
+
+bool rule_set::pinned(std::uint64_t fingerprint,bool & permission) const
+{
+  auto pin_it = pinned_.find(fingerprint);
+
+  if(pin_it == pinned_.end()) return false;
+
+  permission = pin_it->second;
+
+  return true;
+}
+
+
+std::size_t rule_set::deciding_rule(descriptor const& desc,
+                                    std::uint64_t fingerprint)
+{
+  std::size_t position;
+
+  decide(desc,fingerprint,position);
+
+  return position;
+}
+
+bool rule_set::decide(descriptor const& desc,std::uint64_t fingerprint,
+                      std::size_t & position)
+{
+  bool pin_permission;
+
+  // the first pin of the fingerprint decides
+  if(pinned(fingerprint,pin_permission))
+  {
+    position = 0;
+
+    for(auto pin_it = pins_.begin() ; pin_it->fingerprint() != fingerprint ;
+        ++pin_it) ++position;
+
+    return pin_permission;
+  }
+
+
+  compile();
+
+  std::size_t evaluated = 0;
+
+  position = index_.first_match(desc,evaluated);
+
+  // interfaces no rule matches are permitted
+  if(position == rule_index::NO_MATCH) return true;
+
+  bool permission = index_.permission(position);
+
+  position += pins_.size();
+
+  return permission;
+}
+
+bool rule_set::reference_permission(descriptor const& desc,
+                                    std::uint64_t fingerprint,
+                                    std::size_t & position) const
+{
+  position = 0;
+
+  for(auto pin_it = pins_.begin() ; pin_it != pins_.end() ;
+      ++pin_it , ++position)
+  {
+    if(fingerprint != 0 && pin_it->fingerprint() == fingerprint)
+    {
+      return pin_it->permission();
+    }
+  }
+
+
   unsigned short evaluation = IGNORE;
 
-  for(auto rule_it = rules_.begin() ; rule_it != rules_.end() ; ++rule_it)
+  for(auto rule_it = rules_.begin() ; rule_it != rules_.end() ;
+      ++rule_it , ++position)
   {
+    if(!rule_it->active(schedule_time_)) continue;
+
     evaluation = rule_it->evaluate(desc);
 
     if(evaluation != IGNORE) return evaluation == PERMIT;
   }
 
+  position = rule_index::NO_MATCH;
+
+  // the fallback of the original matcher, IGNORE converts to true
   return evaluation;
 }
 
 
 void rule_set::push_back(rule const& r)
 {
+  // the first pin of a fingerprint decides
+  if(r.fingerprint() != 0)
+  {
+    pins_.push_back(r);
+
+    pinned_.insert(std::make_pair(r.fingerprint(),r.permission()));
+
+    fingerprint_valid_ = false;
+
+    return;
+  }
+
   rules_.push_back(r);
+  order_.clear();
+  active_.push_back(r.active(schedule_time_));
+
+  used(r);
+
+  index_valid_      = false;
+  fingerprint_valid_ = false;
+  schedule_valid_    = false;
 }
 
 void rule_set::push_front(rule const& r)
 {
+  if(r.fingerprint() != 0)
+  {
+    pins_.push_front(r);
+
+    pinned_[r.fingerprint()] = r.permission();
+
+    fingerprint_valid_ = false;
+
+    return;
+  }
+
   rules_.push_front(r);
+  order_.clear();
+  active_.insert(active_.begin(),r.active(schedule_time_));
+
+  used(r);
+
+  index_valid_      = false;
+  fingerprint_valid_ = false;
+  schedule_valid_    = false;
 }
 
 void rule_set::clear()
 {
   rules_.clear();
+  order_.clear();
+  pins_.clear();
+  pinned_.clear();
+  active_.clear();
+
+  fields_ = 0;
+
+  index_valid_      = false;
+  fingerprint_valid_ = false;
+  schedule_valid_    = false;
+}
+
+
+void rule_set::optimize(std::vector<rule_finding> & findings)
+{
+  std::list<rule> optimized(rule_optimizer::optimize(rules_,findings)),
+                  pins(pins_);
+
+  clear();
+
+  optimized.splice(optimized.begin(),pins);
+
+  for(auto rule_it = optimized.begin() ; rule_it != optimized.end() ; ++rule_it)
+  {
+    push_back(*rule_it);
+  }
+}
+
+std::size_t rule_set::size() const
+{
+  return pins_.size() + rules_.size();
+}
+
+
+std::vector<std::uint64_t> const rule_set::hits() const
+{
+  std::vector<std::uint64_t> rule_hits(rules_.size(),0);
+
+  // no decision since the latest modification
+  if(!index_valid_.load(std::memory_order_acquire)) return rule_hits;
+
+  for(std::size_t position = 0 ; position < rule_hits.size() ; ++position)
+  {
+    rule_hits[position] = index_.hits(position);
+  }
+
+  return rule_hits;
+}
+
+bool rule_set::reorder()
+{
+  std::vector<std::uint64_t> rule_hits(hits());
+
+  std::vector<std::size_t> order(rule_optimizer::reorder(rules_,rule_hits));
+
+  bool changed = false;
+
+  for(std::size_t position = 0 ; position < order.size() ; ++position)
+  {
+    if(order[position] != (order_.empty() ? position : order_[position]))
+    {
+      changed = true;
+    }
+  }
+
+  if(!changed) return false;
+
+
+  // compiled beside the current index and swapped in, the rules keep their
+  // hits
+  rule_index compiled;
+
+  compiled.build(rules_,rule_hits,active_,order);
+
+  std::lock_guard<std::mutex> lock(index_mutex_);
+
+  order_.swap(order);
+
+  std::swap(index_,compiled);
+
+  index_valid_.store(true,std::memory_order_release);
+
+
+  return true;
+}
+
+
+void rule_set::advance(std::time_t time,std::vector<rule> & toggled)
+{
+  std::vector<std::size_t> expired;
+
+  const bool rebuild = !schedule_valid_ ||
+                       time < static_cast<std::time_t> (wheel_.now());
+
+  // modified rule set or clock set back, every scheduled rule is timed again
+  if(rebuild)
+  {
+    wheel_.clear(time);
+
+    std::size_t position = 0;
+
+    for(auto rule_it = rules_.begin() ; rule_it != rules_.end() ;
+        ++rule_it , ++position)
+    {
+      if(!rule_it->scheduled()) continue;
+
+      wheel_.schedule(rule_it->transition(time),position);
+
+      expired.push_back(position);
+    }
+
+    schedule_valid_ = true;
+  }
+
+  else wheel_.advance(time,expired);
+
+  schedule_time_ = time;
+
+  if(expired.empty()) return;
+
+
+  std::vector<rule const*> positions;
+
+  for(auto rule_it = rules_.begin() ; rule_it != rules_.end() ; ++rule_it)
+  {
+    positions.push_back(&*rule_it);
+  }
+
+  bool changed = false;
+
+  for(auto expired_it = expired.begin() ; expired_it != expired.end() ; ++expired_it)
+  {
+    rule const& scheduled_rule = *positions[*expired_it];
+
+    if(!rebuild)
+    {
+      wheel_.schedule(scheduled_rule.transition(time),*expired_it);
+    }
+
+    bool active = scheduled_rule.active(time);
+
+    if(active != active_[*expired_it])
+    {
+      active_[*expired_it] = active;
+
+      toggled.push_back(scheduled_rule);
+
+      changed = true;
+    }
+  }
+
+  if(!changed) return;
+
+
+  fingerprint_valid_ = false;
+
+  // compiled beside the current index and swapped in, decisions see the old
+  // or the new activity (transitions and passes run on the server thread)
+  rule_index compiled;
+
+  compiled.build(rules_,hits(),active_,order_);
+
+  std::lock_guard<std::mutex> lock(index_mutex_);
+
+  std::swap(index_,compiled);
+
+  index_valid_.store(true,std::memory_order_release);
+}
+
+
+void rule_set::compile()
+{
+  if(!index_valid_.load(std::memory_order_acquire))
+  {
+    std::lock_guard<std::mutex> lock(index_mutex_);
+
+    if(!index_valid_.load(std::memory_order_relaxed))
+    {
+      index_.build(rules_,std::vector<std::uint64_t>(),active_,order_);
+
+      index_valid_.store(true,std::memory_order_release);
+    }
+  }
+}
+
+
+bool rule_set::uses(unsigned short index) const
+{
+  return (fields_ >> index) & 1;
+}
+
+void rule_set::used(rule const& r)
+{
+  for(unsigned short index = BUS ; index != UNDEFINED ; ++index)
+  {
+    if(r.uses(index)) fields_ |= 1U << index;
+  }
+}
+
+
+// FNV-1a hash over the unreadable rule strings (order sensitive)
+std::uint64_t rule_set::fingerprint() const
+{
+  if(!fingerprint_valid_)
+  {
+    const std::uint64_t fnv_prime = 1099511628211ULL;
+
+    fingerprint_ = 14695981039346656037ULL;
+
+    std::list<rule> const* lists[] = {&pins_,&rules_};
+
+    for(auto list_it = std::begin(lists) ; list_it != std::end(lists) ; ++list_it)
+    {
+      for(auto rule_it = (*list_it)->begin() ; rule_it != (*list_it)->end() ;
+          ++rule_it)
+      {
+        std::string rule_info(rule_it->info(false));
+
+        // separate rules, otherwise concatenations could collide
+        rule_info += '\n';
+
+        for(auto c_it = rule_info.begin() ; c_it != rule_info.end() ; ++c_it)
+        {
+          fingerprint_ ^= static_cast<unsigned char> (*c_it);
+          fingerprint_ *= fnv_prime;
+        }
+      }
+    }
+
+    // activity of the scheduled rules
+    for(auto active_it = active_.begin() ; active_it != active_.end() ; ++active_it)
+    {
+      fingerprint_ ^= *active_it ? '1' : '0';
+      fingerprint_ *= fnv_prime;
+    }
+
+    fingerprint_valid_ = true;
+  }
+
+  return fingerprint_;
 }
 
 
@@ -82,6 +482,11 @@ void rule_set::save() const
   // output file stream is valid (no errors, correct permissions)
   if(out.good())
   {
+    for(auto pin_it = pins_.begin() ; pin_it != pins_.end() ; ++pin_it)
+    {
+      out << *(pin_it);
+    }
+
     // for every rule
     for(auto rule_it = rules_.begin() ; rule_it != rules_.end() ; ++rule_it)
     {
@@ -108,49 +513,19 @@ void rule_set::load(std::string const& path)
     path_ = path;
 
     // clear the current rule set
-    rules_.clear();
+    clear();
 
 
     // input line
     std::string line;
 
-    // rule description
-    std::array<unsigned short,DESCRIPTOR_SIZE> info;
-
-    // rule permission
-    bool permission;
-
-    // function checks if character must be removed before parsing the rule
-    std::function<bool(char)>valid_rule_info([](char c)
-    {
-      // character is not a digit nor a space
-      return !isdigit(c) && c != ' ';
-    });
-   
-
     // for every line in file
     while(getline(in,line))
     {
-      // erase every character except digits and spaces
-      line.erase(std::remove_if(line.begin(),line.end(),valid_rule_info),
-                 line.end()                                              );
-
-      // create string stream from the current line
-      std::stringstream rule_string(line);
-
-      // for every information type
-      for(unsigned short index = BUS ; index != UNDEFINED ; ++index)
-      {
-        // stream from string to buffer
-        rule_string >> info[index];
-      }
-
-      // get rule permission
-      rule_string >> permission;
+      rule line_rule(line);
 
-
-      // memorize current rule
-      rules_.push_back(rule(descriptor(info),permission));
+      // memorize current rule, empty and damaged lines are skipped
+      if(line_rule.valid()) push_back(line_rule);
     }
 
     // close input file stream
@@ -162,12 +537,24 @@ void rule_set::load(std::string const& path)
 // write rule information in data stream
 QDataStream & operator << (QDataStream & out_stream,rule_set const& rule_set)
 {
+  std::vector<std::uint64_t> rule_hits(rule_set.hits());
+
+  std::size_t position = 0;
+
+  // pins aren't counted
+  for(auto pin_it  = rule_set.pins_.begin() ;
+           pin_it != rule_set.pins_.end()   ; ++pin_it)
+  {
+    out_stream << pin_it->info(false).c_str();
+  }
+
   // for every rule
   for(auto rule_it  = rule_set.rules_.begin() ;
-           rule_it != rule_set.rules_.end()   ; ++rule_it)
+           rule_it != rule_set.rules_.end()   ; ++rule_it , ++position)
   {
-    // write rule unreadable (better parsing)
-    out_stream << rule_it->info(false).c_str();
+    // write rule unreadable (better parsing) followed by its hits
+    out_stream << (rule_it->info(false) + " " +
+                   std::to_string(rule_hits[position])).c_str();
   }
 
   return out_stream;
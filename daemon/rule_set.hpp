@@ -2,10 +2,18 @@
 #define GEMINI_RULE_SET
 
 
+#include <atomic>
+#include <cstdint>
+#include <ctime>
 #include <list>
+#include <mutex>
 #include <string>
+#include <unordered_map>
+#include <vector>
 
-#include <rule.hpp>
+#include <rule_index.hpp>
+#include <rule_optimizer.hpp>
+#include <timer_wheel.hpp>
 
 namespace gemini
 {
@@ -21,10 +29,62 @@ class rule_set
 
   bool permission(descriptor const& desc);
 
+  // position is the deciding rule (pins not counted), rule_index::NO_MATCH
+  // if no rule matches
+  bool permission(descriptor const& desc,std::size_t & position);
+
+  // decision of the rule at position repeated from a cache, counted as hit
+  void hit(std::size_t position);
+
+  // decision of a rule pinning the device fingerprint, checked ahead of the
+  // other rules, returns false if no rule pins it
+  bool pinned(std::uint64_t fingerprint,bool & permission) const;
+
+  // position of the rule deciding the interface in the saved rule set (pins
+  // first), rule_index::NO_MATCH if no rule matches, no hit is counted
+  std::size_t deciding_rule(descriptor const& desc,std::uint64_t fingerprint);
+
+  // permission of a device interface with pins, without hits and metrics
+  // (simulations, safe from every thread), position as deciding_rule
+  bool decide(descriptor const& desc,std::uint64_t fingerprint,
+              std::size_t & position);
+
+  // decide without the index, a linear scan of the rules with the activity
+  // of every schedule at the latest advance, the reference the index and the
+  // rule set transformations are verified against (gemini_verify)
+  bool reference_permission(descriptor const& desc,std::uint64_t fingerprint,
+                            std::size_t & position) const;
+
+  // pinning rules are kept ahead of the other rules
   void push_back(rule const& r);
   void push_front(rule const& r);
   void clear();
 
+  // replace the rules by an equivalent minimal rule set
+  void optimize(std::vector<rule_finding> & findings);
+
+  std::size_t size() const;
+
+  // decisions of every rule since the rule set was modified
+  std::vector<std::uint64_t> const hits() const;
+
+  // evaluate hot rules ahead of colder rules they don't overlap with, only
+  // the index is reordered (decisions, rule positions, the saved rule set
+  // and its fingerprint stay the same), returns false if the order didn't
+  // change
+  bool reorder();
+
+  // activates and deactivates scheduled rules at time (transitions are timed
+  // by a timer wheel), rules changing their activity are appended to toggled
+  void advance(std::time_t time,std::vector<rule> & toggled);
+
+  // any rule matches on the field, expensive fields (serial) are read only
+  // if a rule needs them
+  bool uses(unsigned short index) const;
+
+  // hash over every rule, changes whenever the rule set changes
+  std::uint64_t fingerprint() const;
+
   void path(std::string const& new_path);
   std::string const path() const;
 
@@ -36,9 +96,43 @@ class rule_set
 
   private :
 
+  // compile the index after a modification
+  void compile();
+
+  void used(rule const& r);
+
+
   std::list<rule> rules_;
 
+  // pinning rules and the decision of every pinned fingerprint
+  std::list<rule>                        pins_;
+  std::unordered_map<std::uint64_t,bool> pinned_;
+
   std::string path_;
+
+  // bit per field any rule matches on
+  std::uint32_t fields_;
+
+  // activity of every rule at schedule_time_, transitions of scheduled rules
+  // by position (timed again after modification)
+  std::vector<bool> active_;
+  std::time_t       schedule_time_;
+  timer_wheel       wheel_;
+  bool              schedule_valid_;
+
+  // evaluation order of the rules (positions) set by reorder, the saved
+  // order if empty
+  std::vector<std::size_t> order_;
+
+  // built by the first decision after modification, bus workers decide
+  // concurrently
+  rule_index        index_;
+  std::atomic<bool> index_valid_;
+  std::mutex        index_mutex_;
+
+  // cached fingerprint, recalculated after modification
+  mutable std::uint64_t fingerprint_;
+  mutable bool          fingerprint_valid_;
 };
 
 }
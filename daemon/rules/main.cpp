@@ -0,0 +1,92 @@
+// std
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+// gemini
+#include <rule_set.hpp>
+
+
+// analyze a rule set offline, write the minimized equivalent rule set
+int main(int argc,char * argv[])
+{
+  std::string input_path,
+              output_path;
+
+  bool        quiet = false;
+
+  for(int arg = 1 ; arg < argc ; ++arg)
+  {
+    if(std::strcmp(argv[arg],"--output") == 0 && arg + 1 < argc)
+    {
+      output_path = argv[++arg];
+    }
+
+    else if(std::strcmp(argv[arg],"--quiet") == 0)
+    {
+      quiet = true;
+    }
+
+    else if(argv[arg][0] != '-' && input_path.empty())
+    {
+      input_path = argv[arg];
+    }
+
+    else
+    {
+      input_path.clear();
+
+      break;
+    }
+  }
+
+  if(input_path.empty())
+  {
+    std::cerr << "usage: gemini_rules [--output <file>] [--quiet] <rules>"
+              << std::endl;
+
+    return EXIT_FAILURE;
+  }
+
+  if(!std::ifstream(input_path).is_open())
+  {
+    std::cerr << "can't read " << input_path << std::endl;
+
+    return EXIT_FAILURE;
+  }
+
+
+  gemini::rule_set rules(input_path);
+
+  rules.load(input_path);
+
+  const std::size_t rule_number = rules.size();
+
+  std::vector<gemini::rule_finding> findings;
+
+  rules.optimize(findings);
+
+
+  if(!quiet)
+  {
+    for(auto finding_it = findings.begin() ; finding_it != findings.end() ;
+        ++finding_it)
+    {
+      std::cout << finding_it->info() << std::endl;
+    }
+  }
+
+  std::cout << rule_number << " rules, " << rules.size() << " after optimization"
+            << std::endl;
+
+
+  // the minimized rule set decides every interface like the analyzed one
+  if(!output_path.empty())
+  {
+    rules.path(output_path);
+    rules.save();
+  }
+
+
+  return EXIT_SUCCESS;
+}
@@ -1,19 +1,44 @@
 #include <server.hpp>
+#include <metrics.hpp>
+#include <trace_buffer.hpp>
 #include <iostream>
+#include <set>
+#include <tuple>
 
 namespace gemini
 {
   const std::string server::DEFAULT_RULE_SET("default.rules");
 
-  server::server() :
+  const std::size_t server::DEVICE_COST_NUMBER = 32;
+
+  const unsigned int server::REORDER_PASSES = 1500;
+
+  server::server(std::unique_ptr<device_backend> backend,
+                 std::uint64_t history_budget) :
   QObject(),
   update_timer_frequency_(200),
   update_counter_(0),
-  update_frequency_(5)
+  update_frequency_(5),
+  reorder_rules_(false),
+  reorder_counter_(0),
+  control_(std::move(backend),rule_set::gemini_home_path() + "gemini.state",
+           rule_set::gemini_home_path() + "journal",
+           rule_set::gemini_home_path() + "history",history_budget)
   {
     intf_info_server    = new QLocalServer(this);
     rule_set_server     = new QLocalServer(this);
+    latency_server      = new QLocalServer(this);
+    metrics_server      = new QLocalServer(this);
+    trace_server        = new QLocalServer(this);
+    device_cost_server  = new QLocalServer(this);
+    history_server      = new QLocalServer(this);
     rule_update_socket_ = new QLocalSocket(this);
+
+    uevent_notifier_    = uevents_.valid() ?
+
+                          new QSocketNotifier(uevents_.socket(),
+                                              QSocketNotifier::Read,this) :
+                          nullptr;
   }
 
   server::~server()
@@ -21,10 +46,29 @@ namespace gemini
     // stop listening for connections
     intf_info_server->close();
     rule_set_server->close();
+    latency_server->close();
+    metrics_server->close();
+    trace_server->close();
+    device_cost_server->close();
+    history_server->close();
 
     delete intf_info_server;
     delete rule_set_server;
+    delete latency_server;
+    delete metrics_server;
+    delete trace_server;
+    delete device_cost_server;
+    delete history_server;
     delete rule_update_socket_;
+    delete uevent_notifier_;
+  }
+
+
+  void server::enforce()
+  {
+    control_.rule_set_.load(read_config());
+
+    control_.initial_sweep();
   }
 
 
@@ -32,16 +76,27 @@ namespace gemini
   {
     bool valid_start = true;
 
-    control_.rule_set_.load(read_config());
-
 
     // register handle for rule updates
     connect(rule_update_socket_,SIGNAL(readyRead()),
             this               ,SLOT(process_request()));
 
+    // register handle for kernel uevents, without netlink the update passes
+    // find bound drivers
+    if(uevent_notifier_)
+    {
+      connect(uevent_notifier_,SIGNAL(activated(int)),
+              this            ,SLOT(process_uevents()));
+    }
+
     // remove old server file
     QLocalServer::removeServer("gemini_interface_info");
     QLocalServer::removeServer("gemini_rule_set");
+    QLocalServer::removeServer("gemini_latency");
+    QLocalServer::removeServer("gemini_metrics");
+    QLocalServer::removeServer("gemini_trace");
+    QLocalServer::removeServer("gemini_device_cost");
+    QLocalServer::removeServer("gemini_history");
 
     // register handle of interface info requests
     connect(intf_info_server,SIGNAL(newConnection()),
@@ -51,6 +106,26 @@ namespace gemini
     connect(rule_set_server,SIGNAL(newConnection()),
             this,            SLOT(send_rule_set()));
 
+    // register handle of latency requests
+    connect(latency_server,SIGNAL(newConnection()),
+            this,          SLOT(send_latency_info()));
+
+    // register handle of metrics requests
+    connect(metrics_server,SIGNAL(newConnection()),
+            this,          SLOT(send_metrics()));
+
+    // register handle of trace requests
+    connect(trace_server,SIGNAL(newConnection()),
+            this,        SLOT(send_trace()));
+
+    // register handle of device cost requests
+    connect(device_cost_server,SIGNAL(newConnection()),
+            this,              SLOT(send_device_cost()));
+
+    // register handle of presence history requests
+    connect(history_server,SIGNAL(newConnection()),
+            this,          SLOT(accept_history_request()));
+
 
     // server doesn't listen connections
     if(!intf_info_server->listen("gemini_interface_info"))
@@ -63,6 +138,31 @@ namespace gemini
       valid_start = false;
     }
 
+    else if(!latency_server->listen("gemini_latency"))
+    {
+      valid_start = false;
+    }
+
+    else if(!metrics_server->listen("gemini_metrics"))
+    {
+      valid_start = false;
+    }
+
+    else if(!trace_server->listen("gemini_trace"))
+    {
+      valid_start = false;
+    }
+
+    else if(!device_cost_server->listen("gemini_device_cost"))
+    {
+      valid_start = false;
+    }
+
+    else if(!history_server->listen("gemini_history"))
+    {
+      valid_start = false;
+    }
+
     // correct initialization
     else
     {
@@ -79,6 +179,8 @@ namespace gemini
 
   void server::send_intf_info() const
   {
+    trace_scope ipc_trace("send_intf_info");
+
     std::vector<std::string> interface_strings = control_.interface_info();
 
     QByteArray block;
@@ -111,6 +213,10 @@ namespace gemini
             client_connection , SLOT(deleteLater())    );
 
 
+    metrics().ipc_connections.add();
+    metrics().ipc_bytes_sent.add(block.size());
+
+
     client_connection->write(block);
     client_connection->flush();
     client_connection->disconnectFromServer();
@@ -118,6 +224,8 @@ namespace gemini
 
   void server::send_rule_set() const
   {
+    trace_scope ipc_trace("send_rule_set");
+
     QByteArray block;
     QDataStream out(&block,QIODevice::WriteOnly);
 
@@ -146,6 +254,249 @@ namespace gemini
             client_connection , SLOT(deleteLater())    );
 
 
+    metrics().ipc_connections.add();
+    metrics().ipc_bytes_sent.add(block.size());
+
+
+    client_connection->write(block);
+    client_connection->flush();
+    client_connection->disconnectFromServer();
+  }
+
+
+  void server::send_latency_info() const
+  {
+    trace_scope ipc_trace("send_latency_info");
+
+    std::vector<std::string> latency_strings = control_.latency_info();
+
+    QByteArray block;
+    QDataStream out(&block,QIODevice::WriteOnly);
+
+    out.setVersion(QDataStream::Qt_5_0);
+
+    // mark the beginning of the block
+    out << (quint16)0;
+
+    // stream latency histogram strings in block
+    for(unsigned short index = 0 ; index < latency_strings.size() ; ++index)
+    {
+      out << latency_strings[index].c_str();
+    }
+
+    // set index back to the beginning of the block
+    out.device()->seek(0);
+    // stream block size in
+    out << (quint16)(block.size() - sizeof(quint16));
+
+
+    // get actual connection
+    QLocalSocket * client_connection =
+
+    latency_server->nextPendingConnection();
+
+    // register destruction of connection after usage
+    connect(client_connection , SIGNAL(disconnected()),
+            client_connection , SLOT(deleteLater())    );
+
+
+    metrics().ipc_connections.add();
+    metrics().ipc_bytes_sent.add(block.size());
+
+
+    client_connection->write(block);
+    client_connection->flush();
+    client_connection->disconnectFromServer();
+  }
+
+
+  void server::send_device_cost() const
+  {
+    trace_scope ipc_trace("send_device_cost");
+
+    std::vector<std::string> cost_strings =
+
+    control_.device_cost_info(DEVICE_COST_NUMBER);
+
+    QByteArray block;
+    QDataStream out(&block,QIODevice::WriteOnly);
+
+    out.setVersion(QDataStream::Qt_5_0);
+
+    // mark the beginning of the block
+    out << (quint16)0;
+
+    // stream device cost strings in block
+    for(unsigned short index = 0 ; index < cost_strings.size() ; ++index)
+    {
+      out << cost_strings[index].c_str();
+    }
+
+    // set index back to the beginning of the block
+    out.device()->seek(0);
+    // stream block size in
+    out << (quint16)(block.size() - sizeof(quint16));
+
+
+    // get actual connection
+    QLocalSocket * client_connection =
+
+    device_cost_server->nextPendingConnection();
+
+    // register destruction of connection after usage
+    connect(client_connection , SIGNAL(disconnected()),
+            client_connection , SLOT(deleteLater())    );
+
+
+    metrics().ipc_connections.add();
+    metrics().ipc_bytes_sent.add(block.size());
+
+
+    client_connection->write(block);
+    client_connection->flush();
+    client_connection->disconnectFromServer();
+  }
+
+
+  // prometheus text format, plain text without block size for scrapers
+  void server::send_metrics() const
+  {
+    trace_scope ipc_trace("send_metrics");
+
+    std::string exposition = metrics().exposition();
+
+    QByteArray block(exposition.c_str(),exposition.size());
+
+
+    // get actual connection
+    QLocalSocket * client_connection =
+
+    metrics_server->nextPendingConnection();
+
+    // register destruction of connection after usage
+    connect(client_connection , SIGNAL(disconnected()),
+            client_connection , SLOT(deleteLater())    );
+
+
+    metrics().ipc_connections.add();
+    metrics().ipc_bytes_sent.add(block.size());
+
+
+    client_connection->write(block);
+    client_connection->flush();
+    client_connection->disconnectFromServer();
+  }
+
+
+  // chrome trace event json, plain text like the metrics
+  void server::send_trace() const
+  {
+    std::string trace_json = trace_buffer::instance().chrome_json();
+
+    QByteArray block(trace_json.c_str(),trace_json.size());
+
+
+    // get actual connection
+    QLocalSocket * client_connection =
+
+    trace_server->nextPendingConnection();
+
+    // register destruction of connection after usage
+    connect(client_connection , SIGNAL(disconnected()),
+            client_connection , SLOT(deleteLater())    );
+
+
+    metrics().ipc_connections.add();
+    metrics().ipc_bytes_sent.add(block.size());
+
+
+    client_connection->write(block);
+    client_connection->flush();
+    client_connection->disconnectFromServer();
+  }
+
+
+  // the client sends its query first, the answer follows when it arrived
+  void server::accept_history_request()
+  {
+    QLocalSocket * client_connection = history_server->nextPendingConnection();
+
+    // register destruction of connection after usage
+    connect(client_connection , SIGNAL(disconnected()),
+            client_connection , SLOT(deleteLater())    );
+
+    connect(client_connection , SIGNAL(readyRead()),
+            this              , SLOT(send_history())   );
+
+
+    metrics().ipc_connections.add();
+  }
+
+
+  // query line "<from> <to> [<fingerprint>|<vendor id>:<product id>]" (times
+  // in seconds since the epoch, ids in hexadecimal), csv answer without block
+  // size like the metrics
+  void server::send_history()
+  {
+    trace_scope ipc_trace("send_history");
+
+    QLocalSocket * client_connection = qobject_cast<QLocalSocket *> (sender());
+
+    if(!client_connection || !client_connection->canReadLine()) return;
+
+
+    QByteArray request = client_connection->readLine();
+
+    metrics().ipc_bytes_received.add(request.size());
+
+    QList<QByteArray> fields = request.simplified().split(' ');
+
+    presence_query query = {0,0,0,0,0};
+
+    bool valid = fields.size() == 2 || fields.size() == 3,
+         number;
+
+    if(valid)
+    {
+      query.from = fields[0].toLongLong(&valid);
+      query.to   = fields[1].toLongLong(&number);
+
+      valid = valid && number && query.from <= query.to;
+    }
+
+    if(valid && fields.size() == 3)
+    {
+      QList<QByteArray> ids = fields[2].split(':');
+
+      if(ids.size() == 2)
+      {
+        query.vendor_id  = ids[0].toUShort(&valid,16);
+        query.product_id = ids[1].toUShort(&number,16);
+
+        valid = valid && number;
+      }
+
+      else query.fingerprint = fields[2].toULongLong(&valid,16);
+    }
+
+
+    std::string answer("invalid query\n");
+
+    if(valid)
+    {
+      std::vector<presence_interval> intervals;
+
+      control_.presence_.query(query,intervals);
+
+      answer = presence_history::csv(intervals);
+    }
+
+    QByteArray block(answer.c_str(),answer.size());
+
+
+    metrics().ipc_bytes_sent.add(block.size());
+
+
     client_connection->write(block);
     client_connection->flush();
     client_connection->disconnectFromServer();
@@ -154,6 +505,8 @@ namespace gemini
 
   void server::process_request()
   {
+    trace_scope ipc_trace("process_request");
+
     quint16 block_size = 0 , request_type = UNDEFINED_REQUEST;
 
     QDataStream in(rule_update_socket_);
@@ -165,6 +518,8 @@ namespace gemini
 
        2 * static_cast<unsigned short> (sizeof(quint16)))
     {
+      metrics().ipc_bytes_received.add(rule_update_socket_->bytesAvailable());
+
       in >> block_size;
       in >> request_type;
 
@@ -175,7 +530,8 @@ namespace gemini
 
       switch(request_type)
       {
-        case UPLOAD_RULE_SET :
+        case UPLOAD_RULE_SET           :
+        case UPLOAD_OPTIMIZED_RULE_SET :
 
           control_.rule_set_.clear();
 
@@ -183,7 +539,17 @@ namespace gemini
           {
             in >> info_buffer;
 
-            control_.rule_set_.push_back(rule(info_buffer));
+            rule uploaded_rule(info_buffer);
+
+            if(uploaded_rule.valid()) control_.rule_set_.push_back(uploaded_rule);
+          }
+
+          // equivalent rule set without shadowed and redundant rules
+          if(request_type == UPLOAD_OPTIMIZED_RULE_SET)
+          {
+            std::vector<rule_finding> findings;
+
+            control_.rule_set_.optimize(findings);
           }
 
 
@@ -220,6 +586,40 @@ namespace gemini
   }
 
 
+  void server::reorder_rules(bool reorder)
+  {
+    reorder_rules_ = reorder;
+  }
+
+  void server::process_uevents()
+  {
+    trace_scope uevent_trace("process_uevents");
+
+    std::vector<uevent> events;
+
+    uevents_.receive(events);
+
+    metrics().uevents.add(events.size());
+
+
+    // add and bind of an interface arrive together, enforce it once
+    std::set<std::tuple<std::uint8_t,std::vector<std::uint8_t>,std::uint8_t> >
+    interfaces;
+
+    for(auto event_it = events.begin() ; event_it != events.end() ; ++event_it)
+    {
+      interfaces.insert(std::make_tuple(event_it->bus,event_it->ports,
+                                        event_it->interface_number));
+    }
+
+    for(auto intf_it = interfaces.begin() ; intf_it != interfaces.end() ; ++intf_it)
+    {
+      control_.enforce_interface(std::get<0>(*intf_it),std::get<1>(*intf_it),
+                                 std::get<2>(*intf_it));
+    }
+  }
+
+
   void server::update()
   {
     bool client_update = false;
@@ -236,8 +636,26 @@ namespace gemini
     // load rule updates
     rule_update_socket_->connectToServer("gemini_rule_update");
 
+    // scheduled rules change before the pass enforces them
+    control_.schedule(std::time(nullptr));
+
     control_.enforce_rule_set(client_update);
 
+    // hot rules evaluated first, decisions and the rules file stay the same
+    if(reorder_rules_ && ++reorder_counter_ >= REORDER_PASSES)
+    {
+      reorder_counter_ = 0;
+
+      control_.rule_set_.reorder();
+    }
+
+    // dump requested by a signal
+    if(trace_buffer::instance().dump_requested())
+    {
+      trace_buffer::instance().dump(rule_set::gemini_home_path()
+                                    + "gemini.trace.json");
+    }
+
     QTimer::singleShot(update_timer_frequency_,this,SLOT(update()));
 
     ++update_counter_;
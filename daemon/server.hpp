@@ -4,6 +4,7 @@
 #include <QtNetwork>
 
 #include <control.hpp>
+#include <uevent_listener.hpp>
 
 
 namespace gemini
@@ -14,18 +15,35 @@ namespace gemini
 
     public :
 
-    server();
+    // without backend real usb devices (libusb) are controlled, history
+    // budget is the disk budget of the presence history in bytes
+    server(std::unique_ptr<device_backend> backend = nullptr,
+           std::uint64_t history_budget = presence_history::DEFAULT_BUDGET);
     ~server();
 
+    // load rule set and enforce it before ipc and event loop are set up
+    void enforce();
+
     bool start();
 
+    // evaluate hot rules ahead every REORDER_PASSES passes (in the index,
+    // the rules file is kept)
+    void reorder_rules(bool reorder);
+
 
     private slots :
 
     void update();
     void send_intf_info() const;
     void send_rule_set() const;
+    void send_latency_info() const;
+    void send_metrics() const;
+    void send_trace() const;
+    void send_device_cost() const;
+    void accept_history_request();
+    void send_history();
     void process_request();
+    void process_uevents();
 
 
     private :
@@ -37,17 +55,32 @@ namespace gemini
 
     static const std::string DEFAULT_RULE_SET;
 
+    // devices listed by device cost requests
+    static const std::size_t DEVICE_COST_NUMBER;
+
+    // passes between two reorders of the rule set
+    static const unsigned int REORDER_PASSES;
+
     enum request_type{UPLOAD_RULE_SET,LOAD_RULE_SET,SAVE_RULE_SET,
-                      UNDEFINED_REQUEST                           };
+                      UPLOAD_OPTIMIZED_RULE_SET,UNDEFINED_REQUEST };
 
 
     // server
     QLocalServer * intf_info_server,
-                 * rule_set_server;
+                 * rule_set_server,
+                 * latency_server,
+                 * metrics_server,
+                 * trace_server,
+                 * device_cost_server,
+                 * history_server;
 
     // sockets
     QLocalSocket * rule_update_socket_;
 
+    // kernel driver binds between update passes
+    uevent_listener   uevents_;
+    QSocketNotifier * uevent_notifier_;
+
     // timer update parameter
     unsigned short update_timer_frequency_;
 
@@ -55,6 +88,10 @@ namespace gemini
     unsigned short update_counter_,
                    update_frequency_;
 
+    // rule reorder parameter
+    bool           reorder_rules_;
+    unsigned int   reorder_counter_;
+
     // gemini control
     control control_;
   };
@@ -0,0 +1,524 @@
+// std
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <set>
+#include <sstream>
+#include <thread>
+#include <tuple>
+
+// gemini
+#include <rule_set.hpp>
+#include <usb_trace.hpp>
+
+
+namespace
+{
+  // interface setting of a device in a snapshot, line is the line of text
+  // snapshots and the device of traces
+  struct snapshot_tuple
+  {
+    gemini::descriptor desc;
+    std::uint64_t      fingerprint;
+    std::uint32_t      source,
+                       line;
+  };
+
+  // decision and deciding rule of every tuple under one rule set
+  struct policy_result
+  {
+    std::vector<std::uint32_t> rules;
+    std::vector<char>          permissions;
+
+    std::size_t                prohibited;
+    double                     seconds;
+  };
+
+  const std::uint32_t NO_RULE = 0xffffffff;
+
+
+  // one interface setting per line, fields in descriptor order and an
+  // optional fingerprint ("1 3 0x046d 0xc52b 3 1 2 0 0 0x8f3a51c0d2e47b16"),
+  // fields are decimal or hexadecimal with "0x", '#' starts a comment
+  bool read_text_snapshot(std::string const& path,std::uint32_t source,
+                          std::vector<snapshot_tuple> & tuples)
+  {
+    std::ifstream in(path);
+
+    if(!in.is_open()) return false;
+
+
+    std::string   line;
+    std::uint32_t line_number = 0;
+
+    while(std::getline(in,line))
+    {
+      ++line_number;
+
+      const char * position = line.c_str();
+
+      snapshot_tuple tuple = {gemini::descriptor(),0,source,line_number};
+
+      unsigned short index = BUS;
+
+      for( ; index != UNDEFINED ; ++index)
+      {
+        char * end;
+
+        while(std::isspace(static_cast<unsigned char> (*position))) ++position;
+
+        // hexadecimal with "0x", decimal otherwise ("08" isn't octal)
+        int base = position[0] == '0' &&
+                   (position[1] == 'x' || position[1] == 'X') ? 16 : 10;
+
+        tuple.desc[index] = std::strtoul(position,&end,base);
+
+        if(end == position) break;
+
+        position = end;
+      }
+
+      // empty, comment or damaged lines
+      if(index != UNDEFINED) continue;
+
+
+      char * end;
+
+      tuple.fingerprint = std::strtoull(position,&end,16);
+
+      tuples.push_back(tuple);
+    }
+
+    return true;
+  }
+
+  // every device of a trace recorded by the daemon (--record), devices seen
+  // in several passes count once
+  bool read_trace_snapshot(std::string const& path,std::uint32_t source,
+                           std::vector<snapshot_tuple> & tuples)
+  {
+    gemini::usb_trace trace;
+
+    if(!trace.open(path)) return false;
+
+
+    std::vector<std::unique_ptr<gemini::simulated_device> > devices;
+    std::vector<unsigned short>                             decoded;
+
+    std::set<std::tuple<std::uint8_t,std::uint8_t,std::uint64_t> > seen;
+
+    std::uint32_t device_number = 0;
+
+    auto harvest = [&]()
+    {
+      for(std::size_t index = 0 ; index < devices.size() ; ++index)
+      {
+        // device and config descriptor were read
+        if(decoded[index] != 3) continue;
+
+        gemini::simulated_device & device = *devices[index];
+
+        device.wire();
+
+        std::uint64_t fingerprint =
+
+        gemini::descriptor::fingerprint(device.device_descriptor,
+                                        device.config_descriptor);
+
+        if(!seen.insert(std::make_tuple(device.bus,device.port,
+                                        fingerprint)).second) continue;
+
+        ++device_number;
+
+
+        gemini::descriptor desc;
+
+        desc.read_device_address(device.bus,device.port);
+        desc.read_device_descriptor(device.device_descriptor);
+
+        std::uint8_t serial = device.device_descriptor.iSerialNumber;
+
+        if(serial != 0 && serial < device.strings.size() &&
+           !device.strings[serial].empty())
+        {
+          desc.read_serial(device.strings[serial]);
+        }
+
+        for(auto intf_it  = device.settings.begin() ;
+                 intf_it != device.settings.end()   ; ++intf_it)
+        {
+          for(auto setting_it = intf_it->begin() ; setting_it != intf_it->end() ;
+              ++setting_it)
+          {
+            desc.read_interface_descriptor(*setting_it);
+
+            snapshot_tuple tuple = {desc,fingerprint,source,device_number};
+
+            tuples.push_back(tuple);
+          }
+        }
+      }
+
+      devices.clear();
+      decoded.clear();
+    };
+
+
+    gemini::trace_record record;
+
+    while(trace.read(record))
+    {
+      if(record.type == gemini::TRACE_ENUMERATE)
+      {
+        harvest();
+
+        for(std::int32_t device = 0 ; device < record.result ; ++device)
+        {
+          devices.push_back(std::unique_ptr<gemini::simulated_device>
+                            (new gemini::simulated_device));
+          decoded.push_back(0);
+        }
+
+        continue;
+      }
+
+      if(record.device >= devices.size()) continue;
+
+      gemini::simulated_device & device = *devices[record.device];
+
+      const bool success = record.result == LIBUSB_SUCCESS;
+
+      if(record.type == gemini::TRACE_DEVICE && success &&
+         gemini::usb_trace::decode_device(record.payload,device))
+      {
+        decoded[record.device] |= 1;
+      }
+
+      else if(record.type == gemini::TRACE_CONFIG && success &&
+              gemini::usb_trace::decode_config(record.payload,device))
+      {
+        decoded[record.device] |= 2;
+      }
+
+      else if(record.type == gemini::TRACE_STRING && record.result > 0 &&
+              record.argument > 0)
+      {
+        if(device.strings.size() <= static_cast<std::size_t> (record.argument))
+        {
+          device.strings.resize(record.argument + 1);
+        }
+
+        device.strings[record.argument] = record.payload;
+      }
+    }
+
+    harvest();
+
+    trace.close();
+
+
+    return true;
+  }
+
+
+  // decisions of the rule set on every tuple, the tuples are split into one
+  // contiguous chunk per thread
+  void evaluate(gemini::rule_set                  & rules,
+                std::vector<snapshot_tuple> const& tuples,
+                unsigned int                       thread_number,
+                policy_result                    & result)
+  {
+    result.rules.assign(tuples.size(),NO_RULE);
+    result.permissions.assign(tuples.size(),1);
+
+    // compile the index before the threads share it
+    std::size_t position;
+
+    rules.decide(gemini::descriptor(),0,position);
+
+
+    std::atomic<std::size_t> prohibited(0);
+
+    auto start = std::chrono::steady_clock::now();
+
+    std::vector<std::thread> workers;
+
+    const std::size_t chunk = (tuples.size() + thread_number - 1) / thread_number;
+
+    for(unsigned int worker = 0 ; worker < thread_number ; ++worker)
+    {
+      workers.push_back(std::thread([&,worker]()
+      {
+        std::size_t first          = worker * chunk,
+                    last           = std::min(tuples.size(),first + chunk),
+                    own_prohibited = 0;
+
+        for(std::size_t index = first ; index < last ; ++index)
+        {
+          std::size_t rule_position;
+
+          bool permission = rules.decide(tuples[index].desc,
+                                         tuples[index].fingerprint,rule_position);
+
+          result.permissions[index] = permission;
+          result.rules[index]       =
+
+          rule_position == gemini::rule_index::NO_MATCH ? NO_RULE : rule_position;
+
+          if(!permission) ++own_prohibited;
+        }
+
+        prohibited += own_prohibited;
+      }));
+    }
+
+    for(auto worker_it = workers.begin() ; worker_it != workers.end() ; ++worker_it)
+    {
+      worker_it->join();
+    }
+
+    result.seconds    = std::chrono::duration<double>
+                        (std::chrono::steady_clock::now() - start).count();
+    result.prohibited = prohibited;
+  }
+
+
+  // used fields as keyword pairs, usable in rules
+  std::string const tuple_info(snapshot_tuple const& tuple)
+  {
+    std::string info;
+
+    for(unsigned short index = BUS ; index != UNDEFINED ; ++index)
+    {
+      if(tuple.desc[index] == MASKED) continue;
+
+      char value[16];
+
+      std::snprintf(value,sizeof(value),
+                    index == VENDOR_ID || index == PRODUCT_ID ? "0x%04x" : "%u",
+                    tuple.desc[index]);
+
+      info += std::string(info.empty() ? "" : " ")
+            + gemini::DESCRIPTOR_FIELDS[index].name + " " + value;
+    }
+
+    if(tuple.fingerprint != 0)
+    {
+      char fingerprint[40];
+
+      std::snprintf(fingerprint,sizeof(fingerprint)," FINGERPRINT 0x%016llx",
+                    static_cast<unsigned long long> (tuple.fingerprint));
+
+      info += fingerprint;
+    }
+
+    return info;
+  }
+
+  std::string const rule_info(std::uint32_t rule)
+  {
+    return rule == NO_RULE ? std::string("-") : std::to_string(rule);
+  }
+}
+
+
+// evaluate rule sets against snapshots of device populations, decisions of
+// every further rule set are compared with the first one
+int main(int argc,char * argv[])
+{
+  std::vector<std::string> rule_paths,
+                           snapshot_paths;
+
+  unsigned int thread_number = std::max(1U,std::thread::hardware_concurrency()),
+               limit         = 20;
+
+  std::time_t  time          = 0;
+
+  bool         valid         = true;
+
+  for(int arg = 1 ; arg < argc && valid ; ++arg)
+  {
+    bool value = arg + 1 < argc;
+
+    if(std::strcmp(argv[arg],"--rules") == 0 && value)
+    {
+      rule_paths.push_back(argv[++arg]);
+    }
+
+    else if(std::strcmp(argv[arg],"--threads") == 0 && value)
+    {
+      thread_number = std::strtoul(argv[++arg],nullptr,10);
+
+      valid = thread_number > 0;
+    }
+
+    else if(std::strcmp(argv[arg],"--limit") == 0 && value)
+    {
+      limit = std::strtoul(argv[++arg],nullptr,10);
+    }
+
+    else if(std::strcmp(argv[arg],"--at") == 0 && value)
+    {
+      time = std::strtoll(argv[++arg],nullptr,10);
+    }
+
+    else if(argv[arg][0] != '-')
+    {
+      snapshot_paths.push_back(argv[arg]);
+    }
+
+    else valid = false;
+  }
+
+  if(!valid || rule_paths.empty() || snapshot_paths.empty())
+  {
+    std::cerr << "usage: gemini_simulate --rules <old> [--rules <new>]..."
+              << " [--threads <n>] [--limit <n>]" << std::endl
+              << "                       [--at <seconds since epoch>]"
+              << " <snapshot|trace>..." << std::endl;
+
+    return EXIT_FAILURE;
+  }
+
+
+  // snapshots are read in parallel, traces by their magic
+  std::vector<std::vector<snapshot_tuple> > snapshot_tuples(snapshot_paths.size());
+  std::vector<char>                         read(snapshot_paths.size(),0);
+
+  {
+    std::atomic<std::size_t> next(0);
+
+    std::vector<std::thread> readers;
+
+    const std::size_t reader_number =
+
+    std::min<std::size_t> (thread_number,snapshot_paths.size());
+
+    for(std::size_t reader = 0 ; reader < reader_number ; ++reader)
+    {
+      readers.push_back(std::thread([&]()
+      {
+        for(std::size_t source = next++ ; source < snapshot_paths.size() ;
+            source = next++)
+        {
+          std::vector<snapshot_tuple> & source_tuples = snapshot_tuples[source];
+
+          read[source] =
+
+          read_trace_snapshot(snapshot_paths[source],source,source_tuples) ||
+          read_text_snapshot(snapshot_paths[source],source,source_tuples);
+        }
+      }));
+    }
+
+    for(auto reader_it = readers.begin() ; reader_it != readers.end() ; ++reader_it)
+    {
+      reader_it->join();
+    }
+  }
+
+  std::vector<snapshot_tuple> tuples;
+
+  for(std::size_t source = 0 ; source < snapshot_paths.size() ; ++source)
+  {
+    if(!read[source])
+    {
+      std::cerr << "can't read " << snapshot_paths[source] << std::endl;
+
+      return EXIT_FAILURE;
+    }
+
+    tuples.insert(tuples.end(),snapshot_tuples[source].begin(),
+                  snapshot_tuples[source].end());
+
+    std::vector<snapshot_tuple>().swap(snapshot_tuples[source]);
+  }
+
+  std::cout << tuples.size() << " interface settings from "
+            << snapshot_paths.size() << " snapshots, " << thread_number
+            << " threads" << std::endl;
+
+
+  std::vector<policy_result> results(rule_paths.size());
+
+  for(std::size_t policy = 0 ; policy < rule_paths.size() ; ++policy)
+  {
+    if(!std::ifstream(rule_paths[policy]).is_open())
+    {
+      std::cerr << "can't read " << rule_paths[policy] << std::endl;
+
+      return EXIT_FAILURE;
+    }
+
+    gemini::rule_set rules(rule_paths[policy]);
+
+    rules.load(rule_paths[policy]);
+
+    // scheduled rules as active at the given time
+    if(time != 0)
+    {
+      std::vector<gemini::rule> toggled;
+
+      rules.advance(time,toggled);
+    }
+
+    evaluate(rules,tuples,thread_number,results[policy]);
+
+    policy_result const& result = results[policy];
+
+    std::cout << rule_paths[policy] << ": " << rules.size() << " rules, "
+              << tuples.size() - result.prohibited << " permitted, "
+              << result.prohibited << " prohibited, "
+              << static_cast<std::uint64_t> (tuples.size() /
+                                             std::max(result.seconds,1e-9))
+              << " decisions/s" << std::endl;
+  }
+
+
+  // decision changes against the first rule set
+  for(std::size_t policy = 1 ; policy < rule_paths.size() ; ++policy)
+  {
+    policy_result const& old_result = results[0],
+                       & new_result = results[policy];
+
+    std::size_t newly_prohibited = 0,
+                newly_permitted  = 0;
+
+    std::ostringstream changes;
+
+    for(std::size_t index = 0 ; index < tuples.size() ; ++index)
+    {
+      if(old_result.permissions[index] == new_result.permissions[index])
+      {
+        continue;
+      }
+
+      bool prohibited = !new_result.permissions[index];
+
+      if(prohibited) ++newly_prohibited;
+      else           ++newly_permitted;
+
+      if(newly_prohibited + newly_permitted > limit) continue;
+
+      changes << (prohibited ? "  PROHIBITED " : "  PERMITTED  ")
+              << snapshot_paths[tuples[index].source] << ":"
+              << tuples[index].line << " " << tuple_info(tuples[index])
+              << " (rule " << rule_info(old_result.rules[index]) << " -> "
+              << rule_info(new_result.rules[index]) << ")" << std::endl;
+    }
+
+    std::cout << rule_paths[0] << " -> " << rule_paths[policy] << ": "
+              << newly_prohibited << " newly prohibited, " << newly_permitted
+              << " newly permitted" << std::endl << changes.str();
+  }
+
+
+  return EXIT_SUCCESS;
+}
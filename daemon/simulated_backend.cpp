@@ -0,0 +1,468 @@
+// std
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <thread>
+
+// class
+#include <simulated_backend.hpp>
+
+
+namespace gemini
+{
+
+simulation_config::simulation_config() :
+device_number(1000),
+bus_number(4),
+min_interfaces(1),
+max_interfaces(4),
+min_altsettings(1),
+max_altsettings(2),
+endpoints(2),
+interface_classes({LIBUSB_CLASS_AUDIO,LIBUSB_CLASS_COMM,LIBUSB_CLASS_HID,
+                   LIBUSB_CLASS_PRINTER,LIBUSB_CLASS_MASS_STORAGE,
+                   LIBUSB_CLASS_VIDEO,LIBUSB_CLASS_WIRELESS,
+                   LIBUSB_CLASS_VENDOR_SPEC}),
+id_range(64),
+enumerate_latency(0),
+descriptor_latency(0),
+open_latency(0),
+string_latency(0),
+driver_latency(0),
+descriptor_failure_rate(0.0),
+open_failure_rate(0.0),
+detach_failure_rate(0.0),
+attach_failure_rate(0.0),
+seed(5489)
+{}
+
+
+simulated_device::simulated_device() :
+bus(0),
+port(0),
+address(0),
+strings(1)
+{
+  std::memset(&device_descriptor,0,sizeof(device_descriptor));
+  std::memset(&config_descriptor,0,sizeof(config_descriptor));
+
+  device_descriptor.bLength         = LIBUSB_DT_DEVICE_SIZE;
+  device_descriptor.bDescriptorType = LIBUSB_DT_DEVICE;
+
+  config_descriptor.bLength             = LIBUSB_DT_CONFIG_SIZE;
+  config_descriptor.bDescriptorType     = LIBUSB_DT_CONFIG;
+  config_descriptor.bConfigurationValue = 1;
+}
+
+
+void simulated_device::wire()
+{
+  std::size_t setting_index = 0;
+  int         total_length  = config_descriptor.bLength
+                            + config_descriptor.extra_length;
+
+  interfaces.resize(settings.size());
+
+  for(std::size_t intf = 0 ; intf < settings.size() ; ++intf)
+  {
+    for(auto setting_it  = settings[intf].begin() ;
+             setting_it != settings[intf].end()   ; ++setting_it)
+    {
+      if(setting_index < endpoints.size() && !endpoints[setting_index].empty())
+      {
+        setting_it->endpoint      = endpoints[setting_index].data();
+        setting_it->bNumEndpoints = endpoints[setting_index].size();
+      }
+
+      else
+      {
+        setting_it->endpoint      = nullptr;
+        setting_it->bNumEndpoints = 0;
+      }
+
+      total_length += setting_it->bLength + setting_it->extra_length;
+
+      for(uint8_t endpoint = 0 ; endpoint < setting_it->bNumEndpoints ; ++endpoint)
+      {
+        total_length += setting_it->endpoint[endpoint].bLength
+                      + setting_it->endpoint[endpoint].extra_length;
+      }
+
+      ++setting_index;
+    }
+
+    interfaces[intf].altsetting    = settings[intf].data();
+    interfaces[intf].num_altsetting = settings[intf].size();
+  }
+
+  // length of the configuration in its wire format, as a device reports it
+  config_descriptor.wTotalLength   = total_length;
+  config_descriptor.bNumInterfaces = interfaces.size();
+  config_descriptor.interface      = interfaces.data();
+
+  driver_active.resize(interfaces.size(),true);
+}
+
+
+simulated_backend::simulated_backend(simulation_config const& config) :
+config_(config),
+address_(0),
+random_(config.seed)
+{
+  for(unsigned int device = 0 ; device < config_.device_number ; ++device)
+  {
+    add_device();
+  }
+}
+
+
+int simulated_backend::init()
+{
+  return LIBUSB_SUCCESS;
+}
+
+int simulated_backend::init_error() const
+{
+  return LIBUSB_SUCCESS;
+}
+
+
+ssize_t simulated_backend::enumerate(std::vector<device_type *> & devices)
+{
+  delay(config_.enumerate_latency);
+
+  devices.clear();
+
+  for(auto device_it = devices_.begin() ; device_it != devices_.end() ; ++device_it)
+  {
+    devices.push_back(reinterpret_cast<device_type *> (device_it->get()));
+  }
+
+  return devices.size();
+}
+
+
+uint8_t simulated_backend::bus_number(device_type * device)
+{
+  return native(device)->bus;
+}
+
+uint8_t simulated_backend::port_number(device_type * device)
+{
+  return native(device)->port;
+}
+
+uint8_t simulated_backend::device_address(device_type * device)
+{
+  return native(device)->address;
+}
+
+
+int simulated_backend::device_descriptor(device_type * device,
+                                         libusb_device_descriptor & dev_desc)
+{
+  delay(config_.descriptor_latency);
+
+  if(fail(config_.descriptor_failure_rate)) return LIBUSB_ERROR_IO;
+
+  dev_desc = native(device)->device_descriptor;
+
+  return LIBUSB_SUCCESS;
+}
+
+int simulated_backend::config_descriptor(device_type * device,
+                                         libusb_config_descriptor ** config_desc)
+{
+  delay(config_.descriptor_latency);
+
+  if(fail(config_.descriptor_failure_rate)) return LIBUSB_ERROR_IO;
+
+  // storage is owned by the device, nothing to allocate
+  *config_desc = &(native(device)->config_descriptor);
+
+  return LIBUSB_SUCCESS;
+}
+
+void simulated_backend::free_config_descriptor(libusb_config_descriptor *)
+{}
+
+
+int simulated_backend::open(device_type * device,handle_type ** device_handle)
+{
+  delay(config_.open_latency);
+
+  if(fail(config_.open_failure_rate)) return LIBUSB_ERROR_ACCESS;
+
+  *device_handle = reinterpret_cast<handle_type *> (native(device));
+
+  return LIBUSB_SUCCESS;
+}
+
+void simulated_backend::close(handle_type *)
+{}
+
+
+int simulated_backend::kernel_driver_active(handle_type * device_handle,
+                                            int interface_id)
+{
+  delay(config_.driver_latency);
+
+  simulated_device * device = native(device_handle);
+
+  if(interface_id < 0 ||
+     static_cast<std::size_t> (interface_id) >= device->driver_active.size())
+  {
+    return LIBUSB_ERROR_NOT_FOUND;
+  }
+
+
+  std::lock_guard<std::mutex> lock(mutex_);
+
+  return device->driver_active[interface_id] ? 1 : 0;
+}
+
+int simulated_backend::detach_kernel_driver(handle_type * device_handle,
+                                            int interface_id)
+{
+  delay(config_.driver_latency);
+
+  simulated_device * device = native(device_handle);
+
+  if(interface_id < 0 ||
+     static_cast<std::size_t> (interface_id) >= device->driver_active.size())
+  {
+    return LIBUSB_ERROR_NOT_FOUND;
+  }
+
+  if(fail(config_.detach_failure_rate)) return LIBUSB_ERROR_BUSY;
+
+
+  std::lock_guard<std::mutex> lock(mutex_);
+
+  if(!device->driver_active[interface_id]) return LIBUSB_ERROR_NOT_FOUND;
+
+  device->driver_active[interface_id] = false;
+
+  return LIBUSB_SUCCESS;
+}
+
+int simulated_backend::attach_kernel_driver(handle_type * device_handle,
+                                            int interface_id)
+{
+  delay(config_.driver_latency);
+
+  simulated_device * device = native(device_handle);
+
+  if(interface_id < 0 ||
+     static_cast<std::size_t> (interface_id) >= device->driver_active.size())
+  {
+    return LIBUSB_ERROR_NOT_FOUND;
+  }
+
+  if(fail(config_.attach_failure_rate)) return LIBUSB_ERROR_BUSY;
+
+
+  std::lock_guard<std::mutex> lock(mutex_);
+
+  if(device->driver_active[interface_id]) return LIBUSB_ERROR_BUSY;
+
+  device->driver_active[interface_id] = true;
+
+  return LIBUSB_SUCCESS;
+}
+
+
+int simulated_backend::string_descriptor(handle_type * device_handle,
+                                         uint8_t index,
+                                         unsigned char * buffer,int length)
+{
+  delay(config_.string_latency);
+
+  simulated_device * device = native(device_handle);
+
+  if(index == 0 || index >= device->strings.size())
+  {
+    return LIBUSB_ERROR_INVALID_PARAM;
+  }
+
+
+  std::string const& string_desc = device->strings[index];
+
+  int char_number = std::min(static_cast<int> (string_desc.size()),length - 1);
+
+  std::memcpy(buffer,string_desc.data(),char_number);
+
+  buffer[char_number] = '\0';
+
+
+  return char_number;
+}
+
+
+simulated_device & simulated_backend::add_device()
+{
+  std::unique_ptr<simulated_device> device(new simulated_device);
+
+  unsigned int device_id = devices_.size();
+
+
+  // address, ports are counted per bus
+  device->bus  = 1 + device_id % config_.bus_number;
+  device->port = 1 + (device_id / config_.bus_number) % 255;
+
+  device->address = next_address();
+
+  device->device_descriptor.idVendor     = random(1,config_.id_range);
+  device->device_descriptor.idProduct    = random(1,config_.id_range);
+  device->device_descriptor.iManufacturer = 1;
+  device->device_descriptor.iProduct      = 2;
+  device->device_descriptor.iSerialNumber = 3;
+
+  device->strings.push_back("Simulated Vendor "
+                            + std::to_string(device->device_descriptor.idVendor));
+  device->strings.push_back("Simulated Device " + std::to_string(device_id));
+  device->strings.push_back("SIM" + std::to_string(device_id));
+
+
+  unsigned int interface_number = random(config_.min_interfaces,
+                                         config_.max_interfaces);
+
+  device->settings.resize(interface_number);
+
+  for(unsigned int intf = 0 ; intf < interface_number ; ++intf)
+  {
+    unsigned int setting_number = random(config_.min_altsettings,
+                                         config_.max_altsettings);
+
+    for(unsigned int setting = 0 ; setting < setting_number ; ++setting)
+    {
+      libusb_interface_descriptor intf_desc;
+
+      std::memset(&intf_desc,0,sizeof(intf_desc));
+
+      intf_desc.bLength            = LIBUSB_DT_INTERFACE_SIZE;
+      intf_desc.bDescriptorType    = LIBUSB_DT_INTERFACE;
+      intf_desc.bInterfaceNumber   = intf;
+      intf_desc.bAlternateSetting  = setting;
+      intf_desc.bInterfaceClass    = LIBUSB_CLASS_VENDOR_SPEC;
+
+      if(!config_.interface_classes.empty())
+      {
+        intf_desc.bInterfaceClass  = config_.interface_classes
+                                     [random(0,config_.interface_classes.size() - 1)];
+      }
+
+      device->settings[intf].push_back(intf_desc);
+
+
+      std::vector<libusb_endpoint_descriptor> setting_endpoints;
+
+      for(unsigned int endpoint = 0 ; endpoint < config_.endpoints ; ++endpoint)
+      {
+        libusb_endpoint_descriptor endpoint_desc;
+
+        std::memset(&endpoint_desc,0,sizeof(endpoint_desc));
+
+        endpoint_desc.bLength          = LIBUSB_DT_ENDPOINT_SIZE;
+        endpoint_desc.bDescriptorType  = LIBUSB_DT_ENDPOINT;
+        endpoint_desc.bEndpointAddress = (endpoint + 1) | (endpoint % 2 ? 0x80 : 0);
+        endpoint_desc.bmAttributes     = 2;
+        endpoint_desc.wMaxPacketSize   = 512;
+
+        setting_endpoints.push_back(endpoint_desc);
+      }
+
+      device->endpoints.push_back(setting_endpoints);
+    }
+  }
+
+  device->wire();
+
+
+  devices_.push_back(std::move(device));
+
+  return *(devices_.back());
+}
+
+void simulated_backend::add_device(std::unique_ptr<simulated_device> device)
+{
+  // re-added devices are enumerated again
+  device->address = next_address();
+
+  device->wire();
+
+  devices_.push_back(std::move(device));
+}
+
+void simulated_backend::remove_device(std::size_t index)
+{
+  if(index < devices_.size()) devices_.erase(devices_.begin() + index);
+}
+
+void simulated_backend::clear()
+{
+  devices_.clear();
+}
+
+
+std::size_t simulated_backend::size() const
+{
+  return devices_.size();
+}
+
+simulation_config const& simulated_backend::config() const
+{
+  return config_;
+}
+
+
+simulated_device * simulated_backend::native(device_type * device)
+{
+  return reinterpret_cast<simulated_device *> (device);
+}
+
+simulated_device * simulated_backend::native(handle_type * device_handle)
+{
+  return reinterpret_cast<simulated_device *> (device_handle);
+}
+
+
+void simulated_backend::delay(unsigned int microseconds) const
+{
+  if(microseconds > 0)
+  {
+    std::this_thread::sleep_for(std::chrono::microseconds(microseconds));
+  }
+}
+
+bool simulated_backend::fail(double rate)
+{
+  if(rate <= 0.0) return false;
+
+
+  std::lock_guard<std::mutex> lock(mutex_);
+
+  return std::generate_canonical<double,32>(random_) < rate;
+}
+
+unsigned int simulated_backend::random(unsigned int min,unsigned int max)
+{
+  if(max <= min) return min;
+
+
+  std::lock_guard<std::mutex> lock(mutex_);
+
+  return std::uniform_int_distribution<unsigned int>(min,max)(random_);
+}
+
+
+uint8_t simulated_backend::next_address()
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+
+  address_ = address_ % 127 + 1;
+
+  return address_;
+}
+
+}
@@ -0,0 +1,164 @@
+#ifndef GEMINI_SIMULATED_BACKEND
+#define GEMINI_SIMULATED_BACKEND
+
+
+// std
+#include <memory>
+#include <mutex>
+#include <random>
+#include <string>
+#include <vector>
+
+// gemini
+#include <device_backend.hpp>
+
+
+namespace gemini
+{
+
+// shape, latency and failure behaviour of a simulated device population
+struct simulation_config
+{
+  simulation_config();
+
+  // population
+  unsigned int         device_number;
+  unsigned short       bus_number;
+
+  // interface shape of every device
+  unsigned short       min_interfaces,
+                       max_interfaces,
+                       min_altsettings,
+                       max_altsettings,
+                       endpoints;
+
+  // interface classes drawn for the settings
+  std::vector<uint8_t> interface_classes;
+
+  // vendor and product ids are drawn from [1,id_range]
+  unsigned short       id_range;
+
+  // injected latencies (microseconds)
+  unsigned int         enumerate_latency,
+                       descriptor_latency,
+                       open_latency,
+                       string_latency,
+                       driver_latency;
+
+  // failure probabilities [0,1]
+  double               descriptor_failure_rate,
+                       open_failure_rate,
+                       detach_failure_rate,
+                       attach_failure_rate;
+
+  unsigned int         seed;
+};
+
+
+// usb device in memory, owns the storage the libusb structures point to
+struct simulated_device
+{
+  simulated_device();
+
+  simulated_device(simulated_device const&)              = delete;
+  simulated_device & operator = (simulated_device const&) = delete;
+
+  // connect the libusb structures, call after the storage is complete
+  void wire();
+
+
+  uint8_t                                               bus,
+                                                        port,
+                                                        address;
+
+  libusb_device_descriptor                              device_descriptor;
+  libusb_config_descriptor                              config_descriptor;
+
+  // interfaces, settings of every interface, endpoints of every setting
+  std::vector<libusb_interface>                         interfaces;
+  std::vector<std::vector<libusb_interface_descriptor> > settings;
+  std::vector<std::vector<libusb_endpoint_descriptor> >  endpoints;
+
+  // string descriptors by index (index 0 is unused)
+  std::vector<std::string>                              strings;
+
+  // kernel driver bound on interface
+  std::vector<bool>                                     driver_active;
+};
+
+
+// in process usb backend for benchmarks and tests without usb hardware
+class simulated_backend : public device_backend
+{
+  public :
+
+  simulated_backend(simulation_config const& config = simulation_config());
+
+  int init();
+  int init_error() const;
+
+  ssize_t enumerate(std::vector<device_type *> & devices);
+
+  uint8_t bus_number(device_type * device);
+  uint8_t port_number(device_type * device);
+  uint8_t device_address(device_type * device);
+
+  int  device_descriptor(device_type * device,
+                         libusb_device_descriptor & dev_desc);
+  int  config_descriptor(device_type * device,
+                         libusb_config_descriptor ** config_desc);
+  void free_config_descriptor(libusb_config_descriptor * config_desc);
+
+  int  open(device_type * device,handle_type ** device_handle);
+  void close(handle_type * device_handle);
+
+  int kernel_driver_active(handle_type * device_handle,int interface_id);
+  int detach_kernel_driver(handle_type * device_handle,int interface_id);
+  int attach_kernel_driver(handle_type * device_handle,int interface_id);
+
+  int string_descriptor(handle_type * device_handle,uint8_t index,
+                        unsigned char * buffer,int length);
+
+
+  // device population
+  simulated_device & add_device();
+  void add_device(std::unique_ptr<simulated_device> device);
+  void remove_device(std::size_t index);
+  void clear();
+
+  std::size_t size() const;
+
+  simulation_config const& config() const;
+
+
+  protected :
+
+  static simulated_device * native(device_type * device);
+  static simulated_device * native(handle_type * device_handle);
+
+  // injected latency
+  void delay(unsigned int microseconds) const;
+
+  // injected failure
+  bool fail(double rate);
+
+  // uniform random number in [min,max]
+  unsigned int random(unsigned int min,unsigned int max);
+
+  // next free bus address like a host controller, 1 to 127
+  uint8_t next_address();
+
+
+  simulation_config                              config_;
+
+  std::vector<std::unique_ptr<simulated_device> > devices_;
+  uint8_t                                        address_;
+
+  // guards random generator and driver states (parallel enforcement)
+  std::mutex                                     mutex_;
+  std::mt19937                                   random_;
+};
+
+}
+
+#endif // GEMINI_SIMULATED_BACKEND
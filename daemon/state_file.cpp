@@ -0,0 +1,253 @@
+// posix
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// std
+#include <cstring>
+
+// gemini
+#include <rule_index.hpp>
+
+// class
+#include <state_file.hpp>
+
+
+namespace gemini
+{
+
+const std::uint32_t state_file::MAGIC             = 0x47454d53; // "GEMS"
+const std::uint32_t state_file::VERSION           = 3;
+const std::uint32_t state_file::DISABLED_CAPACITY = 1024;
+const std::uint32_t state_file::DECISION_CAPACITY = 4096;
+
+
+state_file::state_file(std::string const& path) :
+path_(path),
+file_descriptor_(-1),
+mapping_(nullptr)
+{}
+
+state_file::~state_file()
+{
+  close();
+}
+
+
+bool state_file::open()
+{
+  if(is_open()) return true;
+
+
+  file_descriptor_ = ::open(path_.c_str(),O_RDWR | O_CREAT,S_IRUSR | S_IWUSR);
+
+  if(file_descriptor_ < 0) return false;
+
+
+  struct stat file_status;
+
+  bool fresh = fstat(file_descriptor_,&file_status) != 0 ||
+               static_cast<std::size_t> (file_status.st_size) != file_size();
+
+  // file is new or has the wrong layout, resize before mapping
+  if(fresh && ftruncate(file_descriptor_,file_size()) != 0)
+  {
+    close();
+
+    return false;
+  }
+
+
+  mapping_ = mmap(nullptr,file_size(),PROT_READ | PROT_WRITE,MAP_SHARED,
+                  file_descriptor_,0);
+
+  if(mapping_ == MAP_FAILED)
+  {
+    mapping_ = nullptr;
+
+    close();
+
+    return false;
+  }
+
+
+  header const* state_header = static_cast<header const*> (mapping_);
+
+  // state of an incompatible daemon version or damaged (counts beyond the
+  // capacity would read past the record blocks)
+  if(fresh                                             ||
+     state_header->magic           != MAGIC             ||
+     state_header->version         != VERSION           ||
+     state_header->descriptor_size != DESCRIPTOR_SIZE   ||
+     state_header->disabled_number >  DISABLED_CAPACITY ||
+     state_header->decision_number >  DECISION_CAPACITY  )
+  {
+    reset();
+  }
+
+
+  return true;
+}
+
+void state_file::close()
+{
+  if(mapping_ != nullptr)
+  {
+    msync(mapping_,file_size(),MS_SYNC);
+    munmap(mapping_,file_size());
+
+    mapping_ = nullptr;
+  }
+
+  if(file_descriptor_ >= 0)
+  {
+    ::close(file_descriptor_);
+
+    file_descriptor_ = -1;
+  }
+}
+
+
+bool state_file::is_open() const
+{
+  return mapping_ != nullptr;
+}
+
+
+void state_file::load(std::list<descriptor>                & disabled,
+                      std::map<descriptor,cached_decision> & decisions,
+                      std::uint64_t                        & fingerprint) const
+{
+  if(!is_open()) return;
+
+
+  header const* state_header = static_cast<header const*> (mapping_);
+
+  record const* state_records = records();
+
+  descriptor::info_type info;
+
+
+  // first block of records holds the detached interfaces
+  for(std::uint32_t index = 0 ; index < state_header->disabled_number ; ++index)
+  {
+    std::copy(state_records[index].info,
+              state_records[index].info + DESCRIPTOR_SIZE,info.begin());
+
+    disabled.push_back(descriptor(info));
+  }
+
+  state_records += DISABLED_CAPACITY;
+
+  // second block holds the cached decisions
+  for(std::uint32_t index = 0 ; index < state_header->decision_number ; ++index)
+  {
+    std::copy(state_records[index].info,
+              state_records[index].info + DESCRIPTOR_SIZE,info.begin());
+
+    cached_decision & decision = decisions[descriptor(info)];
+
+    decision.permission = state_records[index].value != 0;
+    decision.rule       = state_records[index].rule == 0 ?
+
+                          rule_index::NO_MATCH : state_records[index].rule - 1;
+  }
+
+  fingerprint = state_header->fingerprint;
+}
+
+void state_file::store(std::list<descriptor>                const& disabled,
+                       std::map<descriptor,cached_decision> const& decisions,
+                       std::uint64_t                               fingerprint)
+{
+  if(!is_open()) return;
+
+
+  header * state_header = static_cast<header *> (mapping_);
+
+  record * state_records = records();
+
+  std::uint32_t index = 0;
+
+
+  // invalidate counters first, a crash during the update loses the state only
+  state_header->disabled_number = 0;
+  state_header->decision_number = 0;
+
+
+  for(auto desc_it = disabled.begin() ;
+           desc_it != disabled.end() && index < DISABLED_CAPACITY ; ++desc_it)
+  {
+    for(unsigned short info = BUS ; info != UNDEFINED ; ++info)
+    {
+      state_records[index].info[info] = (*desc_it)[info];
+    }
+
+    state_records[index].value = 0;
+    state_records[index].rule  = 0;
+
+    ++index;
+  }
+
+  state_header->disabled_number = index;
+
+
+  state_records += DISABLED_CAPACITY;
+
+  index = 0;
+
+  for(auto decision_it = decisions.begin() ;
+           decision_it != decisions.end() && index < DECISION_CAPACITY ;
+         ++decision_it)
+  {
+    for(unsigned short info = BUS ; info != UNDEFINED ; ++info)
+    {
+      state_records[index].info[info] = decision_it->first[info];
+    }
+
+    state_records[index].value = decision_it->second.permission;
+    state_records[index].rule  =
+
+    decision_it->second.rule == rule_index::NO_MATCH ?
+
+    0 : static_cast<std::uint32_t> (decision_it->second.rule + 1);
+
+    ++index;
+  }
+
+  state_header->decision_number = index;
+  state_header->fingerprint     = fingerprint;
+
+
+  // write back asynchronous, the enforcement pass must not wait for the disk
+  msync(mapping_,file_size(),MS_ASYNC);
+}
+
+
+std::size_t state_file::file_size()
+{
+  return sizeof(header)
+       + sizeof(record) * (DISABLED_CAPACITY + DECISION_CAPACITY);
+}
+
+
+void state_file::reset()
+{
+  std::memset(mapping_,0,file_size());
+
+  header * state_header = static_cast<header *> (mapping_);
+
+  state_header->magic           = MAGIC;
+  state_header->version         = VERSION;
+  state_header->descriptor_size = DESCRIPTOR_SIZE;
+}
+
+
+state_file::record * state_file::records() const
+{
+  return reinterpret_cast<record *> (static_cast<char *> (mapping_)
+                                     + sizeof(header));
+}
+
+}
@@ -0,0 +1,96 @@
+#ifndef GEMINI_STATE_FILE
+#define GEMINI_STATE_FILE
+
+
+// std
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <map>
+#include <string>
+
+// gemini
+#include <descriptor.hpp>
+
+
+namespace gemini
+{
+
+// cached decision of an interface and the position of its deciding rule
+// (see rule_set::permission)
+struct cached_decision
+{
+  bool        permission;
+  std::size_t rule;
+};
+
+
+// memory mapped enforcement state, survives a restart of the daemon
+class state_file
+{
+  public :
+
+  state_file(std::string const& path = "/etc/gemini/gemini.state");
+  ~state_file();
+
+  // map the state file, creates a new one if it doesn't exist or is damaged
+  bool open();
+  void close();
+
+  bool is_open() const;
+
+  // read the state of a previous daemon instance
+  void load(std::list<descriptor>                    & disabled,
+            std::map<descriptor,cached_decision>     & decisions,
+            std::uint64_t                            & fingerprint) const;
+
+  // write the current state into the mapping
+  void store(std::list<descriptor>                const& disabled,
+             std::map<descriptor,cached_decision> const& decisions,
+             std::uint64_t                               fingerprint);
+
+
+  private :
+
+  static const std::uint32_t MAGIC,
+                             VERSION,
+                             DISABLED_CAPACITY,
+                             DECISION_CAPACITY;
+
+  struct header
+  {
+    std::uint32_t magic,
+                  version,
+                  descriptor_size,
+                  disabled_number,
+                  decision_number,
+                  reserved;
+    std::uint64_t fingerprint;
+  };
+
+  // value is the permission of a decision, rule its deciding rule + 1 (0
+  // if no rule matched)
+  struct record
+  {
+    std::uint32_t info[DESCRIPTOR_SIZE];
+    std::uint32_t value,
+                  rule;
+  };
+
+  static std::size_t file_size();
+
+  void reset();
+
+  record * records() const;
+
+
+  std::string path_;
+
+  int         file_descriptor_;
+
+  void      * mapping_;
+};
+
+}
+
+#endif // GEMINI_STATE_FILE
@@ -0,0 +1,137 @@
+// class
+#include <storm_detector.hpp>
+
+// gemini
+#include <metrics.hpp>
+
+
+namespace gemini
+{
+
+namespace
+{
+  std::uint16_t port_key(descriptor const& device_desc)
+  {
+    return (device_desc[BUS] << 8) | (device_desc[PORT] & 0xff);
+  }
+
+  std::uint32_t identity_key(descriptor const& device_desc)
+  {
+    return (static_cast<std::uint32_t> (device_desc[VENDOR_ID]) << 16)
+           | device_desc[PRODUCT_ID];
+  }
+}
+
+
+storm_detector::storm_detector(unsigned short  threshold,
+                               clock::duration window,
+                               clock::duration quiet) :
+threshold_(threshold),
+window_(window),
+quiet_(quiet)
+{}
+
+
+bool storm_detector::arrival(descriptor const& device_desc,
+                             clock::time_point const& now)
+{
+  bool port_storm     = record(ports_[port_key(device_desc)],now),
+       identity_storm = record(identities_[identity_key(device_desc)],now);
+
+  if(port_storm || identity_storm) metrics().storm_arrivals.add();
+
+
+  return port_storm || identity_storm;
+}
+
+
+bool storm_detector::storming(descriptor const& device_desc,
+                              clock::time_point const& now) const
+{
+  auto port_it     = ports_.find(port_key(device_desc));
+  auto identity_it = identities_.find(identity_key(device_desc));
+
+  return (port_it     != ports_.end()      && storming(port_it->second,now)) ||
+         (identity_it != identities_.end() && storming(identity_it->second,now));
+}
+
+
+void storm_detector::expire(clock::time_point const& now)
+{
+  std::int64_t storming_ports      = 0,
+               storming_identities = 0;
+
+
+  for(auto port_it = ports_.begin() ; port_it != ports_.end() ;)
+  {
+    port_it->second.storming = storming(port_it->second,now);
+
+    if(port_it->second.storming) ++storming_ports;
+
+
+    // nothing arrived for the quiet time, the port is forgotten
+    if(now - port_it->second.arrivals.back() > quiet_)
+    {
+      port_it = ports_.erase(port_it);
+    }
+
+    else ++port_it;
+  }
+
+  for(auto identity_it = identities_.begin() ; identity_it != identities_.end() ;)
+  {
+    identity_it->second.storming = storming(identity_it->second,now);
+
+    if(identity_it->second.storming) ++storming_identities;
+
+
+    if(now - identity_it->second.arrivals.back() > quiet_)
+    {
+      identity_it = identities_.erase(identity_it);
+    }
+
+    else ++identity_it;
+  }
+
+
+  metrics().storming_ports.set(storming_ports);
+  metrics().storming_identities.set(storming_identities);
+}
+
+
+bool storm_detector::record(activity & device_activity,
+                            clock::time_point const& now)
+{
+  // storm ended after the quiet time
+  device_activity.storming = storming(device_activity,now);
+
+  device_activity.arrivals.push_back(now);
+
+  // keep the arrivals of the window only
+  while(now - device_activity.arrivals.front() > window_)
+  {
+    device_activity.arrivals.pop_front();
+  }
+
+
+  if(!device_activity.storming && device_activity.arrivals.size() >= threshold_)
+  {
+    device_activity.storming = true;
+
+    metrics().storms.add();
+  }
+
+
+  return device_activity.storming;
+}
+
+
+// storms last until the quiet time passed without arrival
+bool storm_detector::storming(activity const& device_activity,
+                              clock::time_point const& now) const
+{
+  return device_activity.storming && !device_activity.arrivals.empty() &&
+         now - device_activity.arrivals.back() <= quiet_;
+}
+
+}
@@ -0,0 +1,68 @@
+#ifndef GEMINI_STORM_DETECTOR
+#define GEMINI_STORM_DETECTOR
+
+
+// std
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <map>
+
+// gemini
+#include <descriptor.hpp>
+
+
+namespace gemini
+{
+
+// detects arrival storms (devices re-enumerating again and again) per port
+// and per device identity (vendor and product id), not thread safe
+class storm_detector
+{
+  public :
+
+  typedef std::chrono::steady_clock clock;
+
+  // a storm starts with threshold arrivals within window and ends after quiet
+  // time without arrival
+  storm_detector(unsigned short  threshold = 3,
+                 clock::duration window    = std::chrono::seconds(2),
+                 clock::duration quiet     = std::chrono::seconds(10));
+
+  // arrival of a device, returns true if port or identity are storming
+  bool arrival(descriptor const& device_desc,clock::time_point const& now);
+
+  bool storming(descriptor const& device_desc,
+                clock::time_point const& now) const;
+
+  // forget quiet ports and identities, updates the storm gauges
+  void expire(clock::time_point const& now);
+
+
+  private :
+
+  struct activity
+  {
+    std::deque<clock::time_point> arrivals;
+    bool                          storming;
+  };
+
+  // returns true if the activity is storming after the arrival
+  bool record(activity & device_activity,clock::time_point const& now);
+
+  bool storming(activity const& device_activity,
+                clock::time_point const& now) const;
+
+
+  unsigned short                   threshold_;
+  clock::duration                  window_,
+                                   quiet_;
+
+  // bus << 8 | port and vendor << 16 | product
+  std::map<std::uint16_t,activity> ports_;
+  std::map<std::uint32_t,activity> identities_;
+};
+
+}
+
+#endif // GEMINI_STORM_DETECTOR
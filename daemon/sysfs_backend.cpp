@@ -0,0 +1,790 @@
+// posix
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+// std
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <sstream>
+
+// class
+#include <sysfs_backend.hpp>
+
+
+namespace gemini
+{
+
+namespace
+{
+  // directory entry of getdents64 (struct linux_dirent64), the name is null
+  // terminated and fills the rest of the record
+  struct dirent_record
+  {
+    std::uint64_t  inode;
+    std::int64_t   offset;
+    unsigned short record_length;
+    unsigned char  type;
+    char           name[1];
+  };
+
+  // little endian word of a descriptor
+  uint16_t word(unsigned char const* data)
+  {
+    return data[0] | data[1] << 8;
+  }
+
+  // descriptors that aren't followed by extra descriptors of their own
+  bool standard(unsigned char type)
+  {
+    return type == LIBUSB_DT_DEVICE    || type == LIBUSB_DT_CONFIG ||
+           type == LIBUSB_DT_INTERFACE || type == LIBUSB_DT_ENDPOINT;
+  }
+}
+
+
+sysfs_device::sysfs_device() :
+bus(0),
+port(0),
+address(0)
+{
+  std::memset(&device_descriptor,0,sizeof(device_descriptor));
+  std::memset(&config_descriptor,0,sizeof(config_descriptor));
+
+  device_descriptor.bLength         = LIBUSB_DT_DEVICE_SIZE;
+  device_descriptor.bDescriptorType = LIBUSB_DT_DEVICE;
+
+  config_descriptor.bLength         = LIBUSB_DT_CONFIG_SIZE;
+  config_descriptor.bDescriptorType = LIBUSB_DT_CONFIG;
+}
+
+
+bool sysfs_device::parse(uint8_t configuration)
+{
+  unsigned char const* data   = reinterpret_cast<unsigned char const*>
+                                (descriptors.data());
+  std::size_t          length = descriptors.size();
+
+  if(length < LIBUSB_DT_DEVICE_SIZE || data[1] != LIBUSB_DT_DEVICE) return false;
+
+  device_descriptor.bLength            = data[0];
+  device_descriptor.bDescriptorType    = data[1];
+  device_descriptor.bcdUSB             = word(data + 2);
+  device_descriptor.bDeviceClass       = data[4];
+  device_descriptor.bDeviceSubClass    = data[5];
+  device_descriptor.bDeviceProtocol    = data[6];
+  device_descriptor.bMaxPacketSize0    = data[7];
+  device_descriptor.idVendor           = word(data + 8);
+  device_descriptor.idProduct          = word(data + 10);
+  device_descriptor.bcdDevice          = word(data + 12);
+  device_descriptor.iManufacturer      = data[14];
+  device_descriptor.iProduct           = data[15];
+  device_descriptor.iSerialNumber      = data[16];
+  device_descriptor.bNumConfigurations = data[17];
+
+  // unconfigured devices have no active configuration
+  if(configuration == 0) return true;
+
+
+  // configurations follow the device descriptor, each wTotalLength long
+  std::size_t position = LIBUSB_DT_DEVICE_SIZE;
+
+  while(position + LIBUSB_DT_CONFIG_SIZE <= length &&
+        data[position + 1] == LIBUSB_DT_CONFIG &&
+        data[position + 5] != configuration)
+  {
+    position += std::max<std::size_t> (word(data + position + 2),
+                                       LIBUSB_DT_CONFIG_SIZE);
+  }
+
+  if(position + LIBUSB_DT_CONFIG_SIZE > length ||
+     data[position + 1] != LIBUSB_DT_CONFIG)
+  {
+    return false;
+  }
+
+  length = std::min<std::size_t> (length,position + word(data + position + 2));
+
+  config_descriptor.bLength             = data[position];
+  config_descriptor.bDescriptorType     = data[position + 1];
+  config_descriptor.wTotalLength        = word(data + position + 2);
+  config_descriptor.bNumInterfaces      = data[position + 4];
+  config_descriptor.bConfigurationValue = data[position + 5];
+  config_descriptor.iConfiguration      = data[position + 6];
+  config_descriptor.bmAttributes        = data[position + 7];
+  config_descriptor.MaxPower            = data[position + 8];
+
+
+  // settings of an interface are adjacent, descriptors that aren't standard
+  // are extra descriptors of the latest standard one (as libusb parses them)
+  unsigned char const** extra        = &config_descriptor.extra;
+  int *                 extra_length = &config_descriptor.extra_length;
+
+  for(position += std::max<std::size_t> (data[position],LIBUSB_DT_CONFIG_SIZE) ;
+      position + 2 <= length ; position += data[position])
+  {
+    unsigned char const* desc = data + position;
+
+    if(desc[0] < 2 || position + desc[0] > length) return false;
+
+
+    if(desc[1] == LIBUSB_DT_INTERFACE && desc[0] >= LIBUSB_DT_INTERFACE_SIZE)
+    {
+      if(settings.empty() || settings.back().front().bInterfaceNumber != desc[2])
+      {
+        if(settings.size() == config_descriptor.bNumInterfaces) break;
+
+        settings.push_back(std::vector<libusb_interface_descriptor>());
+      }
+
+      libusb_interface_descriptor intf_desc;
+
+      std::memset(&intf_desc,0,sizeof(intf_desc));
+
+      intf_desc.bLength            = desc[0];
+      intf_desc.bDescriptorType    = desc[1];
+      intf_desc.bInterfaceNumber   = desc[2];
+      intf_desc.bAlternateSetting  = desc[3];
+      intf_desc.bNumEndpoints      = desc[4];
+      intf_desc.bInterfaceClass    = desc[5];
+      intf_desc.bInterfaceSubClass = desc[6];
+      intf_desc.bInterfaceProtocol = desc[7];
+      intf_desc.iInterface         = desc[8];
+
+      settings.back().push_back(intf_desc);
+      endpoints.push_back(std::vector<libusb_endpoint_descriptor>());
+
+      extra        = &settings.back().back().extra;
+      extra_length = &settings.back().back().extra_length;
+    }
+
+    else if(desc[1] == LIBUSB_DT_ENDPOINT && desc[0] >= LIBUSB_DT_ENDPOINT_SIZE &&
+            !endpoints.empty())
+    {
+      libusb_endpoint_descriptor ep_desc;
+
+      std::memset(&ep_desc,0,sizeof(ep_desc));
+
+      ep_desc.bLength          = desc[0];
+      ep_desc.bDescriptorType  = desc[1];
+      ep_desc.bEndpointAddress = desc[2];
+      ep_desc.bmAttributes     = desc[3];
+      ep_desc.wMaxPacketSize   = word(desc + 4);
+      ep_desc.bInterval        = desc[6];
+
+      // audio endpoints
+      if(desc[0] >= LIBUSB_DT_ENDPOINT_AUDIO_SIZE)
+      {
+        ep_desc.bRefresh      = desc[7];
+        ep_desc.bSynchAddress = desc[8];
+      }
+
+      endpoints.back().push_back(ep_desc);
+
+      extra        = &endpoints.back().back().extra;
+      extra_length = &endpoints.back().back().extra_length;
+    }
+
+    else if(!standard(desc[1]))
+    {
+      if(*extra_length == 0) *extra = desc;
+
+      *extra_length += desc[0];
+    }
+  }
+
+  return true;
+}
+
+
+void sysfs_device::wire()
+{
+  std::size_t setting_index = 0;
+
+  interfaces.resize(settings.size());
+
+  for(std::size_t intf = 0 ; intf < settings.size() ; ++intf)
+  {
+    for(auto setting_it  = settings[intf].begin() ;
+             setting_it != settings[intf].end()   ; ++setting_it)
+    {
+      if(setting_index < endpoints.size() && !endpoints[setting_index].empty())
+      {
+        setting_it->endpoint      = endpoints[setting_index].data();
+        setting_it->bNumEndpoints = endpoints[setting_index].size();
+      }
+
+      else
+      {
+        setting_it->endpoint      = nullptr;
+        setting_it->bNumEndpoints = 0;
+      }
+
+      ++setting_index;
+    }
+
+    interfaces[intf].altsetting     = settings[intf].data();
+    interfaces[intf].num_altsetting = settings[intf].size();
+  }
+
+  config_descriptor.bNumInterfaces = interfaces.size();
+  config_descriptor.interface      = interfaces.data();
+}
+
+
+sysfs_backend::sysfs_backend(std::string const& root,bool authorization) :
+root_(root),
+devices_path_(root + "/bus/usb/devices/"),
+init_error_(LIBUSB_ERROR_OTHER),
+authorization_(authorization),
+syscalls_(0)
+{}
+
+
+int sysfs_backend::init()
+{
+  ++syscalls_;
+
+  init_error_ = access(devices_path_.c_str(),R_OK | X_OK) == 0 ?
+
+                LIBUSB_SUCCESS : LIBUSB_ERROR_NOT_FOUND;
+
+  // authorized devices would bind their interfaces without authorization
+  if(init_error_ == LIBUSB_SUCCESS && authorization_ && !lock_down())
+  {
+    init_error_ = LIBUSB_ERROR_NOT_SUPPORTED;
+  }
+
+  return init_error_;
+}
+
+int sysfs_backend::init_error() const
+{
+  return init_error_;
+}
+
+
+ssize_t sysfs_backend::enumerate(std::vector<device_type *> & devices)
+{
+  devices.clear();
+
+  std::vector<std::string> entries;
+
+  if(!list(devices_path_,entries)) return LIBUSB_ERROR_IO;
+
+
+  std::map<std::string,std::unique_ptr<sysfs_device> > present;
+
+  for(auto entry_it = entries.begin() ; entry_it != entries.end() ; ++entry_it)
+  {
+    // interfaces are read with their device
+    if(entry_it->find(':') != std::string::npos) continue;
+
+
+    auto known_it = devices_.find(*entry_it);
+
+    unsigned long address;
+
+    // same device number, the device wasn't enumerated again
+    if(known_it != devices_.end() &&
+       read(devices_path_ + *entry_it + "/devnum",10,address) &&
+       address == known_it->second->address)
+    {
+      present[*entry_it] = std::move(known_it->second);
+    }
+
+    else
+    {
+      std::unique_ptr<sysfs_device> device = read_device(*entry_it);
+
+      if(device) present[*entry_it] = std::move(device);
+    }
+  }
+
+  devices_.swap(present);
+
+
+  for(auto device_it = devices_.begin() ; device_it != devices_.end() ; ++device_it)
+  {
+    devices.push_back(reinterpret_cast<device_type *> (device_it->second.get()));
+  }
+
+  return devices.size();
+}
+
+
+uint8_t sysfs_backend::bus_number(device_type * device)
+{
+  return native(device)->bus;
+}
+
+uint8_t sysfs_backend::port_number(device_type * device)
+{
+  return native(device)->port;
+}
+
+int sysfs_backend::port_numbers(device_type * device,uint8_t * ports,
+                                int length)
+{
+  std::vector<uint8_t> const& chain = native(device)->ports;
+
+  if(static_cast<std::size_t> (length) < chain.size())
+  {
+    return LIBUSB_ERROR_OVERFLOW;
+  }
+
+  std::copy(chain.begin(),chain.end(),ports);
+
+  return chain.size();
+}
+
+uint8_t sysfs_backend::device_address(device_type * device)
+{
+  return native(device)->address;
+}
+
+
+int sysfs_backend::device_descriptor(device_type * device,
+                                     libusb_device_descriptor & dev_desc)
+{
+  dev_desc = native(device)->device_descriptor;
+
+  return LIBUSB_SUCCESS;
+}
+
+int sysfs_backend::config_descriptor(device_type * device,
+                                     libusb_config_descriptor ** config_desc)
+{
+  // unconfigured devices have no active configuration
+  if(native(device)->config_descriptor.bConfigurationValue == 0)
+  {
+    return LIBUSB_ERROR_NOT_FOUND;
+  }
+
+  // storage is owned by the device, nothing to allocate
+  *config_desc = &(native(device)->config_descriptor);
+
+  return LIBUSB_SUCCESS;
+}
+
+void sysfs_backend::free_config_descriptor(libusb_config_descriptor *)
+{}
+
+
+int sysfs_backend::open(device_type * device,handle_type ** device_handle)
+{
+  *device_handle = reinterpret_cast<handle_type *> (native(device));
+
+  return LIBUSB_SUCCESS;
+}
+
+void sysfs_backend::close(handle_type *)
+{}
+
+
+int sysfs_backend::kernel_driver_active(handle_type * device_handle,
+                                        int interface_id)
+{
+  std::string path = interface_path(native(device_handle),interface_id);
+
+  if(path.empty()) return LIBUSB_ERROR_NOT_FOUND;
+
+
+  // unauthorized interfaces have no driver, authorized interfaces have one
+  // once it's probed
+  if(authorization_)
+  {
+    unsigned long authorized;
+
+    if(!read(path + "/authorized",10,authorized)) return LIBUSB_ERROR_IO;
+
+    if(authorized == 0) return 0;
+  }
+
+
+  // bound interfaces have a driver link
+  struct stat link_status;
+
+  ++syscalls_;
+
+  if(lstat((path + "/driver").c_str(),&link_status) == 0) return 1;
+
+  return errno == ENOENT ? 0 : LIBUSB_ERROR_IO;
+}
+
+int sysfs_backend::detach_kernel_driver(handle_type * device_handle,
+                                        int interface_id)
+{
+  std::string path = interface_path(native(device_handle),interface_id),
+              driver;
+
+  // the kernel unbinds the driver and binds none until authorization
+  if(authorization_ && !path.empty())
+  {
+    return write(path + "/authorized","0") ? LIBUSB_SUCCESS : LIBUSB_ERROR_IO;
+  }
+
+  if(path.empty() || !link(path + "/driver",driver))
+  {
+    return LIBUSB_ERROR_NOT_FOUND;
+  }
+
+
+  // the driver releases the interface
+  std::string name   = path.substr(path.find_last_of('/') + 1),
+              unbind = root_ + "/bus/usb/drivers/"
+                     + driver.substr(driver.find_last_of('/') + 1) + "/unbind";
+
+  return write(unbind,name) ? LIBUSB_SUCCESS : LIBUSB_ERROR_IO;
+}
+
+int sysfs_backend::attach_kernel_driver(handle_type * device_handle,
+                                        int interface_id)
+{
+  std::string path = interface_path(native(device_handle),interface_id),
+              driver;
+
+  if(path.empty()) return LIBUSB_ERROR_NOT_FOUND;
+
+  // authorizing an interface doesn't probe its drivers, the probe follows
+  if(authorization_ && !write(path + "/authorized","1")) return LIBUSB_ERROR_IO;
+
+  if(link(path + "/driver",driver)) return LIBUSB_ERROR_BUSY;
+
+
+  // the kernel binds a matching driver
+  std::string name = path.substr(path.find_last_of('/') + 1);
+
+  return write(root_ + "/bus/usb/drivers_probe",name) ?
+
+         LIBUSB_SUCCESS : LIBUSB_ERROR_IO;
+}
+
+
+int sysfs_backend::string_descriptor(handle_type * device_handle,
+                                     uint8_t index,
+                                     unsigned char * buffer,int length)
+{
+  sysfs_device * device = native(device_handle);
+
+  libusb_device_descriptor const& dev_desc = device->device_descriptor;
+
+  std::string attribute;
+
+  if(index == 0 || length <= 0) return LIBUSB_ERROR_INVALID_PARAM;
+
+  if(index == dev_desc.iManufacturer)      attribute = "manufacturer";
+  else if(index == dev_desc.iProduct)      attribute = "product";
+  else if(index == dev_desc.iSerialNumber) attribute = "serial";
+  else                                     return LIBUSB_ERROR_INVALID_PARAM;
+
+
+  std::string string_desc;
+
+  if(!read(devices_path_ + device->name + "/" + attribute,string_desc))
+  {
+    return LIBUSB_ERROR_IO;
+  }
+
+  // attributes end with a line feed
+  if(!string_desc.empty() && string_desc.back() == '\n') string_desc.pop_back();
+
+
+  int char_number = std::min(static_cast<int> (string_desc.size()),length - 1);
+
+  std::memcpy(buffer,string_desc.data(),char_number);
+
+  buffer[char_number] = '\0';
+
+  return char_number;
+}
+
+
+bool sysfs_backend::blocks_by_default() const
+{
+  return authorization_;
+}
+
+
+std::uint64_t sysfs_backend::syscalls() const
+{
+  return syscalls_.load();
+}
+
+
+sysfs_device * sysfs_backend::native(device_type * device)
+{
+  return reinterpret_cast<sysfs_device *> (device);
+}
+
+sysfs_device * sysfs_backend::native(handle_type * device_handle)
+{
+  return reinterpret_cast<sysfs_device *> (device_handle);
+}
+
+
+std::unique_ptr<sysfs_device> sysfs_backend::read_device(std::string const& name)
+{
+  std::unique_ptr<sysfs_device> device(new sysfs_device);
+
+  std::string   path = devices_path_ + name + "/",
+                devpath;
+  unsigned long value;
+
+  device->name = name;
+
+  // devices have a bus and device number, hubs and other entries don't
+  if(!read(path + "busnum",10,value)) return nullptr;
+
+  device->bus = value;
+
+  if(!read(path + "devnum",10,value)) return nullptr;
+
+  device->address = value;
+
+  // port chain "2.3", the port is the last one (root hubs have "0" and no
+  // port chain)
+  if(!read(path + "devpath",devpath)) return nullptr;
+
+  device->port = std::atoi(devpath.substr(devpath.find_last_of('.') + 1).c_str());
+
+  std::istringstream chain(devpath);
+
+  for(std::string port ; device->port != 0 && std::getline(chain,port,'.') ; )
+  {
+    device->ports.push_back(std::atoi(port.c_str()));
+  }
+
+
+  // unauthorized devices aren't configured, their interfaces stay
+  // unauthorized after the device is
+  if(authorization_ && read(path + "authorized",10,value) && value == 0)
+  {
+    write(path + "authorized","1");
+  }
+
+
+  // descriptors of every configuration, the active one is parsed, empty for
+  // unconfigured devices
+  unsigned long configuration = 0;
+
+  if(!read(path + "descriptors",device->descriptors)) return nullptr;
+
+  read(path + "bConfigurationValue",10,configuration);
+
+  if(!device->parse(configuration)) return nullptr;
+
+
+  // interface directories ("1-2.3:1.0") by interface number
+  std::vector<std::string> entries;
+
+  list(path,entries);
+
+  std::map<unsigned long,std::string> interface_names;
+
+  for(auto entry_it = entries.begin() ; entry_it != entries.end() ; ++entry_it)
+  {
+    if(entry_it->find(':') == std::string::npos) continue;
+
+    interface_names[std::strtoul(entry_it->c_str() +
+                                 entry_it->find_last_of('.') + 1,nullptr,10)]
+    = *entry_it;
+  }
+
+  for(auto intf_it  = device->settings.begin() ;
+           intf_it != device->settings.end()   ; ++intf_it)
+  {
+    device->interface_names.push_back(interface_names[intf_it->front()
+                                                      .bInterfaceNumber]);
+  }
+
+  device->wire();
+
+
+  return device;
+}
+
+
+bool sysfs_backend::lock_down()
+{
+  std::vector<std::string> entries;
+
+  if(!list(devices_path_,entries)) return false;
+
+
+  std::vector<std::string> hubs;
+
+  bool locked = true;
+
+  for(auto entry_it = entries.begin() ; locked && entry_it != entries.end() ;
+      ++entry_it)
+  {
+    if(entry_it->compare(0,3,"usb") != 0) continue;
+
+    hubs.push_back(devices_path_ + *entry_it + "/");
+
+    // interfaces first, devices authorized in between mustn't bind
+    locked = write(hubs.back() + "interface_authorized_default","0") &&
+             write(hubs.back() + "authorized_default","0");
+  }
+
+  // the caller falls back to detaching drivers, hubs locked already would
+  // configure no new device until reboot
+  for(auto hub_it = hubs.begin() ; !locked && hub_it != hubs.end() ; ++hub_it)
+  {
+    write(*hub_it + "authorized_default","1");
+    write(*hub_it + "interface_authorized_default","1");
+  }
+
+
+  return locked;
+}
+
+
+bool sysfs_backend::list(std::string const& path,
+                         std::vector<std::string> & entries)
+{
+  ++syscalls_;
+
+  int file_descriptor = ::open(path.c_str(),O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+
+  if(file_descriptor < 0) return false;
+
+
+  // getdents64 directly instead of readdir, the calls readdir makes aren't
+  // visible, every call is counted until the directory is empty
+  alignas(dirent_record) char buffer[8192];
+
+  for(;;)
+  {
+    ++syscalls_;
+
+    long length = syscall(SYS_getdents64,file_descriptor,buffer,sizeof(buffer));
+
+    if(length <= 0) break;
+
+    for(long offset = 0 ; offset < length ; )
+    {
+      dirent_record const* entry =
+
+      reinterpret_cast<dirent_record const*> (buffer + offset);
+
+      if(entry->name[0] != '.') entries.push_back(entry->name);
+
+      offset += entry->record_length;
+    }
+  }
+
+  ++syscalls_;
+
+  ::close(file_descriptor);
+
+  std::sort(entries.begin(),entries.end());
+
+
+  return true;
+}
+
+
+bool sysfs_backend::read(std::string const& path,std::string & content)
+{
+  ++syscalls_;
+
+  int file_descriptor = ::open(path.c_str(),O_RDONLY | O_CLOEXEC);
+
+  if(file_descriptor < 0) return false;
+
+
+  // attributes are at most one page, descriptors may be longer
+  char    buffer[4096];
+  ssize_t length;
+
+  content.clear();
+
+  do
+  {
+    ++syscalls_;
+
+    length = ::read(file_descriptor,buffer,sizeof(buffer));
+
+    if(length > 0) content.append(buffer,length);
+  }
+  while(length == sizeof(buffer));
+
+  ++syscalls_;
+
+  ::close(file_descriptor);
+
+  return length >= 0;
+}
+
+bool sysfs_backend::read(std::string const& path,int base,unsigned long & value)
+{
+  std::string content;
+
+  if(!read(path,content) || content.empty()) return false;
+
+
+  char * end;
+
+  value = std::strtoul(content.c_str(),&end,base);
+
+  return end != content.c_str();
+}
+
+bool sysfs_backend::write(std::string const& path,std::string const& content)
+{
+  ++syscalls_;
+
+  int file_descriptor = ::open(path.c_str(),O_WRONLY | O_CLOEXEC);
+
+  if(file_descriptor < 0) return false;
+
+
+  ++syscalls_;
+
+  ssize_t length = ::write(file_descriptor,content.data(),content.size());
+
+  ++syscalls_;
+
+  ::close(file_descriptor);
+
+  return length == static_cast<ssize_t> (content.size());
+}
+
+bool sysfs_backend::link(std::string const& path,std::string & target)
+{
+  char buffer[4096];
+
+  ++syscalls_;
+
+  ssize_t length = readlink(path.c_str(),buffer,sizeof(buffer));
+
+  if(length <= 0) return false;
+
+
+  target.assign(buffer,length);
+
+  return true;
+}
+
+
+std::string const sysfs_backend::interface_path(sysfs_device * device,
+                                                int interface_id) const
+{
+  // interfaces without a directory aren't bound to a driver
+  if(interface_id < 0 ||
+     static_cast<std::size_t> (interface_id) >= device->interface_names.size() ||
+     device->interface_names[interface_id].empty())
+  {
+    return std::string();
+  }
+
+  return devices_path_ + device->name + "/"
+       + device->interface_names[interface_id];
+}
+
+}
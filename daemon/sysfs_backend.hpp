@@ -0,0 +1,154 @@
+#ifndef GEMINI_SYSFS_BACKEND
+#define GEMINI_SYSFS_BACKEND
+
+
+// std
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+// gemini
+#include <device_backend.hpp>
+
+
+namespace gemini
+{
+
+// usb device read from sysfs, owns the storage the libusb structures point to
+struct sysfs_device
+{
+  sysfs_device();
+
+  sysfs_device(sysfs_device const&)              = delete;
+  sysfs_device & operator = (sysfs_device const&) = delete;
+
+  // device descriptor and the given configuration from the raw descriptors,
+  // extra descriptors point into them, returns false if they're truncated
+  bool parse(uint8_t configuration);
+
+  // connect the libusb structures, call after the storage is complete
+  void wire();
+
+
+  // name in the devices directory ("1-2.3", "usb1")
+  std::string                                           name;
+
+  uint8_t                                               bus,
+                                                        port,
+                                                        address;
+
+  // port chain from the root hub ("2.3" is 2, 3)
+  std::vector<uint8_t>                                  ports;
+
+  // descriptors attribute, the device descriptor and every configuration in
+  // their wire format
+  std::string                                           descriptors;
+
+  libusb_device_descriptor                              device_descriptor;
+  libusb_config_descriptor                              config_descriptor;
+
+  // interfaces, settings of every interface, endpoints of every setting
+  std::vector<libusb_interface>                         interfaces;
+  std::vector<std::vector<libusb_interface_descriptor> > settings;
+  std::vector<std::vector<libusb_endpoint_descriptor> >  endpoints;
+
+  // interface directory names ("1-2.3:1.0") by interface index
+  std::vector<std::string>                              interface_names;
+};
+
+
+// usb devices and kernel drivers through sysfs attributes, device files are
+// never opened: drivers are unbound (unbind) and probed (drivers_probe)
+// through the usb bus directory
+//
+// with authorization the root hubs authorize neither devices nor interfaces
+// by default, new devices are authorized (configured) at once, drivers are
+// detached by deauthorizing interfaces and attached by authorizing them and
+// probing their drivers (authorizing doesn't probe), so prohibited
+// interfaces never get a driver
+class sysfs_backend : public device_backend
+{
+  public :
+
+  // the root is "/sys" on a real system, tests use a synthetic tree
+  sysfs_backend(std::string const& root = "/sys",bool authorization = false);
+
+  int init();
+  int init_error() const;
+
+  // devices are parsed when they appear, known devices (same device number)
+  // cost one attribute read
+  ssize_t enumerate(std::vector<device_type *> & devices);
+
+  uint8_t bus_number(device_type * device);
+  uint8_t port_number(device_type * device);
+  int     port_numbers(device_type * device,uint8_t * ports,int length);
+  uint8_t device_address(device_type * device);
+
+  int  device_descriptor(device_type * device,
+                         libusb_device_descriptor & dev_desc);
+  int  config_descriptor(device_type * device,
+                         libusb_config_descriptor ** config_desc);
+  void free_config_descriptor(libusb_config_descriptor * config_desc);
+
+  // handles need no system call
+  int  open(device_type * device,handle_type ** device_handle);
+  void close(handle_type * device_handle);
+
+  int kernel_driver_active(handle_type * device_handle,int interface_id);
+  int detach_kernel_driver(handle_type * device_handle,int interface_id);
+  int attach_kernel_driver(handle_type * device_handle,int interface_id);
+
+  // manufacturer, product and serial attributes
+  int string_descriptor(handle_type * device_handle,uint8_t index,
+                        unsigned char * buffer,int length);
+
+
+  bool blocks_by_default() const;
+
+
+  // system calls since construction
+  std::uint64_t syscalls() const;
+
+
+  private :
+
+  static sysfs_device * native(device_type * device);
+  static sysfs_device * native(handle_type * device_handle);
+
+  // read a device from its directory, returns nullptr if it isn't a device
+  std::unique_ptr<sysfs_device> read_device(std::string const& name);
+
+  // directory entries, attribute contents and driver links, every system
+  // call is counted
+  bool list(std::string const& path,std::vector<std::string> & entries);
+  bool read(std::string const& path,std::string & content);
+  bool read(std::string const& path,int base,unsigned long & value);
+  bool write(std::string const& path,std::string const& content);
+  bool link(std::string const& path,std::string & target);
+
+  // interface directory of a device
+  std::string const interface_path(sysfs_device * device,int interface_id) const;
+
+  // nothing is authorized by default on every root hub, returns false and
+  // restores the defaults if the kernel can't authorize interfaces
+  bool lock_down();
+
+
+  std::string                                          root_,
+                                                       devices_path_;
+  int                                                  init_error_;
+  bool                                                 authorization_;
+
+  // devices of the latest enumeration by name
+  std::map<std::string,std::unique_ptr<sysfs_device> > devices_;
+
+  std::atomic<std::uint64_t>                           syscalls_;
+};
+
+}
+
+#endif // GEMINI_SYSFS_BACKEND
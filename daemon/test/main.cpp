@@ -0,0 +1,155 @@
+// posix
+#include <sys/socket.h>
+#include <unistd.h>
+
+// std
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// gemini
+#include <uevent_listener.hpp>
+
+
+namespace
+{
+  const std::string INTERFACE_PATH = "/devices/pci0000:00/0000:00:14.0/usb1/";
+
+
+  // kernel uevent "<action>@<devpath>\0ACTION=...\0DEVPATH=...\0..."
+  std::string uevent_message(std::string const& action,
+                             std::string const& devpath,
+                             std::string const& subsystem,
+                             std::string const& devtype)
+  {
+    std::string message = action + "@" + devpath;
+
+    message.push_back('\0');
+
+    for(std::string const& variable : {"ACTION=" + action,"DEVPATH=" + devpath,
+                                       "SUBSYSTEM=" + subsystem,
+                                       "DEVTYPE=" + devtype,
+                                       std::string("SEQNUM=4711")})
+    {
+      message += variable;
+      message.push_back('\0');
+    }
+
+    return message;
+  }
+
+
+  bool expect(bool condition,std::string const& what)
+  {
+    if(!condition) std::cout << "failed: " << what << std::endl;
+
+    return condition;
+  }
+
+  bool expect_event(std::vector<gemini::uevent> const& events,std::size_t index,
+                    std::string const& action,std::uint8_t bus,
+                    std::vector<std::uint8_t> const& ports,
+                    std::uint8_t interface_number)
+  {
+    std::string what = "event " + std::to_string(index);
+
+    if(!expect(index < events.size(),what + " received")) return false;
+
+
+    gemini::uevent const& event = events[index];
+
+    return expect(event.action == action,what + " action") &&
+           expect(event.bus == bus,what + " bus") &&
+           expect(event.ports == ports,what + " port chain") &&
+           expect(event.port == (ports.empty() ? 0 : ports.back()),
+                  what + " port") &&
+           expect(event.interface_number == interface_number,
+                  what + " interface number");
+  }
+
+
+  // uevent_listener on one end of a datagram socketpair, messages sent on
+  // the other end arrive like netlink messages
+  bool test_uevent_listener()
+  {
+    int sockets[2];
+
+    if(!expect(socketpair(AF_UNIX,SOCK_DGRAM,0,sockets) == 0,"socketpair"))
+    {
+      return false;
+    }
+
+    gemini::uevent_listener listener(sockets[0]);
+
+    std::string libudev_message("libudev");
+
+    libudev_message.push_back('\0');
+    libudev_message += "ACTION=bind";
+    libudev_message.push_back('\0');
+
+    std::vector<std::string> messages =
+    {
+      // interface behind a hub, added and bound
+      uevent_message("add",INTERFACE_PATH + "1-2/1-2.3/1-2.3:1.0","usb",
+                     "usb_interface"),
+      uevent_message("bind",INTERFACE_PATH + "1-2/1-2.3/1-2.3:1.0","usb",
+                     "usb_interface"),
+
+      // removals, devices and other subsystems aren't relevant
+      uevent_message("remove",INTERFACE_PATH + "1-2/1-2.3/1-2.3:1.0","usb",
+                     "usb_interface"),
+      uevent_message("bind",INTERFACE_PATH + "1-2/1-2.3","usb","usb_device"),
+      uevent_message("add",INTERFACE_PATH + "1-2/1-2.3/1-2.3:1.0/0003:046D:C52B.0001",
+                     "hid",""),
+      libudev_message,
+
+      // interface of a root hub and of a device on a root port
+      uevent_message("bind",INTERFACE_PATH + "1-0:1.0","usb","usb_interface"),
+      uevent_message("add","/devices/pci0000:00/0000:00:1d.0/usb3/3-1/3-1:1.2",
+                     "usb","usb_interface")
+    };
+
+    for(auto message_it = messages.begin() ; message_it != messages.end() ;
+        ++message_it)
+    {
+      send(sockets[1],message_it->data(),message_it->size(),0);
+    }
+
+
+    std::vector<gemini::uevent> events;
+
+    bool passed = expect(listener.receive(events) == 4,"relevant events");
+
+    passed = expect_event(events,0,"add",1,{2,3},0) && passed;
+    passed = expect_event(events,1,"bind",1,{2,3},0) && passed;
+    passed = expect_event(events,2,"bind",1,{},0) && passed;
+    passed = expect_event(events,3,"add",3,{1},2) && passed;
+
+    // the socket is drained, nothing is read twice
+    events.clear();
+
+    passed = expect(listener.receive(events) == 0 && events.empty(),
+                    "drained socket") && passed;
+
+    ::close(sockets[1]);
+
+
+    return passed;
+  }
+}
+
+
+int main(int,char **)
+{
+  bool passed = true;
+
+  std::cout << "uevent_listener" << std::endl;
+
+  passed = test_uevent_listener() && passed;
+
+  std::cout << (passed ? "passed" : "failed") << std::endl;
+
+
+  return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+}
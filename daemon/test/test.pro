@@ -0,0 +1,15 @@
+TARGET    = gemini_test
+
+TEMPLATE  = app
+
+CONFIG   += console
+CONFIG   += c++11
+CONFIG   -= app_bundle
+
+QT       += core
+QT       += network
+QT       -= gui
+
+SOURCES  += main.cpp
+
+include(../gemini_core.pri)
@@ -0,0 +1,123 @@
+// class
+#include <timer_wheel.hpp>
+
+
+namespace gemini
+{
+
+timer_wheel::timer_wheel(tick_type now) :
+now_(now),
+size_(0)
+{}
+
+
+void timer_wheel::schedule(tick_type deadline,std::size_t id)
+{
+  // the slot of now is done
+  if(deadline <= now_) deadline = now_ + 1;
+
+  insert(timer{deadline,id});
+
+  ++size_;
+}
+
+
+void timer_wheel::advance(tick_type now,std::vector<std::size_t> & expired)
+{
+  while(now_ < now)
+  {
+    // nothing to expire on the way
+    if(size_ == 0)
+    {
+      now_ = now;
+
+      break;
+    }
+
+    ++now_;
+
+
+    // a turn of the lower levels is over, higher levels first (their timers
+    // can land in the slot of a lower level coming up now)
+    unsigned short level = 1;
+
+    while(level < LEVELS &&
+          (now_ & ((tick_type(1) << (SLOT_BITS * level)) - 1)) == 0) ++level;
+
+    while(--level > 0) cascade(level);
+
+
+    std::vector<timer> & slot = slots_[0][now_ & (SLOTS - 1)];
+
+    for(auto timer_it = slot.begin() ; timer_it != slot.end() ; ++timer_it)
+    {
+      expired.push_back(timer_it->id);
+    }
+
+    size_ -= slot.size();
+
+    slot.clear();
+  }
+}
+
+
+void timer_wheel::clear(tick_type now)
+{
+  for(auto level_it = slots_.begin() ; level_it != slots_.end() ; ++level_it)
+  {
+    for(auto slot_it = level_it->begin() ; slot_it != level_it->end() ; ++slot_it)
+    {
+      slot_it->clear();
+    }
+  }
+
+  now_  = now;
+  size_ = 0;
+}
+
+
+timer_wheel::tick_type timer_wheel::now() const
+{
+  return now_;
+}
+
+std::size_t timer_wheel::size() const
+{
+  return size_;
+}
+
+
+// lowest level with the deadline within one turn
+void timer_wheel::insert(timer const& t)
+{
+  tick_type delta = t.deadline > now_ ? t.deadline - now_ : 0;
+
+  for(unsigned short level = 0 ; level < LEVELS ; ++level)
+  {
+    if(delta < (tick_type(1) << (SLOT_BITS * (level + 1))))
+    {
+      slots_[level][(t.deadline >> (SLOT_BITS * level)) & (SLOTS - 1)].push_back(t);
+
+      return;
+    }
+  }
+
+  // beyond the top level, the slot cascading last in this turn
+  const unsigned short top = LEVELS - 1;
+
+  slots_[top][((now_ >> (SLOT_BITS * top)) + SLOTS - 1) & (SLOTS - 1)].push_back(t);
+}
+
+void timer_wheel::cascade(unsigned short level)
+{
+  std::vector<timer> slot;
+
+  slot.swap(slots_[level][(now_ >> (SLOT_BITS * level)) & (SLOTS - 1)]);
+
+  for(auto timer_it = slot.begin() ; timer_it != slot.end() ; ++timer_it)
+  {
+    insert(*timer_it);
+  }
+}
+
+}
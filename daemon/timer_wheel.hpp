@@ -0,0 +1,68 @@
+#ifndef GEMINI_TIMER_WHEEL
+#define GEMINI_TIMER_WHEEL
+
+
+// std
+#include <array>
+#include <cstdint>
+#include <vector>
+
+
+namespace gemini
+{
+
+// hierarchical timer wheel, LEVELS wheels of SLOTS slots, a slot of a level
+// spans a whole turn of the level below, timers of a higher level cascade
+// down when their slot comes up, not thread safe
+class timer_wheel
+{
+  public :
+
+  typedef std::uint64_t tick_type;
+
+
+  timer_wheel(tick_type now = 0);
+
+  // timers at or before now expire with the next advance, deadlines beyond
+  // the top level wait in its last slot and cascade again
+  void schedule(tick_type deadline,std::size_t id);
+
+  // advance to now, appends the ids of expired timers in deadline order
+  void advance(tick_type now,std::vector<std::size_t> & expired);
+
+  // drop every timer and restart at now
+  void clear(tick_type now);
+
+  tick_type   now()  const;
+  std::size_t size() const;
+
+
+  static const unsigned short LEVELS    = 4,
+                              SLOT_BITS = 6,
+                              SLOTS     = 1 << SLOT_BITS;
+
+
+  private :
+
+  struct timer
+  {
+    tick_type   deadline;
+    std::size_t id;
+  };
+
+
+  void insert(timer const& t);
+
+  // timers of the level slot of now_ move to lower levels
+  void cascade(unsigned short level);
+
+
+  std::array<std::array<std::vector<timer>,SLOTS>,LEVELS> slots_;
+
+  tick_type   now_;
+  std::size_t size_;
+};
+
+}
+
+#endif // GEMINI_TIMER_WHEEL
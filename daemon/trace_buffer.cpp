@@ -0,0 +1,218 @@
+// std
+#include <fstream>
+#include <sstream>
+
+// posix
+#include <unistd.h>
+
+// class
+#include <trace_buffer.hpp>
+
+
+namespace gemini
+{
+
+trace_buffer & trace_buffer::instance()
+{
+  static trace_buffer buffer;
+
+  return buffer;
+}
+
+
+trace_buffer::trace_buffer() :
+epoch_(std::chrono::steady_clock::now()),
+dump_requested_(false)
+{}
+
+
+void trace_buffer::record(const char * name,std::uint64_t start,
+                          std::uint64_t duration,std::uint16_t device)
+{
+  ring * thread_events = thread_ring();
+
+  std::uint64_t head = thread_events->head.load(std::memory_order_relaxed);
+
+  slot & event_slot  = thread_events->entries[head % EVENT_NUMBER];
+
+
+  // readers skip the slot while it's written
+  event_slot.sequence.store(2 * head + 1,std::memory_order_relaxed);
+
+  std::atomic_thread_fence(std::memory_order_release);
+
+  event_slot.data.name     = name;
+  event_slot.data.start    = start;
+  event_slot.data.duration = duration;
+  event_slot.data.device   = device;
+
+  event_slot.sequence.store(2 * head + 2,std::memory_order_release);
+
+
+  thread_events->head.store(head + 1,std::memory_order_release);
+}
+
+
+std::uint64_t trace_buffer::now() const
+{
+  return std::chrono::duration_cast<std::chrono::nanoseconds>
+         (std::chrono::steady_clock::now() - epoch_).count();
+}
+
+
+std::string const trace_buffer::chrome_json() const
+{
+  std::ostringstream out;
+
+  bool first = true;
+
+
+  out << "{\"traceEvents\":[";
+
+  std::lock_guard<std::mutex> lock(rings_mutex_);
+
+  for(auto ring_it = rings_.begin() ; ring_it != rings_.end() ; ++ring_it)
+  {
+    ring const& thread_events = **ring_it;
+
+    std::uint64_t head  = thread_events.head.load(std::memory_order_acquire),
+                  first_event = head > EVENT_NUMBER ? head - EVENT_NUMBER : 0;
+
+
+    for(std::uint64_t index = first_event ; index < head ; ++index)
+    {
+      slot const& event_slot = thread_events.entries[index % EVENT_NUMBER];
+
+      std::uint64_t sequence = event_slot.sequence.load(std::memory_order_acquire);
+
+      event data = event_slot.data;
+
+      std::atomic_thread_fence(std::memory_order_acquire);
+
+
+      // event was overwritten while reading
+      if(sequence != 2 * index + 2 ||
+         event_slot.sequence.load(std::memory_order_relaxed) != sequence)
+      {
+        continue;
+      }
+
+
+      if(!first) out << ",";
+
+      first = false;
+
+      out << "{\"name\":\"" << data.name << "\",\"ph\":\"X\""
+          << ",\"ts\":"  << data.start / 1000.0
+          << ",\"dur\":" << data.duration / 1000.0
+          << ",\"pid\":" << getpid()
+          << ",\"tid\":" << thread_events.thread_id;
+
+      if(data.device != 0)
+      {
+        out << ",\"args\":{\"bus\":"  << (data.device >> 8)
+            << ",\"port\":"           << (data.device & 0xff) << "}";
+      }
+
+      out << "}";
+    }
+  }
+
+  out << "]}";
+
+
+  return out.str();
+}
+
+
+bool trace_buffer::dump(std::string const& path) const
+{
+  std::ofstream out(path,std::ofstream::out | std::ofstream::trunc);
+
+  if(!out.good()) return false;
+
+
+  out << chrome_json();
+
+  return out.good();
+}
+
+
+void trace_buffer::request_dump()
+{
+  dump_requested_.store(true,std::memory_order_relaxed);
+}
+
+bool trace_buffer::dump_requested()
+{
+  return dump_requested_.exchange(false,std::memory_order_relaxed);
+}
+
+
+trace_buffer::ring_owner::~ring_owner()
+{
+  if(owned) owned->used.store(false,std::memory_order_release);
+}
+
+
+// ring of the calling thread, taken on its first event
+trace_buffer::ring * trace_buffer::thread_ring()
+{
+  thread_local ring_owner owner = {nullptr};
+
+  if(owner.owned) return owner.owned;
+
+
+  std::lock_guard<std::mutex> lock(rings_mutex_);
+
+  // reuse the ring of a finished thread, its events stay until overwritten
+  for(auto ring_it = rings_.begin() ; ring_it != rings_.end() ; ++ring_it)
+  {
+    if(!(*ring_it)->used.load(std::memory_order_acquire))
+    {
+      (*ring_it)->used.store(true,std::memory_order_relaxed);
+
+      owner.owned = ring_it->get();
+
+      return owner.owned;
+    }
+  }
+
+
+  std::unique_ptr<ring> thread_events(new ring());
+
+  for(auto slot_it = thread_events->entries.begin() ;
+           slot_it != thread_events->entries.end()   ; ++slot_it)
+  {
+    slot_it->sequence.store(0,std::memory_order_relaxed);
+  }
+
+  thread_events->head.store(0,std::memory_order_relaxed);
+  thread_events->used.store(true,std::memory_order_relaxed);
+  thread_events->thread_id = rings_.size() + 1;
+
+
+  owner.owned = thread_events.get();
+
+  rings_.push_back(std::move(thread_events));
+
+
+  return owner.owned;
+}
+
+
+
+trace_scope::trace_scope(const char * name,std::uint16_t device) :
+name_(name),
+device_(device),
+start_(trace_buffer::instance().now())
+{}
+
+trace_scope::~trace_scope()
+{
+  trace_buffer & buffer = trace_buffer::instance();
+
+  buffer.record(name_,start_,buffer.now() - start_,device_);
+}
+
+}
@@ -0,0 +1,121 @@
+#ifndef GEMINI_TRACE_BUFFER
+#define GEMINI_TRACE_BUFFER
+
+
+// std
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+
+namespace gemini
+{
+
+// always on trace of the daemon, every thread writes into its own fixed size
+// ring buffer without locks, a dump reads the rings of every thread
+class trace_buffer
+{
+  public :
+
+  // events per thread
+  static const std::size_t EVENT_NUMBER = 4096;
+
+  static trace_buffer & instance();
+
+  trace_buffer(trace_buffer const&)              = delete;
+  trace_buffer & operator = (trace_buffer const&) = delete;
+
+  // name has to be a string literal, device is (bus << 8 | port), 0 without
+  // device, times in nanoseconds since start of the trace
+  void record(const char * name,std::uint64_t start,std::uint64_t duration,
+              std::uint16_t device);
+
+  std::uint64_t now() const;
+
+  // chrome trace event json of every event in the rings
+  std::string const chrome_json() const;
+
+  bool dump(std::string const& path) const;
+
+  // async signal safe, the event loop dumps the trace later
+  void request_dump();
+  bool dump_requested();
+
+
+  private :
+
+  trace_buffer();
+
+  struct event
+  {
+    const char *  name;
+    std::uint64_t start,
+                  duration;
+    std::uint16_t device;
+  };
+
+  // odd sequence while the owner writes the event
+  struct slot
+  {
+    std::atomic<std::uint64_t> sequence;
+    event                      data;
+  };
+
+  struct ring
+  {
+    std::array<slot,EVENT_NUMBER> entries;
+    std::atomic<std::uint64_t>    head;
+
+    // owned by a running thread, rings of finished threads are reused
+    std::atomic<bool>             used;
+    unsigned short                thread_id;
+  };
+
+  // frees the ring of a thread on thread exit
+  struct ring_owner
+  {
+    ~ring_owner();
+
+    ring * owned;
+  };
+
+
+  ring * thread_ring();
+
+
+  std::vector<std::unique_ptr<ring> > rings_;
+  mutable std::mutex                  rings_mutex_;
+
+  std::chrono::steady_clock::time_point epoch_;
+
+  std::atomic<bool>                   dump_requested_;
+};
+
+
+// records the duration of a scope
+class trace_scope
+{
+  public :
+
+  trace_scope(const char * name,std::uint16_t device = 0);
+  ~trace_scope();
+
+  trace_scope(trace_scope const&)              = delete;
+  trace_scope & operator = (trace_scope const&) = delete;
+
+
+  private :
+
+  const char *  name_;
+  std::uint16_t device_;
+  std::uint64_t start_;
+};
+
+}
+
+#endif // GEMINI_TRACE_BUFFER
@@ -0,0 +1,194 @@
+// posix
+#include <fcntl.h>
+#include <linux/netlink.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+// std
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+// class
+#include <uevent_listener.hpp>
+
+
+namespace gemini
+{
+
+const std::size_t uevent_listener::MESSAGE_SIZE = 8192;
+
+
+uevent_listener::uevent_listener(int socket) :
+socket_(socket),
+netlink_(socket < 0)
+{
+  if(netlink_)
+  {
+    socket_ = ::socket(AF_NETLINK,SOCK_DGRAM | SOCK_CLOEXEC,
+                       NETLINK_KOBJECT_UEVENT);
+
+    sockaddr_nl address;
+
+    std::memset(&address,0,sizeof(address));
+
+    address.nl_family = AF_NETLINK;
+    address.nl_pid    = 0;
+    // kernel events, udev rebroadcasts them on group 2
+    address.nl_groups = 1;
+
+    if(socket_ >= 0 &&
+       bind(socket_,reinterpret_cast<sockaddr *> (&address),sizeof(address)) != 0)
+    {
+      ::close(socket_);
+
+      socket_ = -1;
+    }
+  }
+
+  // the event loop mustn't block on an empty socket
+  if(socket_ >= 0)
+  {
+    fcntl(socket_,F_SETFL,fcntl(socket_,F_GETFL) | O_NONBLOCK);
+  }
+}
+
+uevent_listener::~uevent_listener()
+{
+  if(socket_ >= 0) ::close(socket_);
+}
+
+
+bool uevent_listener::valid() const
+{
+  return socket_ >= 0;
+}
+
+int uevent_listener::socket() const
+{
+  return socket_;
+}
+
+
+std::size_t uevent_listener::receive(std::vector<uevent> & events)
+{
+  std::size_t relevant = 0;
+
+  if(!valid()) return relevant;
+
+
+  std::vector<char> message(MESSAGE_SIZE);
+
+  for(;;)
+  {
+    sockaddr_nl sender;
+    socklen_t   sender_length = sizeof(sender);
+
+    std::memset(&sender,0,sizeof(sender));
+
+    ssize_t length = recvfrom(socket_,message.data(),message.size(),0,
+                              reinterpret_cast<sockaddr *> (&sender),
+                              &sender_length);
+
+    if(length <= 0) break;
+
+    // netlink messages of user space processes could fake driver events
+    if(netlink_ && sender.nl_pid != 0) continue;
+
+
+    uevent event;
+
+    if(parse(message.data(),length,event))
+    {
+      events.push_back(event);
+
+      ++relevant;
+    }
+  }
+
+
+  return relevant;
+}
+
+
+bool uevent_listener::parse(char const* message,std::size_t length,
+                            uevent & event)
+{
+  std::string action,
+              subsystem,
+              devtype,
+              devpath;
+
+  std::size_t position = 0;
+
+  // header "<action>@<devpath>", libudev messages have no '@'
+  {
+    std::string header(message,strnlen(message,length));
+
+    if(header.find('@') == std::string::npos) return false;
+
+    position = header.size() + 1;
+  }
+
+  // environment of the event
+  while(position < length)
+  {
+    std::string variable(message + position,strnlen(message + position,
+                                                    length - position));
+
+    position += variable.size() + 1;
+
+    std::size_t separator = variable.find('=');
+
+    if(separator == std::string::npos) continue;
+
+
+    std::string key   = variable.substr(0,separator),
+                value = variable.substr(separator + 1);
+
+    if(key == "ACTION")         action    = value;
+    else if(key == "SUBSYSTEM") subsystem = value;
+    else if(key == "DEVTYPE")   devtype   = value;
+    else if(key == "DEVPATH")   devpath   = value;
+  }
+
+
+  if((action != "bind" && action != "add") ||
+     subsystem != "usb" || devtype != "usb_interface") return false;
+
+
+  // interface name "<bus>-<port>.<port>...:<config>.<interface>"
+  std::string name = devpath.substr(devpath.find_last_of('/') + 1);
+
+  std::size_t dash  = name.find('-'),
+              colon = name.find(':',dash),
+              dot   = name.find('.',colon);
+
+  if(dash == std::string::npos || colon == std::string::npos ||
+     dot  == std::string::npos) return false;
+
+  std::string ports = name.substr(dash + 1,colon - dash - 1);
+
+  event.action           = action;
+  event.bus              = std::atoi(name.substr(0,dash).c_str());
+  event.port             = std::atoi(ports.substr(ports.find_last_of('.') + 1)
+                                     .c_str());
+  event.interface_number = std::atoi(name.substr(dot + 1).c_str());
+
+  event.ports.clear();
+
+  // root hubs ("1-0:1.0") have no port chain
+  for(std::size_t first = 0 ; ports != "0" && first <= ports.size() ; )
+  {
+    std::size_t last = std::min(ports.find('.',first),ports.size());
+
+    event.ports.push_back(std::atoi(ports.substr(first,last - first).c_str()));
+
+    first = last + 1;
+  }
+
+
+  return true;
+}
+
+}
@@ -0,0 +1,69 @@
+#ifndef GEMINI_UEVENT_LISTENER
+#define GEMINI_UEVENT_LISTENER
+
+
+// std
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+
+namespace gemini
+{
+
+// kernel event of an usb interface, ports is the port chain from the root
+// hub like libusb_get_port_numbers, the port is the last one like
+// libusb_get_port_number
+struct uevent
+{
+  std::string               action;
+
+  std::uint8_t              bus,
+                            port,
+                            interface_number;
+
+  std::vector<std::uint8_t> ports;
+};
+
+
+// kernel uevents (NETLINK_KOBJECT_UEVENT) of usb interfaces getting a driver
+// (bind) or appearing (add)
+class uevent_listener
+{
+  public :
+
+  // without socket a netlink socket is opened, a given socket (one end of a
+  // socketpair in tests) is taken over and reads raw uevent messages
+  uevent_listener(int socket = -1);
+  ~uevent_listener();
+
+  uevent_listener(uevent_listener const&)              = delete;
+  uevent_listener & operator = (uevent_listener const&) = delete;
+
+  bool valid() const;
+
+  // non blocking socket for the event loop
+  int socket() const;
+
+  // read every waiting message, returns the number of relevant events
+  std::size_t receive(std::vector<uevent> & events);
+
+  // "<action>@<devpath>\0KEY=VALUE\0...", returns false if the message isn't
+  // a bind or add of an usb interface
+  static bool parse(char const* message,std::size_t length,uevent & event);
+
+
+  private :
+
+  static const std::size_t MESSAGE_SIZE;
+
+  int  socket_;
+
+  // messages on own netlink socket are accepted from the kernel only
+  bool netlink_;
+};
+
+}
+
+#endif // GEMINI_UEVENT_LISTENER
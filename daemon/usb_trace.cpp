@@ -0,0 +1,343 @@
+// std
+#include <cstring>
+
+// class
+#include <usb_trace.hpp>
+
+
+namespace gemini
+{
+
+namespace
+{
+  // little endian serialization of unsigned values
+  template<typename T>
+  void put(std::string & buffer,T value)
+  {
+    for(unsigned short byte = 0 ; byte < sizeof(T) ; ++byte)
+    {
+      buffer += static_cast<char> ((value >> (8 * byte)) & 0xff);
+    }
+  }
+
+  template<typename T>
+  bool get(std::string const& buffer,std::size_t & offset,T & value)
+  {
+    if(offset + sizeof(T) > buffer.size()) return false;
+
+    value = 0;
+
+    for(unsigned short byte = 0 ; byte < sizeof(T) ; ++byte)
+    {
+      value |= static_cast<T> (static_cast<unsigned char>
+
+                               (buffer[offset + byte])) << (8 * byte);
+    }
+
+    offset += sizeof(T);
+
+    return true;
+  }
+}
+
+
+const std::uint32_t usb_trace::MAGIC   = 0x47545243; // "GTRC"
+const std::uint16_t usb_trace::VERSION = 1;
+
+
+trace_record::trace_record() :
+type(TRACE_UNDEFINED),
+device(0),
+time(0),
+duration(0),
+result(0),
+argument(0)
+{}
+
+
+bool usb_trace::create(std::string const& path)
+{
+  out_.open(path,std::ofstream::out | std::ofstream::trunc |
+                 std::ofstream::binary);
+
+  if(!out_.good()) return false;
+
+
+  std::string header;
+
+  put(header,MAGIC);
+  put(header,VERSION);
+
+  out_.write(header.data(),header.size());
+
+
+  return out_.good();
+}
+
+bool usb_trace::open(std::string const& path)
+{
+  in_.open(path,std::ifstream::in | std::ifstream::binary);
+
+  if(!in_.is_open()) return false;
+
+
+  std::string header(sizeof(MAGIC) + sizeof(VERSION),'\0');
+
+  in_.read(&header[0],header.size());
+
+
+  std::size_t   offset = 0;
+  std::uint32_t magic  = 0;
+  std::uint16_t version = 0;
+
+  return in_.good()                    &&
+         get(header,offset,magic)      && magic   == MAGIC &&
+         get(header,offset,version)    && version == VERSION;
+}
+
+void usb_trace::close()
+{
+  if(out_.is_open()) out_.close();
+  if(in_.is_open())  in_.close();
+}
+
+
+void usb_trace::write(trace_record const& record)
+{
+  std::string buffer;
+
+  buffer.reserve(27 + record.payload.size());
+
+  put(buffer,record.type);
+  put(buffer,record.device);
+  put(buffer,record.time);
+  put(buffer,record.duration);
+  put(buffer,static_cast<std::uint32_t> (record.result));
+  put(buffer,static_cast<std::uint32_t> (record.argument));
+  put(buffer,static_cast<std::uint16_t> (record.payload.size()));
+
+  buffer += record.payload;
+
+
+  out_.write(buffer.data(),buffer.size());
+}
+
+void usb_trace::flush()
+{
+  out_.flush();
+}
+
+bool usb_trace::read(trace_record & record)
+{
+  // fixed part of a record
+  std::string buffer(27,'\0');
+
+  in_.read(&buffer[0],buffer.size());
+
+  if(!in_.good()) return false;
+
+
+  std::size_t   offset = 0;
+  std::uint32_t result,
+                argument;
+  std::uint16_t payload_size;
+
+  get(buffer,offset,record.type);
+  get(buffer,offset,record.device);
+  get(buffer,offset,record.time);
+  get(buffer,offset,record.duration);
+  get(buffer,offset,result);
+  get(buffer,offset,argument);
+  get(buffer,offset,payload_size);
+
+  record.result   = static_cast<std::int32_t> (result);
+  record.argument = static_cast<std::int32_t> (argument);
+
+
+  record.payload.assign(payload_size,'\0');
+
+  if(payload_size > 0) in_.read(&record.payload[0],payload_size);
+
+
+  return in_.good();
+}
+
+
+std::string const usb_trace::encode(uint8_t bus,uint8_t port,
+                                    libusb_device_descriptor const& dev_desc)
+{
+  std::string payload;
+
+  put(payload,bus);
+  put(payload,port);
+
+  put(payload,dev_desc.bLength);
+  put(payload,dev_desc.bDescriptorType);
+  put(payload,dev_desc.bcdUSB);
+  put(payload,dev_desc.bDeviceClass);
+  put(payload,dev_desc.bDeviceSubClass);
+  put(payload,dev_desc.bDeviceProtocol);
+  put(payload,dev_desc.bMaxPacketSize0);
+  put(payload,dev_desc.idVendor);
+  put(payload,dev_desc.idProduct);
+  put(payload,dev_desc.bcdDevice);
+  put(payload,dev_desc.iManufacturer);
+  put(payload,dev_desc.iProduct);
+  put(payload,dev_desc.iSerialNumber);
+  put(payload,dev_desc.bNumConfigurations);
+
+  return payload;
+}
+
+std::string const usb_trace::encode(libusb_config_descriptor const& config_desc)
+{
+  std::string payload;
+
+  put(payload,config_desc.bNumInterfaces);
+  put(payload,config_desc.bConfigurationValue);
+  put(payload,config_desc.bmAttributes);
+  put(payload,config_desc.MaxPower);
+
+  for(uint8_t intf = 0 ; intf < config_desc.bNumInterfaces ; ++intf)
+  {
+    libusb_interface const& interface = config_desc.interface[intf];
+
+    put(payload,static_cast<uint8_t> (interface.num_altsetting));
+
+    for(int setting = 0 ; setting < interface.num_altsetting ; ++setting)
+    {
+      libusb_interface_descriptor const& intf_desc = interface.altsetting[setting];
+
+      put(payload,intf_desc.bInterfaceNumber);
+      put(payload,intf_desc.bAlternateSetting);
+      put(payload,intf_desc.bInterfaceClass);
+      put(payload,intf_desc.bInterfaceSubClass);
+      put(payload,intf_desc.bInterfaceProtocol);
+      put(payload,intf_desc.iInterface);
+      put(payload,intf_desc.bNumEndpoints);
+
+      for(uint8_t endpoint = 0 ; endpoint < intf_desc.bNumEndpoints ; ++endpoint)
+      {
+        libusb_endpoint_descriptor const& endpoint_desc =
+
+        intf_desc.endpoint[endpoint];
+
+        put(payload,endpoint_desc.bEndpointAddress);
+        put(payload,endpoint_desc.bmAttributes);
+        put(payload,endpoint_desc.wMaxPacketSize);
+        put(payload,endpoint_desc.bInterval);
+      }
+    }
+  }
+
+  return payload;
+}
+
+
+bool usb_trace::decode_device(std::string const& payload,
+                              simulated_device & device)
+{
+  std::size_t offset = 0;
+
+  libusb_device_descriptor & dev_desc = device.device_descriptor;
+
+  return get(payload,offset,device.bus)                  &&
+         get(payload,offset,device.port)                 &&
+         get(payload,offset,dev_desc.bLength)            &&
+         get(payload,offset,dev_desc.bDescriptorType)    &&
+         get(payload,offset,dev_desc.bcdUSB)             &&
+         get(payload,offset,dev_desc.bDeviceClass)       &&
+         get(payload,offset,dev_desc.bDeviceSubClass)    &&
+         get(payload,offset,dev_desc.bDeviceProtocol)    &&
+         get(payload,offset,dev_desc.bMaxPacketSize0)    &&
+         get(payload,offset,dev_desc.idVendor)           &&
+         get(payload,offset,dev_desc.idProduct)          &&
+         get(payload,offset,dev_desc.bcdDevice)          &&
+         get(payload,offset,dev_desc.iManufacturer)      &&
+         get(payload,offset,dev_desc.iProduct)           &&
+         get(payload,offset,dev_desc.iSerialNumber)      &&
+         get(payload,offset,dev_desc.bNumConfigurations);
+}
+
+bool usb_trace::decode_config(std::string const& payload,
+                              simulated_device & device)
+{
+  std::size_t offset = 0;
+
+  uint8_t interface_number;
+
+  libusb_config_descriptor & config_desc = device.config_descriptor;
+
+  if(!get(payload,offset,interface_number)                ||
+     !get(payload,offset,config_desc.bConfigurationValue) ||
+     !get(payload,offset,config_desc.bmAttributes)        ||
+     !get(payload,offset,config_desc.MaxPower)             )
+  {
+    return false;
+  }
+
+
+  device.settings.assign(interface_number,
+                         std::vector<libusb_interface_descriptor>());
+  device.endpoints.clear();
+
+  for(uint8_t intf = 0 ; intf < interface_number ; ++intf)
+  {
+    uint8_t setting_number;
+
+    if(!get(payload,offset,setting_number)) return false;
+
+
+    for(uint8_t setting = 0 ; setting < setting_number ; ++setting)
+    {
+      libusb_interface_descriptor intf_desc;
+
+      std::memset(&intf_desc,0,sizeof(intf_desc));
+
+      intf_desc.bLength         = LIBUSB_DT_INTERFACE_SIZE;
+      intf_desc.bDescriptorType = LIBUSB_DT_INTERFACE;
+
+      if(!get(payload,offset,intf_desc.bInterfaceNumber)   ||
+         !get(payload,offset,intf_desc.bAlternateSetting)  ||
+         !get(payload,offset,intf_desc.bInterfaceClass)    ||
+         !get(payload,offset,intf_desc.bInterfaceSubClass) ||
+         !get(payload,offset,intf_desc.bInterfaceProtocol) ||
+         !get(payload,offset,intf_desc.iInterface)         ||
+         !get(payload,offset,intf_desc.bNumEndpoints)       )
+      {
+        return false;
+      }
+
+
+      std::vector<libusb_endpoint_descriptor> setting_endpoints;
+
+      for(uint8_t endpoint = 0 ; endpoint < intf_desc.bNumEndpoints ; ++endpoint)
+      {
+        libusb_endpoint_descriptor endpoint_desc;
+
+        std::memset(&endpoint_desc,0,sizeof(endpoint_desc));
+
+        endpoint_desc.bLength         = LIBUSB_DT_ENDPOINT_SIZE;
+        endpoint_desc.bDescriptorType = LIBUSB_DT_ENDPOINT;
+
+        if(!get(payload,offset,endpoint_desc.bEndpointAddress) ||
+           !get(payload,offset,endpoint_desc.bmAttributes)     ||
+           !get(payload,offset,endpoint_desc.wMaxPacketSize)   ||
+           !get(payload,offset,endpoint_desc.bInterval)         )
+        {
+          return false;
+        }
+
+        setting_endpoints.push_back(endpoint_desc);
+      }
+
+      device.settings[intf].push_back(intf_desc);
+      device.endpoints.push_back(setting_endpoints);
+    }
+  }
+
+
+  return true;
+}
+
+}
@@ -0,0 +1,86 @@
+#ifndef GEMINI_USB_TRACE
+#define GEMINI_USB_TRACE
+
+
+// std
+#include <cstdint>
+#include <fstream>
+#include <string>
+
+// gemini
+#include <simulated_backend.hpp>
+
+
+namespace gemini
+{
+
+// observed backend operations
+enum trace_type{TRACE_ENUMERATE,TRACE_DEVICE,TRACE_CONFIG,TRACE_OPEN,
+                TRACE_DRIVER_ACTIVE,TRACE_DETACH,TRACE_ATTACH,TRACE_STRING,
+                TRACE_UNDEFINED};
+
+// one backend operation, device is the index in the latest enumeration
+struct trace_record
+{
+  trace_record();
+
+  std::uint8_t  type;
+  std::uint32_t device;
+
+  // start since trace begin and duration of the operation (microseconds)
+  std::uint64_t time;
+  std::uint32_t duration;
+
+  std::int32_t  result,
+                argument;
+
+  // type specific data (descriptors, strings)
+  std::string   payload;
+};
+
+
+// binary trace file
+class usb_trace
+{
+  public :
+
+  // write records to a new trace file
+  bool create(std::string const& path);
+  // read records of an existing trace file
+  bool open(std::string const& path);
+
+  void close();
+
+  void write(trace_record const& record);
+  bool read(trace_record & record);
+
+  // write buffered records to disk
+  void flush();
+
+
+  // payload of device records (address and device descriptor)
+  static std::string const encode(uint8_t bus,uint8_t port,
+                                  libusb_device_descriptor const& dev_desc);
+  // payload of config records (interfaces, settings and endpoints)
+  static std::string const encode(libusb_config_descriptor const& config_desc);
+
+  // restore descriptors of a device record
+  static bool decode_device(std::string const& payload,
+                            simulated_device & device);
+  // restore interfaces of a config record
+  static bool decode_config(std::string const& payload,
+                            simulated_device & device);
+
+
+  private :
+
+  static const std::uint32_t MAGIC;
+  static const std::uint16_t VERSION;
+
+  std::ofstream out_;
+  std::ifstream in_;
+};
+
+}
+
+#endif // GEMINI_USB_TRACE
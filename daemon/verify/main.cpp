@@ -0,0 +1,509 @@
+// std
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <vector>
+
+// gemini
+#include <rule_set.hpp>
+
+
+namespace
+{
+  // field values of generated rules and descriptors stay small, so rules
+  // actually match and overlap, descriptors hold 0 and the largest value too
+  const gemini::descriptor::value_type VALUE_RANGE     = 6,
+                                       MINUTES_PER_DAY = 24 * 60;
+
+  // fingerprints of pins and devices
+  const std::uint64_t FINGERPRINTS[] = {0x8f3a51c0d2e47b16,0x1d,
+                                        0xffffffffffffffff};
+
+  enum engine_type{REFERENCE,INDEX,DECIDE,REORDERED,OPTIMIZED,ENGINE_NUMBER};
+
+  const char * ENGINE_NAMES[] = {"reference","index","decide","reordered",
+                                 "optimized"};
+
+
+  // device interface and the fingerprint of its device
+  struct device_sample
+  {
+    gemini::descriptor desc;
+    std::uint64_t      fingerprint;
+  };
+
+  // decisions and time of an engine
+  struct engine_counter
+  {
+    std::uint64_t decisions;
+    double        seconds;
+  };
+
+  struct options
+  {
+    std::uint64_t  seed;
+    unsigned int   rounds,
+                   max_rules,
+                   samples,
+                   steps,
+                   report;
+  };
+
+
+  std::uint64_t pick_fingerprint(std::mt19937_64 & random)
+  {
+    return FINGERPRINTS[std::uniform_int_distribution<std::size_t>
+
+                        (0,sizeof(FINGERPRINTS) / sizeof(FINGERPRINTS[0]) - 1)
+                        (random)];
+  }
+
+  // 0, a small value or the largest value
+  gemini::descriptor::value_type random_value(std::mt19937_64 & random)
+  {
+    unsigned int kind = std::uniform_int_distribution<unsigned int>(0,15)(random);
+
+    if(kind == 0)  return MASKED;
+    if(kind == 1)  return ~gemini::descriptor::value_type(0);
+
+    return std::uniform_int_distribution<gemini::descriptor::value_type>
+
+           (1,VALUE_RANGE)(random);
+  }
+
+  // sorted, disjoint ranges below bound, starting at 0 at times (an exact
+  // 0 matches only 0 in a set, "0-0")
+  gemini::value_set random_set(std::mt19937_64 & random,
+                               gemini::descriptor::value_type bound)
+  {
+    gemini::value_set set;
+
+    typedef gemini::descriptor::value_type value_type;
+
+    std::uniform_int_distribution<value_type> step(0,bound / 3);
+
+    value_type first = std::bernoulli_distribution(0.3)(random) ?
+
+                       0 : step(random);
+
+    unsigned int range_number =
+
+    std::uniform_int_distribution<unsigned int>(1,3)(random);
+
+    for(unsigned int range = 0 ; range < range_number && first < bound ; ++range)
+    {
+      value_type last = std::min(bound - 1,first + step(random));
+
+      set.push_back(gemini::value_range{first,last});
+
+      first = last + 2 + step(random);
+    }
+
+    return set;
+  }
+
+  // pins, all-masked rules, exact and ranged rules (some of them scheduled)
+  // and contradicting copies of earlier rules
+  gemini::rule random_rule(std::mt19937_64 & random,
+                           std::vector<gemini::rule> const& rules)
+  {
+    bool permission = std::bernoulli_distribution(0.5)(random);
+
+    unsigned int kind = std::uniform_int_distribution<unsigned int>(0,9)(random);
+
+    if(kind == 0) return gemini::rule(pick_fingerprint(random),permission);
+
+    if(kind == 1) return gemini::rule(gemini::descriptor(),permission);
+
+    if(kind == 2 && !rules.empty())
+    {
+      gemini::rule const& shadowed = rules[std::uniform_int_distribution
+
+                                           <std::size_t>(0,rules.size() - 1)
+                                           (random)];
+
+      if(shadowed.fingerprint() != 0)
+      {
+        return gemini::rule(shadowed.fingerprint(),!shadowed.permission());
+      }
+
+      std::array<gemini::value_set,DESCRIPTOR_SIZE> values;
+
+      for(unsigned short index = BUS ; index != UNDEFINED ; ++index)
+      {
+        values[index] = shadowed.values(index);
+      }
+
+      return gemini::rule(values,!shadowed.permission(),shadowed.schedule());
+    }
+
+
+    double mask_density = std::generate_canonical<double,32>(random);
+
+    std::array<gemini::value_set,DESCRIPTOR_SIZE> values;
+
+    for(unsigned short index = BUS ; index != UNDEFINED ; ++index)
+    {
+      if(std::generate_canonical<double,32>(random) < mask_density) continue;
+
+      if(kind < 6)
+      {
+        gemini::descriptor::value_type value =
+
+        std::uniform_int_distribution<gemini::descriptor::value_type>
+
+        (1,VALUE_RANGE)(random);
+
+        values[index].push_back(gemini::value_range{value,value});
+      }
+
+      else values[index] = random_set(random,VALUE_RANGE + 1);
+    }
+
+    gemini::value_set schedule;
+
+    if(kind == 9) schedule = random_set(random,MINUTES_PER_DAY);
+
+    return gemini::rule(values,permission,schedule);
+  }
+
+  device_sample random_sample(std::mt19937_64 & random)
+  {
+    device_sample sample;
+
+    for(unsigned short index = BUS ; index != UNDEFINED ; ++index)
+    {
+      sample.desc[index] = random_value(random);
+    }
+
+    sample.fingerprint = std::bernoulli_distribution(0.5)(random) ?
+
+                         pick_fingerprint(random) : 0;
+
+    return sample;
+  }
+
+
+  std::string const sample_info(device_sample const& sample)
+  {
+    std::ostringstream info;
+
+    for(unsigned short index = BUS ; index != UNDEFINED ; ++index)
+    {
+      info << (index == BUS ? "" : " ") << sample.desc[index];
+    }
+
+    info << " FINGERPRINT 0x" << std::hex << sample.fingerprint;
+
+    return info.str();
+  }
+
+  std::string const position_info(std::size_t position)
+  {
+    return position == gemini::rule_index::NO_MATCH ?
+
+           std::string("-") : std::to_string(position);
+  }
+
+
+  // decisions of an engine over every sample, checked against the
+  // reference, returns false at the first divergence
+  template<typename Engine>
+  bool verify(engine_type engine,std::vector<device_sample> const& samples,
+              std::vector<char> const& permissions,
+              std::vector<std::size_t> const& positions,bool check_position,
+              engine_counter & counter,Engine decide,
+              std::ostream & divergence)
+  {
+    std::vector<char>        engine_permissions(samples.size());
+    std::vector<std::size_t> engine_positions(samples.size());
+
+    auto start = std::chrono::steady_clock::now();
+
+    for(std::size_t index = 0 ; index < samples.size() ; ++index)
+    {
+      engine_permissions[index] = decide(samples[index],
+                                         engine_positions[index]);
+    }
+
+    counter.seconds   += std::chrono::duration<double>
+
+                         (std::chrono::steady_clock::now() - start).count();
+    counter.decisions += samples.size();
+
+
+    for(std::size_t index = 0 ; index < samples.size() ; ++index)
+    {
+      if(engine_permissions[index] == permissions[index] &&
+         (!check_position || engine_positions[index] == positions[index]))
+      {
+        continue;
+      }
+
+      divergence << ENGINE_NAMES[engine] << " diverges on "
+                 << sample_info(samples[index]) << std::endl
+                 << "  reference: permission " << int(permissions[index])
+                 << " rule " << position_info(positions[index]) << std::endl
+                 << "  " << ENGINE_NAMES[engine] << ": permission "
+                 << int(engine_permissions[index]);
+
+      if(check_position)
+      {
+        divergence << " rule " << position_info(engine_positions[index]);
+      }
+
+      divergence << std::endl;
+
+      return false;
+    }
+
+    return true;
+  }
+
+  void report(std::vector<engine_counter> const& counters,
+              unsigned int rounds)
+  {
+    std::cout << rounds << " rounds:";
+
+    for(unsigned short engine = REFERENCE ; engine != ENGINE_NUMBER ; ++engine)
+    {
+      engine_counter const& counter = counters[engine];
+
+      std::cout << " " << ENGINE_NAMES[engine] << " "
+                << static_cast<std::uint64_t>
+
+                   (counter.decisions / std::max(counter.seconds,1e-9))
+                << "/s";
+    }
+
+    std::cout << std::endl;
+  }
+
+
+  // one random rule set checked at several times (schedules), returns false
+  // at the first divergence of an engine from the reference
+  bool verify_round(std::uint64_t seed,options const& opt,
+                    std::vector<engine_counter> & counters,
+                    std::ostream & divergence)
+  {
+    std::mt19937_64 random(seed);
+
+    std::vector<gemini::rule> rules;
+
+    const unsigned int rule_number =
+
+    std::uniform_int_distribution<unsigned int>(0,opt.max_rules)(random);
+
+    for(unsigned int index = 0 ; index < rule_number ; ++index)
+    {
+      rules.push_back(random_rule(random,rules));
+    }
+
+    std::vector<device_sample> samples;
+
+    for(unsigned int index = 0 ; index < opt.samples ; ++index)
+    {
+      samples.push_back(random_sample(random));
+    }
+
+
+    gemini::rule_set reference(""),
+                     reordered(""),
+                     optimized("");
+
+    for(auto rule_it = rules.begin() ; rule_it != rules.end() ; ++rule_it)
+    {
+      reference.push_back(*rule_it);
+      reordered.push_back(*rule_it);
+      optimized.push_back(*rule_it);
+    }
+
+    std::vector<gemini::rule_finding> findings;
+
+    optimized.optimize(findings);
+
+    // hot rules by the hits of the samples
+    for(auto sample_it = samples.begin() ; sample_it != samples.end() ;
+        ++sample_it)
+    {
+      reordered.permission(sample_it->desc);
+    }
+
+    reordered.reorder();
+
+
+    // a random time, then steps of up to a day (timer wheel transitions)
+    std::time_t time =
+
+    std::uniform_int_distribution<std::time_t>(1000000000,2000000000)(random);
+
+    std::vector<gemini::rule> toggled;
+
+    for(unsigned int step = 0 ; step < opt.steps ; ++step)
+    {
+      reference.advance(time,toggled);
+      reordered.advance(time,toggled);
+      optimized.advance(time,toggled);
+
+      std::vector<char>        permissions(samples.size());
+      std::vector<std::size_t> positions(samples.size());
+
+      auto start = std::chrono::steady_clock::now();
+
+      for(std::size_t index = 0 ; index < samples.size() ; ++index)
+      {
+        permissions[index] =
+
+        reference.reference_permission(samples[index].desc,
+                                       samples[index].fingerprint,
+                                       positions[index]);
+      }
+
+      counters[REFERENCE].seconds   += std::chrono::duration<double>
+
+                                       (std::chrono::steady_clock::now()
+                                        - start).count();
+      counters[REFERENCE].decisions += samples.size();
+
+
+      // permission() leaves pins to the caller
+      std::vector<char>        unpinned_permissions(samples.size());
+      std::vector<std::size_t> unpinned_positions(samples.size());
+
+      for(std::size_t index = 0 ; index < samples.size() ; ++index)
+      {
+        unpinned_permissions[index] =
+
+        reference.reference_permission(samples[index].desc,0,
+                                       unpinned_positions[index]);
+      }
+
+      bool identical =
+
+      verify(INDEX,samples,unpinned_permissions,unpinned_positions,false,
+             counters[INDEX],[&reference](device_sample const& sample,
+                                          std::size_t &)
+      {
+        return reference.permission(sample.desc);
+      },divergence) &&
+
+      verify(DECIDE,samples,permissions,positions,true,counters[DECIDE],
+             [&reference](device_sample const& sample,std::size_t & position)
+      {
+        return reference.decide(sample.desc,sample.fingerprint,position);
+      },divergence) &&
+
+      verify(REORDERED,samples,permissions,positions,true,counters[REORDERED],
+             [&reordered](device_sample const& sample,std::size_t & position)
+      {
+        return reordered.decide(sample.desc,sample.fingerprint,position);
+      },divergence) &&
+
+      verify(OPTIMIZED,samples,permissions,positions,false,counters[OPTIMIZED],
+             [&optimized](device_sample const& sample,std::size_t & position)
+      {
+        return optimized.decide(sample.desc,sample.fingerprint,position);
+      },divergence);
+
+      if(!identical)
+      {
+        divergence << "at " << time << ", rules:" << std::endl;
+
+        for(auto rule_it = rules.begin() ; rule_it != rules.end() ; ++rule_it)
+        {
+          divergence << "  " << rule_it->info(false) << std::endl;
+        }
+
+        return false;
+      }
+
+      time += std::uniform_int_distribution<std::time_t>(0,86400)(random);
+    }
+
+    return true;
+  }
+}
+
+
+// random rule sets and devices decided by the reference matcher (linear
+// scan) and by every optimized matcher, decisions have to be identical
+int main(int argc,char * argv[])
+{
+  options opt = {5489,10000,32,256,4,1000};
+
+  bool valid = true;
+
+  for(int arg = 1 ; arg < argc && valid ; ++arg)
+  {
+    if(arg + 1 == argc)
+    {
+      valid = false;
+
+      break;
+    }
+
+    char * end;
+
+    unsigned long long value = std::strtoull(argv[arg + 1],&end,0);
+
+    valid = *end == '\0';
+
+    if(std::strcmp(argv[arg],"--seed") == 0)           opt.seed      = value;
+    else if(std::strcmp(argv[arg],"--rounds") == 0)    opt.rounds    = value;
+    else if(std::strcmp(argv[arg],"--rules") == 0)     opt.max_rules = value;
+    else if(std::strcmp(argv[arg],"--samples") == 0)   opt.samples   = value;
+    else if(std::strcmp(argv[arg],"--steps") == 0)     opt.steps     = value;
+    else if(std::strcmp(argv[arg],"--report") == 0)    opt.report    = value;
+    else valid = false;
+
+    ++arg;
+  }
+
+  if(!valid || opt.steps == 0)
+  {
+    std::cerr << "usage: gemini_verify [--seed <n>] [--rounds <n>]"
+              << " [--rules <max>] [--samples <n>]" << std::endl
+              << "                     [--steps <n>] [--report <rounds>]"
+              << std::endl;
+
+    return EXIT_FAILURE;
+  }
+
+
+  std::vector<engine_counter> counters(ENGINE_NUMBER,engine_counter{0,0.0});
+
+  for(unsigned int round = 0 ; round < opt.rounds ; ++round)
+  {
+    // every round has a seed of its own, divergences are reproduced alone
+    std::ostringstream divergence;
+
+    if(!verify_round(opt.seed + round,opt,counters,divergence))
+    {
+      std::cout << "round " << round << " (--seed " << opt.seed + round
+                << " --rounds 1): " << divergence.str();
+
+      report(counters,round + 1);
+
+      return EXIT_FAILURE;
+    }
+
+    if(opt.report != 0 && (round + 1) % opt.report == 0 &&
+       round + 1 != opt.rounds)
+    {
+      report(counters,round + 1);
+    }
+  }
+
+  report(counters,opt.rounds);
+
+  std::cout << "identical decisions" << std::endl;
+
+
+  return EXIT_SUCCESS;
+}